@@ -0,0 +1,175 @@
+/*
+ * buf_pool.h - 計測フェーズで使い回すローカルバッファのプールと
+ *              フェーズごとの最大 RSS
+ *
+ * 各計測がそれぞれ max_size のバッファを確保すると、1 GB の既定でも
+ * アタッチした領域に加えて数 GB が常駐する。プールは解放されたバッファを
+ * マッピングしたまま持ち、次のフェーズが同じか小さいサイズを求めたら
+ * それを返す (ページフォルトも1回で済む)。足りなければ空きの小さい
+ * バッファを捨ててから確保し直すので、常駐量は同時に使う分の合計で済む。
+ *
+ * フェーズごとの最大 RSS は /proc/self/clear_refs に 5 を書いて
+ * 最大値 (VmHWM) を今の RSS に戻してから計り、終わりに VmHWM / VmRSS と
+ * getrusage の ru_maxrss (プロセス全体の最大) を記録する。
+ * clear_refs に書けない環境では VmHWM は起動からの最大になる。
+ */
+
+#ifndef BUF_POOL_H
+#define BUF_POOL_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+
+#define BUF_POOL_SLOTS  8
+#define MEM_MAX_PHASES  32
+
+typedef struct {
+    void *p;
+    size_t cap;
+    int used;
+} buf_slot_t;
+
+static buf_slot_t g_buf_pool[BUF_POOL_SLOTS];
+
+/* size バイト以上のバッファを借りる (中身は不定)。失敗時 NULL */
+static inline void *pool_get(size_t size)
+{
+    size = (size + 4095) & ~(size_t)4095;
+    buf_slot_t *best = NULL, *spare = NULL, *empty = NULL;
+    for (int i = 0; i < BUF_POOL_SLOTS; i++) {
+        buf_slot_t *s = &g_buf_pool[i];
+        if (!s->p) {
+            if (!empty)
+                empty = s;
+        } else if (!s->used) {
+            if (s->cap >= size && (!best || s->cap < best->cap))
+                best = s;
+            else if (s->cap < size && !spare)
+                spare = s;
+        }
+    }
+    if (!best) {
+        /* 小さすぎる空きは捨ててから確保し直す (合計の常駐量を増やさない) */
+        best = spare ? spare : empty;
+        if (!best)
+            return NULL;
+        if (best->p)
+            munmap(best->p, best->cap);
+        best->p = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (best->p == MAP_FAILED) {
+            best->p = NULL;
+            best->cap = 0;
+            return NULL;
+        }
+        best->cap = size;
+    }
+    best->used = 1;
+    return best->p;
+}
+
+/* 借りたバッファを返す (マッピングは次のフェーズのために残す) */
+static inline void pool_put(void *p)
+{
+    for (int i = 0; i < BUF_POOL_SLOTS; i++)
+        if (p && g_buf_pool[i].p == p)
+            g_buf_pool[i].used = 0;
+}
+
+/* プールが持っているバイト数 */
+static inline size_t pool_footprint(void)
+{
+    size_t n = 0;
+    for (int i = 0; i < BUF_POOL_SLOTS; i++)
+        n += g_buf_pool[i].cap;
+    return n;
+}
+
+static inline void pool_destroy(void)
+{
+    for (int i = 0; i < BUF_POOL_SLOTS; i++) {
+        if (g_buf_pool[i].p)
+            munmap(g_buf_pool[i].p, g_buf_pool[i].cap);
+        memset(&g_buf_pool[i], 0, sizeof(g_buf_pool[i]));
+    }
+}
+
+/* ========== フェーズごとの最大 RSS ========== */
+
+typedef struct {
+    char name[32];
+    long hwm_kb;        /* フェーズ中の最大 RSS (VmHWM) */
+    long rss_kb;        /* フェーズ終了時の RSS (VmRSS) */
+    long maxrss_kb;     /* 起動からの最大 (getrusage) */
+    size_t pool;        /* フェーズ終了時のプールの大きさ */
+} mem_phase_t;
+
+static mem_phase_t g_mem_phases[MEM_MAX_PHASES];
+static int g_num_mem_phases;
+static int g_mem_hwm_reset = -1;    /* clear_refs で最大値を戻せたか (-1: 未確認) */
+
+/* /proc/self/status の key (例 "VmHWM:") の値 (kB)。無ければ -1 */
+static inline long proc_status_kb(const char *key)
+{
+    FILE *fp = fopen("/proc/self/status", "r");
+    if (!fp)
+        return -1;
+    char line[256];
+    long v = -1;
+    size_t klen = strlen(key);
+    while (fgets(line, sizeof(line), fp))
+        if (strncmp(line, key, klen) == 0) {
+            v = strtol(line + klen, NULL, 10);
+            break;
+        }
+    fclose(fp);
+    return v;
+}
+
+/* フェーズの開始: 最大 RSS を今の RSS に戻す */
+static inline void mem_phase_begin(void)
+{
+    FILE *fp = fopen("/proc/self/clear_refs", "w");
+    int ok = fp && fputs("5", fp) >= 0;
+    if (fp && fclose(fp) != 0)
+        ok = 0;
+    if (g_mem_hwm_reset != 0)
+        g_mem_hwm_reset = ok;
+}
+
+/* フェーズの終了: 最大 RSS を記録して1行表示する */
+static inline void mem_phase_end(const char *name)
+{
+    struct rusage ru;
+    mem_phase_t m;
+    memset(&m, 0, sizeof(m));
+    snprintf(m.name, sizeof(m.name), "%s", name);
+    m.hwm_kb = proc_status_kb("VmHWM:");
+    m.rss_kb = proc_status_kb("VmRSS:");
+    m.maxrss_kb = getrusage(RUSAGE_SELF, &ru) == 0 ? ru.ru_maxrss : -1;
+    m.pool = pool_footprint();
+    if (g_num_mem_phases < MEM_MAX_PHASES)
+        g_mem_phases[g_num_mem_phases++] = m;
+    printf("  [メモリ] %s: 最大 RSS %.1f MB%s, 終了時 %.1f MB, プール %.1f MB\n", m.name,
+           m.hwm_kb / 1024.0, g_mem_hwm_reset == 1 ? "" : " (起動から)",
+           m.rss_kb / 1024.0, (double)m.pool / (1024.0 * 1024));
+}
+
+static inline void mem_phase_report(void)
+{
+    if (g_num_mem_phases == 0)
+        return;
+    printf("\n--- フェーズごとの最大 RSS%s ---\n",
+           g_mem_hwm_reset == 1 ? "" : " (clear_refs が使えないため起動からの最大)");
+    printf("  %-24s %12s %12s %12s %12s\n", "phase", "peak MB", "end MB", "maxrss MB",
+           "pool MB");
+    for (int i = 0; i < g_num_mem_phases; i++) {
+        const mem_phase_t *m = &g_mem_phases[i];
+        printf("  %-24s %12.1f %12.1f %12.1f %12.1f\n", m->name, m->hwm_kb / 1024.0,
+               m->rss_kb / 1024.0, m->maxrss_kb / 1024.0, (double)m->pool / (1024.0 * 1024));
+    }
+}
+
+#endif /* BUF_POOL_H */
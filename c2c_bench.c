@@ -0,0 +1,254 @@
+/*
+ * c2c_bench.c - コア間キャッシュライン受け渡しレイテンシの行列
+ *
+ * 共有メモリ上のキャッシュライン1本を2つのプロセスで奪い合い、
+ * 所有権が移るまでの片道時間を CPU の組ごとに計測する。
+ * 共有メモリを使うシグナリング (seqlock, リング, ピンポン) の下限になる。
+ *
+ * 親プロセスが行の CPU、fork() した子プロセスが列の CPU に自分で
+ * 固定し直しながら全ての組を回る:
+ *   親が奇数を書く → 子が見て +1 (偶数) を書く → 親が見る
+ * を1往復とし、その半分を片道レイテンシとする。
+ * 結果は数値の行列、濃淡のヒートマップ、トポロジの分類ごとの平均で表示し、
+ * 分類ごとの平均を RESULT 行 (C2C-smt など) として出力する。
+ * (BENCH_EXPORTER_CPU / BENCH_IMPORTER_CPU の固定は使わない)
+ *
+ * 使い方:
+ *   ./c2c_bench
+ *   BENCH_C2C_CPUS=0,1,8,16 で対象の CPU を絞る (既定: オンラインの全 CPU)
+ *   BENCH_C2C_ROUNDS / BENCH_C2C_SAMPLES で1サンプルの往復数とサンプル数
+ *
+ * コンパイル:
+ *   gcc -O2 -o c2c_bench c2c_bench.c -lrt -lm
+ */
+
+#include "common.h"
+#include "topology.h"
+#include <stdatomic.h>
+#include <sys/wait.h>
+
+typedef struct {
+    _Alignas(64) _Atomic uint64_t v;
+} c2c_line_t;
+
+/* 親子で共有する領域 (fork 前に MAP_SHARED で確保) */
+typedef struct {
+    c2c_line_t bounce;          /* 往復させるキャッシュライン */
+    _Alignas(64) _Atomic uint64_t cmd_seq;  /* 親が進める指示番号 */
+    _Atomic uint64_t ack;       /* 子が処理済みの指示番号 */
+    int cpu;                    /* 子が移る CPU (-1: 終了) */
+    int pin_ok;
+} c2c_shared_t;
+
+typedef struct {
+    c2c_shared_t *sh;
+    uint64_t v;
+} c2c_op_arg_t;
+
+/* 1操作 (親): 1往復 */
+static void op_bounce(void *arg)
+{
+    c2c_op_arg_t *a = (c2c_op_arg_t *)arg;
+    uint64_t v = a->v;
+    int spins = 0;
+    atomic_store_explicit(&a->sh->bounce.v, v + 1, memory_order_release);
+    while (atomic_load_explicit(&a->sh->bounce.v, memory_order_acquire) != v + 2)
+        spin_backoff(&spins);
+    a->v = v + 2;
+}
+
+/* 子: 奇数を見たら +1 して返す。指示が来たら CPU を移る */
+static int run_child(c2c_shared_t *sh)
+{
+    uint64_t seen = 0;
+    int spins = 0;
+    for (;;) {
+        uint64_t v = atomic_load_explicit(&sh->bounce.v, memory_order_acquire);
+        if (v & 1) {
+            atomic_store_explicit(&sh->bounce.v, v + 1, memory_order_release);
+            spins = 0;
+            continue;
+        }
+        uint64_t cmd = atomic_load_explicit(&sh->cmd_seq, memory_order_acquire);
+        if (cmd != seen) {
+            seen = cmd;
+            if (sh->cpu < 0)
+                return 0;
+            sh->pin_ok = pin_cpu(sh->cpu) >= 0;
+            atomic_store_explicit(&sh->ack, cmd, memory_order_release);
+            continue;
+        }
+        spin_backoff(&spins);
+    }
+}
+
+/* 親: 子を cpu へ移す (-1 なら終了させる)。移れたら 0 */
+static int move_child(c2c_shared_t *sh, int cpu)
+{
+    sh->cpu = cpu;
+    uint64_t cmd = atomic_load_explicit(&sh->cmd_seq, memory_order_relaxed) + 1;
+    atomic_store_explicit(&sh->cmd_seq, cmd, memory_order_release);
+    if (cpu < 0)
+        return 0;
+    while (atomic_load_explicit(&sh->ack, memory_order_acquire) != cmd)
+        sched_yield();
+    return sh->pin_ok ? 0 : -1;
+}
+
+/* 1組の片道レイテンシ (中央値, 秒) */
+static double measure_pair(c2c_shared_t *sh, int rounds, int nsamples, double *samples)
+{
+    c2c_op_arg_t arg = { sh, atomic_load(&sh->bounce.v) };
+    time_op(op_bounce, &arg, rounds);   /* ウォームアップ */
+    for (int s = 0; s < nsamples; s++)
+        samples[s] = time_op(op_bounce, &arg, rounds) / 2;
+    sample_stats_t st;
+    compute_stats(samples, nsamples, &st);
+    return st.median;
+}
+
+/* 濃淡: 最小 ' ' 〜 最大 '@' */
+static char shade(double v, double lo, double hi)
+{
+    static const char levels[] = " .:-=+*#%@";
+    if (isnan(v))
+        return '?';
+    int n = (int)sizeof(levels) - 2;
+    int k = hi > lo ? (int)((v - lo) / (hi - lo) * n + 0.5) : 0;
+    return levels[k < 0 ? 0 : k > n ? n : k];
+}
+
+int main(void)
+{
+    static cpu_topo_t topo[TOPO_MAX_CPUS];
+    int ncpus = topo_load(topo, TOPO_MAX_CPUS);
+
+    long list[TOPO_MAX_CPUS];
+    int n = env_long_list("BENCH_C2C_CPUS", "", list, TOPO_MAX_CPUS);
+    int cpus[TOPO_MAX_CPUS], num = 0;
+    if (n == 0) {
+        for (int c = 0; c < ncpus; c++)
+            if (topo[c].online)
+                cpus[num++] = c;
+    } else {
+        for (int i = 0; i < n; i++)
+            if (list[i] >= 0 && list[i] < ncpus)
+                cpus[num++] = (int)list[i];
+    }
+
+    int rounds = (int)env_long("BENCH_C2C_ROUNDS", DEFAULT_C2C_ROUNDS);
+    int nsamples = (int)env_long("BENCH_C2C_SAMPLES", DEFAULT_C2C_SAMPLES);
+    if (rounds < 1) rounds = 1;
+    if (nsamples < 1) nsamples = 1;
+
+    char timerbuf[128];
+    printf("=== コア間キャッシュライン受け渡しレイテンシ ===\n");
+    printf("対象 CPU: %d 個, %d 往復 × %d サンプル / 組\n", num, rounds, nsamples);
+    bench_config_load();
+    timer_calibrate();
+    printf("タイマー: %s\n\n", timer_describe(timerbuf, sizeof(timerbuf)));
+    if (num < 2) {
+        printf("CPU が2個未満のため計測できません\n");
+        return 0;
+    }
+
+    c2c_shared_t *sh = mmap(NULL, sizeof(c2c_shared_t), PROT_READ | PROT_WRITE,
+                            MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (sh == MAP_FAILED) {
+        perror("mmap");
+        return 1;
+    }
+    memset(sh, 0, sizeof(*sh));
+
+    fflush(stdout);  /* 未出力のバッファを子プロセスに複製しない */
+    pid_t pid = fork();
+    if (pid < 0) {
+        perror("fork");
+        return 1;
+    }
+    if (pid == 0)
+        _exit(run_child(sh));
+
+    double *lat = calloc((size_t)num * num, sizeof(double));
+    double *samples = calloc((size_t)nsamples, sizeof(double));
+    if (!lat || !samples) {
+        fprintf(stderr, "メモリ確保失敗\n");
+        kill(pid, SIGKILL);
+        waitpid(pid, NULL, 0);
+        free(lat);
+        free(samples);
+        return 1;
+    }
+
+    /* 数値の行列 (ns)。行 = 親 (書き手) の CPU, 列 = 子の CPU */
+    printf("--- 片道レイテンシ (ns, 行: 親 CPU → 列: 子 CPU) ---\n");
+    printf("  %5s", "");
+    for (int j = 0; j < num; j++)
+        printf(" %5d", cpus[j]);
+    printf("\n");
+
+    double lo = INFINITY, hi = 0;
+    for (int i = 0; i < num; i++) {
+        int self_ok = pin_cpu(cpus[i]) >= 0;
+        printf("  %5d", cpus[i]);
+        for (int j = 0; j < num; j++) {
+            double v = NAN;
+            if (i != j && self_ok && move_child(sh, cpus[j]) == 0)
+                v = measure_pair(sh, rounds, nsamples, samples) * 1e9;
+            lat[i * num + j] = v;
+            if (i == j)
+                printf(" %5s", "-");
+            else if (isnan(v))
+                printf(" %5s", "x");
+            else
+                printf(" %5.0f", v);
+            if (!isnan(v)) {
+                if (v < lo) lo = v;
+                if (v > hi) hi = v;
+            }
+            fflush(stdout);
+        }
+        printf("\n");
+    }
+
+    move_child(sh, -1);
+    int status = 1;
+    waitpid(pid, &status, 0);
+
+    /* ヒートマップ */
+    printf("\n--- ヒートマップ (' ' %.0f ns 〜 '@' %.0f ns) ---\n", lo, hi);
+    for (int i = 0; i < num; i++) {
+        printf("  %5d ", cpus[i]);
+        for (int j = 0; j < num; j++)
+            putchar(i == j ? '\\' : shade(lat[i * num + j], lo, hi));
+        printf("\n");
+    }
+
+    /* トポロジの分類ごと (各組の中央値を集めて統計を取る) */
+    printf("\n--- トポロジの分類ごと ---\n");
+    double *cls = calloc((size_t)num * num, sizeof(double));
+    for (int c = 0; cls && c < TOPO_NUM_CLASSES; c++) {
+        int k = 0;
+        for (int i = 0; i < num; i++)
+            for (int j = 0; j < num; j++)
+                if (i != j && !isnan(lat[i * num + j]) &&
+                    topo_classify(topo, cpus[i], cpus[j]) == c)
+                    cls[k++] = lat[i * num + j] * 1e-9;
+        if (k == 0)
+            continue;
+        char method[32];
+        snprintf(method, sizeof(method), "C2C-%s", TOPO_NAMES[c]);
+        sample_stats_t st;
+        compute_stats(cls, k, &st);
+        printf("  [%-10s] %5d 組 | median %8.1f ns | min %8.1f | max %8.1f  (%s)\n",
+               method, k, st.median * 1e9, st.min * 1e9, st.max * 1e9, TOPO_DESCS[c]);
+        print_result_record(method, sizeof(c2c_line_t), &st);
+    }
+
+    free(cls);
+    free(samples);
+    free(lat);
+    munmap(sh, sizeof(*sh));
+    printf("\nベンチマーク完了\n");
+    return WIFEXITED(status) ? WEXITSTATUS(status) : 1;
+}
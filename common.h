@@ -1,7 +1,7 @@
 /*
  * common.h - xpmem ベンチマーク共通定義
  *
- * プロセス間でセグメントIDを共有するためにファイルベースの通信を使用。
+ * プロセス間のセグメント情報の受け渡しは名前付きレジストリ (seg_registry.h)。
  * 計測ユーティリティ、データ検証関数を含む。
  */
 
@@ -19,6 +19,12 @@
 #include <fcntl.h>
 #include <errno.h>
 #include <signal.h>
+#include <math.h>
+#include <sched.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+#include "live_stats.h"
 
 /* ========== 設定パラメータ ========== */
 
@@ -38,16 +44,281 @@ static const size_t TEST_SIZES[] = {
 /* 各サイズでの繰り返し回数 */
 #define REPEAT_COUNT 5
 
-/* セグメントID共有用ファイル */
-#define SEGID_FILE "/tmp/xpmem_segid"
+/* 1サンプルの計測区間の最小時間。これに満たない場合は内側ループで繰り返す */
+#define MIN_TIMED_SEC   1e-3
+#define MAX_INNER_REPS  (1 << 20)
 
-/* 同期用ファイル */
-#define READY_FILE "/tmp/xpmem_ready"
-#define DONE_FILE  "/tmp/xpmem_done"
+/*
+ * 統計収集の既定値 (環境変数で上書き可能)
+ *   BENCH_WARMUP       捨てるウォームアップのサンプル数
+ *   BENCH_MIN_SAMPLES  最低サンプル数
+ *   BENCH_MAX_SAMPLES  最大サンプル数
+ *   BENCH_CI_TARGET    95%信頼区間の半幅/平均 がこれ以下になったら終了
+ *   BENCH_TIME_BUDGET  1サイズ・1方式あたりの計測時間の上限 (秒)
+ */
+#define DEFAULT_WARMUP       2
+#define DEFAULT_MIN_SAMPLES  REPEAT_COUNT
+#define DEFAULT_MAX_SAMPLES  200
+#define DEFAULT_CI_TARGET    0.02
+#define DEFAULT_TIME_BUDGET  2.0
+
+/*
+ * エクスポート領域の後ろに付ける補助領域 (アリーナ)
+ *   BENCH_ARENA_MB    補助領域のサイズ (MB, 0 で無効)
+ *   BENCH_ARENA_OBJS  エクスポータが公開するオブジェクト数
+ */
+#define DEFAULT_ARENA_MB    64
+#define DEFAULT_ARENA_OBJS  65536
+
+/* 公開テーブル (shm_containers.h) のエントリ数: BENCH_TBL_ENTRIES */
+#define DEFAULT_TBL_ENTRIES 262144
+
+/* 差分同期 (seg_sync.h) で書き換えるページの割合 (‰) のリスト: BENCH_DIRTY_PERMILLE */
+#define DEFAULT_DIRTY_PERMILLE "1,10,100"
+
+/*
+ * seqlock スナップショット (seg_sync.h)
+ *   BENCH_SEQ_MB       スナップショットを取る範囲 (MB, 最大テストサイズで頭打ち)
+ *   BENCH_SEQ_REGIONS  1領域のバイト数のリスト (4096 の倍数)
+ *   BENCH_SEQ_RATES    ライタの書き込み回数/秒のリスト (0: 停止, -1: 無制限)
+ */
+#define DEFAULT_SEQ_MB       16
+#define DEFAULT_SEQ_REGIONS  "4096,65536,1048576"
+#define DEFAULT_SEQ_RATES    "0,1000,100000,-1"
+
+/*
+ * shm パイプライン転送 (shm_bench のチャンクリング)
+ *   BENCH_RING_MB      1回の転送サイズ (MB, 最大テストサイズで頭打ち)
+ *   BENCH_RING_CHUNKS  チャンクサイズ (KB) のリスト
+ *   BENCH_RING_SLOTS   スロット数のリスト
+ */
+#define DEFAULT_RING_MB      64
+#define DEFAULT_RING_CHUNKS  "64,256,1024"
+#define DEFAULT_RING_SLOTS   "2,4"
+
+/*
+ * プリフェッチ付きカーネル (kernels.h)
+ *   BENCH_PREFETCH_DIST   memcpy / 直接アクセスで使う先読み距離 (bytes)
+ *   BENCH_PREFETCH_DISTS  距離スイープのリスト (bytes)
+ *   BENCH_PREFETCH_MB     スイープするサイズ (MB, 最大テストサイズで頭打ち)
+ */
+#define DEFAULT_PREFETCH_DIST   512
+#define DEFAULT_PREFETCH_DISTS  "128,256,512,1024,2048,4096"
+#define DEFAULT_PREFETCH_MB     64
+
+/*
+ * extent の gather / scatter (seg_extent.h)
+ *   BENCH_EXT_MB       extent を置く範囲 (MB, 最大テストサイズで頭打ち)
+ *   BENCH_EXT_COUNT    extent の数 (範囲に収まらなければ減らす)
+ *   BENCH_EXT_SIZES    extent 長 (bytes) のリスト
+ *   BENCH_EXT_LAYOUT   配置: seq (順次) / rand (ランダム) をカンマ区切りで
+ *   BENCH_EXT_THREADS  複数スレッドでコピーする場合のスレッド数
+ *   BENCH_EXT_PVM      1 ならエクスポータが ptrace を許し、process_vm_readv / writev も比べる
+ */
+#define DEFAULT_EXT_MB       64
+#define DEFAULT_EXT_COUNT    4096
+#define DEFAULT_EXT_SIZES    "64,512,4096,65536"
+#define DEFAULT_EXT_LAYOUT   "seq,rand"
+#define DEFAULT_EXT_THREADS  4
+
+/* コア間レイテンシ (c2c_bench): 1サンプルの往復数 BENCH_C2C_ROUNDS, サンプル数 BENCH_C2C_SAMPLES */
+#define DEFAULT_C2C_ROUNDS   2000
+#define DEFAULT_C2C_SAMPLES  5
+
+/* STREAM 方式の帯域基準 (stream_bench): 配列1本のサイズ BENCH_STREAM_MB (LLC の4倍以上に) */
+#define DEFAULT_STREAM_MB    128
+
+/*
+ * 長時間ソーク (xpmem_importer。BENCH_SOAK=copy|dir|pingpong|ring で通常の計測の代わりに実行)
+ *   BENCH_SOAK_SECONDS   実行時間 (秒)
+ *   BENCH_SOAK_INTERVAL  時系列の1区間 (秒)
+ *   BENCH_SOAK_MB        copy / dir の1操作のサイズ (MB, 最大テストサイズで頭打ち)
+ *   BENCH_SOAK_CHUNK_KB  ring のチャンクサイズ (KB)
+ *   BENCH_SOAK_SLOTS     ring のスロット数
+ */
+#define DEFAULT_SOAK_SECONDS   60
+#define DEFAULT_SOAK_INTERVAL  1.0
+#define DEFAULT_SOAK_MB        64
+#define DEFAULT_SOAK_CHUNK_KB  256
+#define DEFAULT_SOAK_SLOTS     4
+
+/*
+ * 背景メモリトラフィック (noise_gen)
+ *   BENCH_NOISE_MODE     read / write / rand
+ *   BENCH_NOISE_THREADS  スレッド数
+ *   BENCH_NOISE_MBPS     1スレッドあたりの目標帯域 (MB/s, 0 で無制限)
+ *   BENCH_NOISE_MB       1スレッドあたりのバッファ (MB, LLC より大きく)
+ *   BENCH_NOISE_CPUS     スレッドを順に固定する CPU のリスト
+ *   BENCH_NOISE_NODE     CPU を指定しない場合、この NUMA ノードの CPU に固定する
+ *   BENCH_NOISE_SECONDS  実行時間 (0 でシグナルを受けるまで)
+ */
+#define DEFAULT_NOISE_MODE     "read"
+#define DEFAULT_NOISE_THREADS  1
+#define DEFAULT_NOISE_MB       256
+
+/*
+ * セグメントの受け渡し (統合ドライバを使わない場合)
+ * エクスポータは seg_registry.h のレジストリに名前で登録し、インポータは
+ * 名前で引く。完了はセグメント名ごとのファイルで通知する
+ *   BENCH_SEG_NAME     セグメント名
+ *   BENCH_REGISTRY     レジストリの共有メモリ名
+ *   BENCH_REG_ENTRIES  エクスポータのレジストリ計測のエントリ数 (0 で省略)
+ *   BENCH_SEG_TIMEOUT  インポータが登録を待つ秒数 (0 で無制限)
+ * エクスポータの初期化 (seg_init.h)
+ *   BENCH_INIT_THREADS プリフォルトとパターン書き込みのスレッド数
+ *                      (0: エクスポータの NUMA ノードの CPU 数)
+ *   BENCH_INIT_LAZY    1 ならデータ領域の初期化の前に公開し、裏で初期化する
+ */
+#define DEFAULT_SEG_NAME     "default"
+#define DEFAULT_REG_ENTRIES  4096
+#define DONE_FILE_PREFIX     "/tmp/xpmem_done."
 
 /* POSIX共有メモリ名 */
 #define SHM_NAME "/xpmem_bench_shm"
 
+/*
+ * 統合ドライバ (xpmem_bench) から起動された場合の設定
+ *   XPMEM_BENCH_SOCK    継承したソケットの fd。ファイルの代わりにこれで
+ *                       セグメント情報と完了を通知する
+ *   BENCH_EXPORTER_CPU  エクスポータ (shm_bench では書き込み側) を固定するCPU
+ *   BENCH_IMPORTER_CPU  インポータ (shm_bench では読み取り側) を固定するCPU
+ */
+#define ENV_SOCK_FD       "XPMEM_BENCH_SOCK"
+#define ENV_EXPORTER_CPU  "BENCH_EXPORTER_CPU"
+#define ENV_IMPORTER_CPU  "BENCH_IMPORTER_CPU"
+#define ENV_NOISE_LABEL   "BENCH_NOISE_LABEL"
+
+/* ========== 実行時設定 ========== */
+
+static inline long env_long(const char *name, long def)
+{
+    const char *v = getenv(name);
+    if (!v || !*v)
+        return def;
+    char *end;
+    long x = strtol(v, &end, 0);
+    return *end ? def : x;
+}
+
+static inline double env_double(const char *name, double def)
+{
+    const char *v = getenv(name);
+    if (!v || !*v)
+        return def;
+    char *end;
+    double x = strtod(v, &end);
+    return *end ? def : x;
+}
+
+/*
+ * "1,10,100" 形式のカンマ区切り整数リストを読む。未設定なら def を使う。
+ * 読めた個数 (最大 max) を返す
+ */
+static inline int env_long_list(const char *name, const char *def, long *out, int max)
+{
+    const char *s = getenv(name);
+    if (!s || !*s)
+        s = def;
+
+    int n = 0;
+    while (*s && n < max) {
+        char *end;
+        long x = strtol(s, &end, 0);
+        if (end == s)
+            break;
+        out[n++] = x;
+        s = (*end == ',') ? end + 1 : end;
+    }
+    return n;
+}
+
+/*
+ * 結果行 (RESULT) に付ける計測条件。run_bench.sh compare はこれと
+ * backend, size をキーにベースラインと突き合わせる。
+ *   BENCH_PLACEMENT  配置ラベル (省略時は CPU アフィニティのリスト)
+ *   BENCH_NOISE_LABEL 背景負荷のラベル。配置に "+ラベル" として付ける
+ */
+typedef struct {
+    int threads;
+    char placement[128];
+} result_context_t;
+
+static result_context_t g_result_ctx = { 1, "any" };
+
+/* sched_getaffinity の結果を "0-3,8" 形式にする。全CPUなら "any" */
+static inline const char *format_affinity(char *buf, size_t buflen)
+{
+    cpu_set_t set;
+    buf[0] = '\0';
+    if (sched_getaffinity(0, sizeof(set), &set) != 0 ||
+        CPU_COUNT(&set) == sysconf(_SC_NPROCESSORS_CONF)) {
+        snprintf(buf, buflen, "any");
+        return buf;
+    }
+    size_t len = 0;
+    for (int c = 0; c < CPU_SETSIZE; c++) {
+        if (!CPU_ISSET(c, &set))
+            continue;
+        int e = c;
+        while (e + 1 < CPU_SETSIZE && CPU_ISSET(e + 1, &set))
+            e++;
+        len += snprintf(buf + len, len < buflen ? buflen - len : 0,
+                        e > c ? "%s%d-%d" : "%s%d", len ? "," : "", c, e);
+        c = e;
+    }
+    return buf;
+}
+
+typedef struct {
+    int warmup;
+    int min_samples;
+    int max_samples;
+    double ci_target;
+    double time_budget;
+} bench_config_t;
+
+static bench_config_t g_cfg = {
+    DEFAULT_WARMUP, DEFAULT_MIN_SAMPLES, DEFAULT_MAX_SAMPLES,
+    DEFAULT_CI_TARGET, DEFAULT_TIME_BUDGET,
+};
+
+static inline void bench_config_load(void)
+{
+    g_cfg.warmup      = (int)env_long("BENCH_WARMUP", DEFAULT_WARMUP);
+    g_cfg.min_samples = (int)env_long("BENCH_MIN_SAMPLES", DEFAULT_MIN_SAMPLES);
+    g_cfg.max_samples = (int)env_long("BENCH_MAX_SAMPLES", DEFAULT_MAX_SAMPLES);
+    g_cfg.ci_target   = env_double("BENCH_CI_TARGET", DEFAULT_CI_TARGET);
+    g_cfg.time_budget = env_double("BENCH_TIME_BUDGET", DEFAULT_TIME_BUDGET);
+    if (g_cfg.warmup < 0) g_cfg.warmup = 0;
+    if (g_cfg.min_samples < 2) g_cfg.min_samples = 2;
+    if (g_cfg.max_samples < g_cfg.min_samples) g_cfg.max_samples = g_cfg.min_samples;
+
+    const char *pl = getenv("BENCH_PLACEMENT");
+    const char *ecpu = getenv(ENV_EXPORTER_CPU), *icpu = getenv(ENV_IMPORTER_CPU);
+    if (pl && *pl)
+        snprintf(g_result_ctx.placement, sizeof(g_result_ctx.placement), "%s", pl);
+    else if ((ecpu && *ecpu) || (icpu && *icpu))
+        snprintf(g_result_ctx.placement, sizeof(g_result_ctx.placement), "e%s-i%s",
+                 ecpu && *ecpu ? ecpu : "*", icpu && *icpu ? icpu : "*");
+    else
+        format_affinity(g_result_ctx.placement, sizeof(g_result_ctx.placement));
+
+    const char *noise = getenv(ENV_NOISE_LABEL);
+    if (noise && *noise) {
+        size_t len = strlen(g_result_ctx.placement);
+        snprintf(g_result_ctx.placement + len, sizeof(g_result_ctx.placement) - len,
+                 "+%s", noise);
+    }
+}
+
+static inline void print_config(void)
+{
+    printf("  ウォームアップ: %d 回 (破棄)\n", g_cfg.warmup);
+    printf("  サンプル数: %d〜%d (95%%CI ±%.1f%% 以内 または %.1f 秒で打ち切り)\n",
+           g_cfg.min_samples, g_cfg.max_samples,
+           g_cfg.ci_target * 100, g_cfg.time_budget);
+}
+
 /* ========== 高精度タイマー ========== */
 
 static inline double get_time_sec(void)
@@ -57,6 +328,182 @@ static inline double get_time_sec(void)
     return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
 }
 
+/*
+ * TSC タイマー
+ *
+ * constant_tsc / nonstop_tsc を持つ x86 では rdtsc を CLOCK_MONOTONIC_RAW で
+ * 校正して使う。開始側は lfence で前の命令を、終了側は rdtscp + lfence で
+ * 計測対象の命令と後続の命令を分離する。それ以外の環境では
+ * CLOCK_MONOTONIC_RAW のナノ秒をそのまま tick として扱う。
+ */
+static double g_timer_sec_per_tick = 1e-9;
+static int g_timer_use_tsc = 0;
+
+static inline uint64_t clock_raw_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static inline uint64_t timer_start(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    if (g_timer_use_tsc) {
+        _mm_lfence();
+        uint64_t t = __rdtsc();
+        _mm_lfence();
+        return t;
+    }
+#endif
+    return clock_raw_ns();
+}
+
+static inline uint64_t timer_stop(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    if (g_timer_use_tsc) {
+        unsigned int aux;
+        uint64_t t = __rdtscp(&aux);
+        _mm_lfence();
+        return t;
+    }
+#endif
+    return clock_raw_ns();
+}
+
+static inline double timer_elapsed_sec(uint64_t t0, uint64_t t1)
+{
+    return (double)(t1 - t0) * g_timer_sec_per_tick;
+}
+
+/* /proc/cpuinfo で不変 TSC か確認し、使えれば周波数を校正する */
+static inline void timer_calibrate(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    FILE *fp = fopen("/proc/cpuinfo", "r");
+    char line[4096];
+    int constant = 0, nonstop = 0;
+    if (fp) {
+        while (fgets(line, sizeof(line), fp)) {
+            if (strncmp(line, "flags", 5) != 0)
+                continue;
+            constant = strstr(line, " constant_tsc") != NULL;
+            nonstop  = strstr(line, " nonstop_tsc") != NULL;
+            break;
+        }
+        fclose(fp);
+    }
+    if (!constant || !nonstop)
+        return;
+
+    /* 20ms 区間を3回計測し、最も短い区間比を採用する */
+    double best = 0;
+    for (int i = 0; i < 3; i++) {
+        uint64_t n0 = clock_raw_ns();
+        uint64_t c0 = __rdtsc();
+        while (clock_raw_ns() - n0 < 20000000ULL)
+            ;
+        uint64_t c1 = __rdtsc();
+        uint64_t n1 = clock_raw_ns();
+        double spt = (double)(n1 - n0) * 1e-9 / (double)(c1 - c0);
+        if (best == 0 || spt < best)
+            best = spt;
+    }
+    g_timer_sec_per_tick = best;
+    g_timer_use_tsc = 1;
+#endif
+}
+
+static inline const char *timer_describe(char *buf, size_t buflen)
+{
+    if (g_timer_use_tsc)
+        snprintf(buf, buflen, "TSC (%.3f GHz, CLOCK_MONOTONIC_RAW で校正)",
+                 1e-9 / g_timer_sec_per_tick);
+    else
+        snprintf(buf, buflen, "CLOCK_MONOTONIC_RAW");
+    return buf;
+}
+
+/* ========== 内側ループの自動校正 ========== */
+
+/* 計測対象の操作。arg はベンチマークごとのコンテキスト */
+typedef void (*bench_op_fn)(void *arg);
+
+/*
+ * op を reps 回連続実行し、1回あたりの時間 (秒) を返す。
+ * 共有統計ページ (live_stats.h) は計測区間の外で更新する
+ */
+static inline double time_op(bench_op_fn op, void *arg, int reps)
+{
+    uint64_t t0 = timer_start();
+    for (int k = 0; k < reps; k++)
+        op(arg);
+    uint64_t t1 = timer_stop();
+    double t = timer_elapsed_sec(t0, t1) / reps;
+    stats_record((uint64_t)reps, t);
+    stats_faults();
+    return t;
+}
+
+/*
+ * 計測区間が MIN_TIMED_SEC 以上になる繰り返し回数 K を求める。
+ * 大きなサイズでは1回で条件を満たすので K = 1 になる。
+ */
+static inline int calibrate_inner_reps(bench_op_fn op, void *arg)
+{
+    int reps = 1;
+    for (;;) {
+        double total = time_op(op, arg, reps) * reps;
+        if (total >= MIN_TIMED_SEC || reps >= MAX_INNER_REPS)
+            return reps;
+        /* 目標時間に届くまで見積もりで増やす (最低2倍) */
+        double scale = total > 0 ? MIN_TIMED_SEC / total * 1.2 : 2.0;
+        if (scale < 2.0)
+            scale = 2.0;
+        double next = reps * scale;
+        reps = next > MAX_INNER_REPS ? MAX_INNER_REPS : (int)next;
+    }
+}
+
+/* 基本操作: memcpy と直接読み取り走査 */
+typedef struct {
+    void *dst;
+    const void *src;
+    size_t size;
+    uint64_t sum;       /* 走査結果 (最適化抑制用) */
+} mem_op_arg_t;
+
+static inline void op_memcpy(void *arg)
+{
+    mem_op_arg_t *a = (mem_op_arg_t *)arg;
+    memcpy(a->dst, a->src, a->size);
+    __asm__ volatile("" ::: "memory");
+}
+
+static inline void op_read_scan(void *arg)
+{
+    mem_op_arg_t *a = (mem_op_arg_t *)arg;
+    const uint64_t *p = (const uint64_t *)a->src;
+    size_t count = a->size / sizeof(uint64_t);
+    uint64_t sum = 0;
+    for (size_t i = 0; i < count; i++)
+        sum += p[i];
+    a->sum += sum;
+    /* 合計値を使用済みにし、繰り返し呼び出しでも毎回メモリから読ませる */
+    __asm__ volatile("" :: "r"(sum) : "memory");
+}
+
+/* 各ページの先頭1バイトだけ読む (マッピング直後のファーストタッチ計測用) */
+static inline uint64_t touch_pages(const void *ptr, size_t size)
+{
+    const volatile uint8_t *p = (const volatile uint8_t *)ptr;
+    uint64_t sum = 0;
+    for (size_t off = 0; off < size; off += 4096)
+        sum += p[off];
+    return sum;
+}
+
 /* ========== サイズ表示ユーティリティ ========== */
 
 static inline const char *format_size(size_t bytes, char *buf, size_t buflen)
@@ -94,6 +541,41 @@ static inline size_t verify_pattern(const void *buf, size_t size)
     return 0;
 }
 
+/* スピン待ちの1回分 (ハイパースレッドの相方に実行資源を譲る) */
+static inline void cpu_relax(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    _mm_pause();
+#else
+    __asm__ volatile("" ::: "memory");
+#endif
+}
+
+#define SPIN_LIMIT 1024         /* これだけ回って進まなければ CPU を譲る */
+
+/* 相手と同じ CPU に載っていても進めるよう、しばらく回ったら譲る */
+static inline void spin_backoff(int *spins)
+{
+    if (++*spins < SPIN_LIMIT) {
+        cpu_relax();
+    } else {
+        *spins = 0;
+        sched_yield();
+    }
+}
+
+/* ========== 擬似乱数 ========== */
+
+/* xorshift64: ベンチマークの入力生成用 (state は 0 以外で初期化) */
+static inline uint64_t xorshift64(uint64_t *state)
+{
+    uint64_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    return *state = x;
+}
+
 /* ========== 同期ユーティリティ ========== */
 
 static inline void signal_file(const char *path)
@@ -102,18 +584,221 @@ static inline void signal_file(const char *path)
     if (fd >= 0) close(fd);
 }
 
-static inline void wait_for_file(const char *path)
+static inline const char *seg_name_from_env(void)
+{
+    const char *e = getenv("BENCH_SEG_NAME");
+    return (e && *e) ? e : DEFAULT_SEG_NAME;
+}
+
+/* セグメント name の完了通知ファイル */
+static inline const char *done_file_path(const char *name, char *buf, size_t len)
+{
+    snprintf(buf, len, DONE_FILE_PREFIX "%s", name);
+    return buf;
+}
+
+static inline void cleanup_sync_files(const char *name)
+{
+    char path[256];
+    unlink(done_file_path(name, path, sizeof(path)));
+}
+
+/* ソケット経由でエクスポータからインポータへ渡すセグメント情報 */
+typedef struct {
+    long long segid;
+    size_t size;            /* データ領域 (テストパターン) のサイズ */
+    int pid;
+    size_t aux_offset;      /* 補助領域 (アリーナ) の開始オフセット */
+    size_t aux_size;        /* 補助領域のサイズ。0 なら無し */
+} seg_handle_msg_t;
+
+/* 継承したソケットの fd。ドライバ経由でなければ -1 */
+static inline int inherited_sock_fd(void)
+{
+    return (int)env_long(ENV_SOCK_FD, -1);
+}
+
+/* fd (ソケット・パイプ) に全量を送受信する (EINTR は再試行) */
+static inline int sock_send_all(int fd, const void *buf, size_t len)
+{
+    const char *p = (const char *)buf;
+    while (len > 0) {
+        ssize_t n = write(fd, p, len);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return -1;
+        p += n; len -= (size_t)n;
+    }
+    return 0;
+}
+
+static inline int sock_recv_all(int fd, void *buf, size_t len)
+{
+    char *p = (char *)buf;
+    while (len > 0) {
+        ssize_t n = read(fd, p, len);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return -1;
+        p += n; len -= (size_t)n;
+    }
+    return 0;
+}
+
+/* 呼び出しスレッドを cpu に固定する。失敗時 -1 */
+static inline int pin_cpu(int cpu)
+{
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    if (sched_setaffinity(0, sizeof(set), &set) != 0) {
+        perror("sched_setaffinity");
+        return -1;
+    }
+    return cpu;
+}
+
+/* 環境変数 env で指定された CPU に呼び出しスレッドを固定する */
+static inline int pin_from_env(const char *env)
+{
+    long cpu = env_long(env, -1);
+    if (cpu < 0)
+        return -1;
+    return pin_cpu((int)cpu);
+}
+
+/* ========== 統計処理 ========== */
+
+typedef struct {
+    int n;              /* サンプル数 */
+    int outliers;       /* 除外した外れ値の数 */
+    double median;
+    double mad;         /* 中央値絶対偏差 */
+    double mean;        /* 外れ値除外後 */
+    double stddev;      /* 外れ値除外後 */
+    double ci95;        /* 平均の95%信頼区間の半幅 */
+    double min, max;
+} sample_stats_t;
+
+static inline int cmp_double(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+static inline double median_sorted(const double *v, int n)
+{
+    return (n & 1) ? v[n / 2] : 0.5 * (v[n / 2 - 1] + v[n / 2]);
+}
+
+/* 両側95%の t 分布臨界値 */
+static inline double t_crit95(int df)
+{
+    static const double tab[] = {
+        12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+        2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+        2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042,
+    };
+    if (df < 1)
+        return INFINITY;
+    if (df <= 30)
+        return tab[df - 1];
+    return 1.96 + 2.4 / df;
+}
+
+/*
+ * 中央値・MAD を求め、修正 z スコア (0.6745 * |x - median| / MAD) が
+ * 3.5 を超えるものを外れ値として除外した上で平均・標準偏差・95%CI を求める。
+ */
+static inline void compute_stats(const double *samples, int n, sample_stats_t *st)
 {
-    while (access(path, F_OK) != 0) {
-        usleep(10000); /* 10ms */
+    memset(st, 0, sizeof(*st));
+    st->n = n;
+    if (n <= 0)
+        return;
+
+    /* 確保できなければ統計なし (n = 0) として返す */
+    double *v = (double *)malloc(sizeof(double) * n);
+    double *dev = (double *)malloc(sizeof(double) * n);
+    if (!v || !dev) {
+        perror("malloc");
+        free(v);
+        free(dev);
+        st->n = 0;
+        return;
     }
+    memcpy(v, samples, sizeof(double) * n);
+    qsort(v, n, sizeof(double), cmp_double);
+    st->min = v[0];
+    st->max = v[n - 1];
+    st->median = median_sorted(v, n);
+
+    for (int i = 0; i < n; i++)
+        dev[i] = fabs(v[i] - st->median);
+    qsort(dev, n, sizeof(double), cmp_double);
+    st->mad = median_sorted(dev, n);
+    free(dev);
+
+    double sum = 0, sumsq = 0;
+    int m = 0;
+    for (int i = 0; i < n; i++) {
+        if (st->mad > 0 && 0.6745 * fabs(v[i] - st->median) / st->mad > 3.5) {
+            st->outliers++;
+            continue;
+        }
+        sum += v[i];
+        m++;
+    }
+    st->mean = sum / m;
+    for (int i = 0; i < n; i++) {
+        if (st->mad > 0 && 0.6745 * fabs(v[i] - st->median) / st->mad > 3.5)
+            continue;
+        sumsq += (v[i] - st->mean) * (v[i] - st->mean);
+    }
+    st->stddev = m > 1 ? sqrt(sumsq / (m - 1)) : 0;
+    st->ci95 = m > 1 ? t_crit95(m - 1) * st->stddev / sqrt((double)m) : INFINITY;
+    free(v);
+}
+
+/* サンプル集合: ウォームアップ後の計測値を溜め、終了条件を判定する */
+typedef struct {
+    double *v;
+    int n;
+    double t_start;
+} sample_set_t;
+
+static inline void samples_init(sample_set_t *s)
+{
+    s->v = (double *)malloc(sizeof(double) * g_cfg.max_samples);
+    if (!s->v)
+        perror("malloc");
+    s->n = 0;
+    s->t_start = get_time_sec();
 }
 
-static inline void cleanup_sync_files(void)
+static inline void samples_add(sample_set_t *s, double t)
 {
-    unlink(SEGID_FILE);
-    unlink(READY_FILE);
-    unlink(DONE_FILE);
+    if (s->v && s->n < g_cfg.max_samples)
+        s->v[s->n++] = t;
+}
+
+/* 最低数に達した上で、CI が目標以内か時間切れか最大数に達したら終了 */
+static inline int samples_done(const sample_set_t *s)
+{
+    if (!s->v || s->n >= g_cfg.max_samples)
+        return 1;
+    if (s->n < g_cfg.min_samples)
+        return 0;
+    if (get_time_sec() - s->t_start >= g_cfg.time_budget)
+        return 1;
+    sample_stats_t st;
+    compute_stats(s->v, s->n, &st);
+    return st.mean > 0 && st.ci95 / st.mean <= g_cfg.ci_target;
+}
+
+static inline void samples_free(sample_set_t *s)
+{
+    free(s->v);
+    s->v = NULL;
+    s->n = 0;
 }
 
 /* ========== 結果表示 ========== */
@@ -127,27 +812,55 @@ static inline void print_result(const char *method, size_t size,
 
     format_size(size, sizebuf, sizeof(sizebuf));
 
-    printf("  [%s] %8s | iter %d | %.6f sec | %8.2f GB/s | %12.1f us\n",
+    printf("  [%s] %8s | iter %d | %.9f sec | %8.2f GB/s | %12.3f us\n",
            method, sizebuf, iteration, elapsed_sec, bandwidth_gbps, latency_us);
 }
 
+/*
+ * 機械可読な結果行。run_bench.sh compare がこの行だけを読む。
+ * 方式名の前後の空白 (表の桁揃え用) は取り除く。
+ */
+static inline void print_result_record(const char *method, size_t size,
+                                       const sample_stats_t *st)
+{
+    char name[64];
+    size_t n = 0;
+    for (const char *p = method; *p && n + 1 < sizeof(name); p++)
+        if (*p != ' ')
+            name[n++] = *p;
+    name[n] = '\0';
+
+    printf("RESULT backend=%s size=%zu threads=%d placement=%s n=%d "
+           "median_us=%.6f mad_us=%.6f mean_us=%.6f stddev_us=%.6f ci95_us=%.6f "
+           "gbps=%.4f\n",
+           name, size, g_result_ctx.threads, g_result_ctx.placement, st->n,
+           st->median * 1e6, st->mad * 1e6, st->mean * 1e6, st->stddev * 1e6,
+           st->ci95 * 1e6, (double)size / st->median / (1024.0 * 1024 * 1024));
+}
+
 static inline void print_summary(const char *method, size_t size,
                                  double *times, int count)
 {
     char sizebuf[64];
     format_size(size, sizebuf, sizeof(sizebuf));
 
-    double min_t = times[0], max_t = times[0], sum_t = 0;
-    for (int i = 0; i < count; i++) {
-        if (times[i] < min_t) min_t = times[i];
-        if (times[i] > max_t) max_t = times[i];
-        sum_t += times[i];
+    sample_stats_t st;
+    compute_stats(times, count, &st);
+    /* サンプルが無ければ (確保失敗など) 帯域は出さず、結果行も作らない */
+    if (st.n == 0) {
+        printf("  [%s] %8s | n/a (サンプルなし)\n", method, sizebuf);
+        return;
     }
-    double avg_t = sum_t / count;
-    double avg_bw = (double)size / avg_t / (1024.0 * 1024 * 1024);
+    double med_bw = (double)size / st.median / (1024.0 * 1024 * 1024);
+    double ci_pct = st.mean > 0 ? st.ci95 / st.mean * 100 : 0;
 
-    printf("  [%s] %8s | avg %.6f sec | avg %8.2f GB/s | min %.6f | max %.6f\n",
-           method, sizebuf, avg_t, avg_bw, min_t, max_t);
+    /* 時間はマイクロ秒で表示 */
+    printf("  [%s] %8s | median %12.4f us | median %8.2f GB/s | MAD %.4f us | n %d (外れ値 %d)\n",
+           method, sizebuf, st.median * 1e6, med_bw, st.mad * 1e6, st.n, st.outliers);
+    printf("  [%s] %8s | mean   %12.4f us ± %.4f (95%%CI ±%.2f%%) | stddev %.4f us | min %.4f | max %.4f\n",
+           method, sizebuf, st.mean * 1e6, st.ci95 * 1e6, ci_pct, st.stddev * 1e6,
+           st.min * 1e6, st.max * 1e6);
+    print_result_record(method, size, &st);
 }
 
 /* ========== ページアラインドメモリ確保 ========== */
@@ -0,0 +1,213 @@
+/*
+ * file_bench.c - ファイル経由 (mmap / read / O_DIRECT) ベンチマーク
+ *
+ * xpmem や POSIX共有メモリとの比較のため、エクスポートするデータが
+ * ファイルにある場合に、別プロセスがそれを読み出す速度を計測する。
+ *
+ * 親プロセスがファイルに検証パターンを書き込んで同期し、fork() した
+ * 子プロセスが以下の方式でローカルバッファへ取り込む (1操作あたり):
+ *   FILE-map   mmap(MAP_SHARED) → memcpy → munmap  (ページキャッシュ)
+ *   FILE-pop   mmap(MAP_SHARED | MAP_POPULATE) → memcpy → munmap
+ *   FILE-read  pread() (ページキャッシュ経由)
+ *   FILE-odir  O_DIRECT で pread() (tmpfs など非対応ならスキップ)
+ *
+ * 使い方:
+ *   ./file_bench [最大テストサイズ(MB)]
+ *   BENCH_FILE=/path/to/file で置き場所を指定 (既定は tmpfs の /dev/shm)
+ *
+ * コンパイル:
+ *   gcc -O2 -o file_bench file_bench.c -lrt -lm
+ */
+
+#include "common.h"
+#include <sys/wait.h>
+
+#define DEFAULT_BENCH_FILE "/dev/shm/xpmem_bench_file"
+
+typedef struct {
+    int fd;
+    void *dst;
+    size_t size;
+    int populate;
+    int err;                    /* mmap が失敗した errno (0: 成功) */
+} file_op_arg_t;
+
+static void op_file_map(void *arg)
+{
+    file_op_arg_t *a = (file_op_arg_t *)arg;
+    int flags = MAP_SHARED | (a->populate ? MAP_POPULATE : 0);
+    void *p = mmap(NULL, a->size, PROT_READ, flags, a->fd, 0);
+    if (p == MAP_FAILED) {
+        a->err = errno;
+        return;
+    }
+    memcpy(a->dst, p, a->size);
+    munmap(p, a->size);
+}
+
+static void op_file_pread(void *arg)
+{
+    file_op_arg_t *a = (file_op_arg_t *)arg;
+    size_t done = 0;
+    while (done < a->size) {
+        ssize_t n = pread(a->fd, (char *)a->dst + done, a->size - done, (off_t)done);
+        if (n <= 0)
+            break;
+        done += (size_t)n;
+    }
+}
+
+/* 1方式・全サイズのベンチマーク */
+static void bench_file_variant(const char *method, bench_op_fn op, file_op_arg_t *arg,
+                               size_t max_size)
+{
+    for (size_t si = 0; si < NUM_TEST_SIZES; si++) {
+        size_t size = TEST_SIZES[si];
+        if (size > max_size) break;
+
+        arg->size = size;
+        arg->err = 0;
+        op(arg);
+        if (arg->err) {
+            fprintf(stderr, "  %s: mmap に失敗しました: %s (以降省略)\n", method,
+                    strerror(arg->err));
+            return;
+        }
+        int reps = calibrate_inner_reps(op, arg);
+        printf("  内側ループ: %d 回/サンプル\n", reps);
+
+        for (int w = 0; w < g_cfg.warmup; w++) {
+            memset(arg->dst, 0, size);
+            time_op(op, arg, reps);
+        }
+
+        sample_set_t ss;
+        samples_init(&ss);
+        for (int r = 0; !samples_done(&ss); r++) {
+            memset(arg->dst, 0, size);
+            double t = time_op(op, arg, reps);
+            samples_add(&ss, t);
+
+            if (r < REPEAT_COUNT)
+                print_result(method, size, t, r + 1);
+            if (r == 0) {
+                size_t err = verify_pattern(arg->dst, size);
+                if (err)
+                    fprintf(stderr, "  *** データ不整合! offset=%zu ***\n", err - 1);
+                else
+                    printf("  ✓ データ検証OK\n");
+            }
+        }
+        if (arg->err)
+            fprintf(stderr, "  *** 計測中に mmap が失敗しました: %s ***\n", strerror(arg->err));
+        print_summary(method, size, ss.v, ss.n);
+        samples_free(&ss);
+        printf("\n");
+    }
+}
+
+/* 子プロセス (読み取り側): 全方式を実行 */
+static int run_reader(const char *path, size_t max_size)
+{
+    pin_from_env(ENV_IMPORTER_CPU);
+
+    void *local_buf = alloc_aligned(max_size);
+    if (!local_buf)
+        return 1;
+    memset(local_buf, 0, max_size);
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        perror("open");
+        free(local_buf);
+        return 1;
+    }
+    file_op_arg_t arg = { fd, local_buf, 0, 0, 0 };
+
+    printf("--- ファイル mmap ベンチマーク ---\n");
+    printf("  (mmap(MAP_SHARED) → ローカルバッファへ memcpy → munmap)\n\n");
+    bench_file_variant("FILE-map ", op_file_map, &arg, max_size);
+
+    printf("--- ファイル mmap + MAP_POPULATE ベンチマーク ---\n");
+    printf("  (マッピング時にページテーブルを一括作成)\n\n");
+    arg.populate = 1;
+    bench_file_variant("FILE-pop ", op_file_map, &arg, max_size);
+
+    printf("--- ファイル pread ベンチマーク ---\n");
+    printf("  (ページキャッシュからローカルバッファへ pread)\n\n");
+    bench_file_variant("FILE-read", op_file_pread, &arg, max_size);
+    close(fd);
+
+    printf("--- ファイル O_DIRECT pread ベンチマーク ---\n");
+    printf("  (ページキャッシュを経由しない)\n\n");
+    fd = open(path, O_RDONLY | O_DIRECT);
+    if (fd < 0) {
+        printf("  O_DIRECT 非対応のファイルシステム (%s), スキップ\n\n", strerror(errno));
+    } else {
+        arg.fd = fd;
+        bench_file_variant("FILE-odir", op_file_pread, &arg, max_size);
+        close(fd);
+    }
+
+    free(local_buf);
+    fflush(stdout);
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    size_t max_size = TEST_SIZES[NUM_TEST_SIZES - 1];
+    if (argc > 1) {
+        max_size = (size_t)atol(argv[1]) * 1024UL * 1024;
+    }
+    const char *path = getenv("BENCH_FILE");
+    if (!path || !*path)
+        path = DEFAULT_BENCH_FILE;
+
+    char sizebuf[64], timerbuf[128];
+    printf("=== ファイル (mmap / read / O_DIRECT) ベンチマーク ===\n");
+    printf("ファイル: %s\n", path);
+    printf("最大テストサイズ: %s\n", format_size(max_size, sizebuf, sizeof(sizebuf)));
+
+    bench_config_load();
+    timer_calibrate();
+    printf("タイマー: %s\n", timer_describe(timerbuf, sizeof(timerbuf)));
+    print_config();
+    printf("\n");
+
+    /* ===== 親プロセス (書き込み側): ファイルにパターンを書いて同期 ===== */
+    pin_from_env(ENV_EXPORTER_CPU);
+
+    int fd = open(path, O_CREAT | O_TRUNC | O_RDWR, 0644);
+    if (fd < 0) { perror("open"); return 1; }
+    if (ftruncate(fd, max_size) == -1) {
+        perror("ftruncate");
+        close(fd);
+        unlink(path);
+        return 1;
+    }
+    void *p = mmap(NULL, max_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (p == MAP_FAILED) {
+        perror("mmap");
+        close(fd);
+        unlink(path);
+        return 1;
+    }
+    fill_pattern(p, max_size);
+    msync(p, max_size, MS_SYNC);
+    munmap(p, max_size);
+    fsync(fd);
+    close(fd);
+
+    fflush(stdout);  /* 未出力のバッファを子プロセスに複製しない */
+    pid_t pid = fork();
+    if (pid == 0)
+        _exit(run_reader(path, max_size));
+
+    int status = 1;
+    waitpid(pid, &status, 0);
+    unlink(path);
+
+    printf("ベンチマーク完了\n");
+    return WIFEXITED(status) ? WEXITSTATUS(status) : 1;
+}
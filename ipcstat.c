@@ -0,0 +1,244 @@
+/*
+ * ipcstat.c - 共有統計ページの監視 (vmstat 風)
+ *
+ * xpmem_exporter / xpmem_importer / shm_bench が公開している共有統計ページ
+ * (live_stats.h) を読み取り専用で開き、一定間隔ごとの変化量を1行ずつ表示する。
+ * 計測中のプロセスを止めず、ホットループに printf を入れずに長時間の
+ * 実行やソークの様子を見るためのもの。
+ *
+ * 表示する列:
+ *   MB/s, ops/s        転送量と操作数の区間レート
+ *   flt/s, rtry/s      ページフォルトと読み直しの区間レート
+ *   p50/p99 us         区間内の1操作の時間の分位点 (log2 ヒストグラムの
+ *                      バケット上限なので2のべき乗の目安)
+ *
+ * 使い方:
+ *   ./ipcstat [-i 間隔(秒)] [-c 回数] [pid ...]
+ *   pid を省略すると /dev/shm から公開中のページを探し、後から起動した
+ *   プロセスも拾う
+ *
+ * コンパイル:
+ *   gcc -O2 -o ipcstat ipcstat.c -lrt -lm
+ */
+
+#include "common.h"
+
+#define MAX_WATCH     64
+#define HEADER_EVERY  20
+
+typedef struct {
+    pid_t pid;
+    const live_stats_t *s;
+    uint64_t bytes, ops, faults, retries;
+    uint64_t hist[STATS_HIST_BUCKETS];
+} watch_t;
+
+static watch_t g_watch[MAX_WATCH];
+static int g_num_watch;
+static volatile sig_atomic_t g_stop;
+
+static void stop_handler(int sig)
+{
+    (void)sig;
+    g_stop = 1;
+}
+
+static int process_alive(pid_t pid)
+{
+    return kill(pid, 0) == 0 || errno == EPERM;
+}
+
+/* 前回値を今の値にそろえる */
+static void watch_snapshot(watch_t *w)
+{
+    w->bytes = atomic_load_explicit(&w->s->bytes, memory_order_relaxed);
+    w->ops = atomic_load_explicit(&w->s->ops, memory_order_relaxed);
+    w->faults = atomic_load_explicit(&w->s->faults, memory_order_relaxed);
+    w->retries = atomic_load_explicit(&w->s->retries, memory_order_relaxed);
+    for (int b = 0; b < STATS_HIST_BUCKETS; b++)
+        w->hist[b] = atomic_load_explicit(&w->s->hist[b], memory_order_relaxed);
+}
+
+/* pid の統計ページを読み取り専用で開いて監視対象に加える */
+static int watch_add(pid_t pid, int quiet)
+{
+    for (int i = 0; i < g_num_watch; i++)
+        if (g_watch[i].pid == pid)
+            return 0;
+    if (g_num_watch >= MAX_WATCH || !process_alive(pid))
+        return -1;
+
+    char name[64];
+    stats_shm_name(pid, name, sizeof(name));
+    int fd = shm_open(name, O_RDONLY, 0);
+    if (fd < 0) {
+        if (!quiet)
+            fprintf(stderr, "%s を開けません: %s\n", name, strerror(errno));
+        return -1;
+    }
+    struct stat st;
+    void *p = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && (size_t)st.st_size >= sizeof(live_stats_t))
+        p = mmap(NULL, sizeof(live_stats_t), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED)
+        return -1;
+
+    const live_stats_t *s = (const live_stats_t *)p;
+    if (atomic_load_explicit(&s->magic, memory_order_acquire) != STATS_MAGIC) {
+        munmap(p, sizeof(live_stats_t));
+        return -1;
+    }
+    watch_t *w = &g_watch[g_num_watch++];
+    w->pid = pid;
+    w->s = s;
+    watch_snapshot(w);
+    return 0;
+}
+
+/* 監視をやめる。持ち主が終わっていれば、シグナル等で残った名前も消す */
+static void watch_remove(int i)
+{
+    if (!process_alive(g_watch[i].pid)) {
+        char name[64];
+        stats_shm_name(g_watch[i].pid, name, sizeof(name));
+        shm_unlink(name);
+    }
+    munmap((void *)g_watch[i].s, sizeof(live_stats_t));
+    g_watch[i] = g_watch[--g_num_watch];
+}
+
+/* /dev/shm から公開中のページを探す (持ち主の死んだページは消す) */
+static void watch_scan(void)
+{
+    stats_reap_stale();
+    DIR *d = opendir("/dev/shm");
+    if (!d)
+        return;
+    const char *prefix = STATS_SHM_PREFIX + 1;   /* 先頭の '/' を除く */
+    size_t plen = strlen(prefix);
+    struct dirent *de;
+    while ((de = readdir(d)) != NULL) {
+        if (strncmp(de->d_name, prefix, plen) == 0)
+            watch_add((pid_t)atoi(de->d_name + plen), 1);
+    }
+    closedir(d);
+}
+
+/* ヒストグラムの差分から分位点 p のバケット上限 (us)。操作が無ければ負 */
+static double hist_percentile(const uint64_t *delta, uint64_t total, double p)
+{
+    if (total == 0)
+        return -1;
+    uint64_t want = (uint64_t)(p * (double)(total - 1)) + 1, seen = 0;
+    for (int b = 0; b < STATS_HIST_BUCKETS; b++) {
+        seen += delta[b];
+        if (seen >= want)
+            return (double)(1ULL << b) / 1e3;
+    }
+    return (double)(1ULL << (STATS_HIST_BUCKETS - 1)) / 1e3;
+}
+
+static void print_header(void)
+{
+    printf("%-8s %7s %-10s %-24s %10s %11s %8s %8s %9s %9s\n",
+           "time", "pid", "role", "phase", "MB/s", "ops/s", "flt/s", "rtry/s",
+           "p50 us", "p99 us");
+}
+
+static void print_row(watch_t *w, double dt, const char *clock)
+{
+    watch_t prev = *w;
+    watch_snapshot(w);
+
+    uint64_t delta[STATS_HIST_BUCKETS], total = 0;
+    for (int b = 0; b < STATS_HIST_BUCKETS; b++) {
+        delta[b] = w->hist[b] - prev.hist[b];
+        total += delta[b];
+    }
+    char phase[STATS_PHASE_LEN], p50[16] = "-", p99[16] = "-";
+    stats_read_phase(w->s, phase, sizeof(phase));
+    if (total > 0) {
+        snprintf(p50, sizeof(p50), "%.3f", hist_percentile(delta, total, 0.50));
+        snprintf(p99, sizeof(p99), "%.3f", hist_percentile(delta, total, 0.99));
+    }
+    printf("%-8s %7d %-10.10s %-24.24s %10.1f %11.0f %8.0f %8.0f %9s %9s\n",
+           clock, (int)w->pid, w->s->role, phase,
+           (double)(w->bytes - prev.bytes) / dt / (1024.0 * 1024),
+           (double)(w->ops - prev.ops) / dt,
+           (double)(w->faults - prev.faults) / dt,
+           (double)(w->retries - prev.retries) / dt, p50, p99);
+}
+
+int main(int argc, char *argv[])
+{
+    double interval = 1.0;
+    long count = 0;
+    int opt;
+    while ((opt = getopt(argc, argv, "i:c:h")) != -1) {
+        switch (opt) {
+        case 'i':
+            interval = atof(optarg);
+            break;
+        case 'c':
+            count = atol(optarg);
+            break;
+        default:
+            fprintf(stderr, "使い方: %s [-i 間隔(秒)] [-c 回数] [pid ...]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (interval <= 0)
+        interval = 1.0;
+
+    int scan = optind >= argc;
+    for (int i = optind; i < argc; i++)
+        watch_add((pid_t)atoi(argv[i]), 0);
+    if (scan)
+        watch_scan();
+    if (!scan && g_num_watch == 0)
+        return 1;
+
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = stop_handler;
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+
+    printf("ipcstat: %.1f 秒ごと, 監視中 %d プロセス%s\n", interval, g_num_watch,
+           scan ? " (新しいプロセスも探す)" : "");
+    int rows = 0;
+    double prev = get_time_sec();
+    for (long n = 0; !g_stop && (count <= 0 || n < count); n++) {
+        struct timespec ts = { (time_t)interval, (long)((interval - (time_t)interval) * 1e9) };
+        nanosleep(&ts, NULL);
+        if (g_stop)
+            break;
+        double now = get_time_sec(), dt = now - prev;
+        prev = now;
+
+        char clock[16];
+        time_t t = time(NULL);
+        strftime(clock, sizeof(clock), "%H:%M:%S", localtime(&t));
+
+        for (int i = 0; i < g_num_watch; ) {
+            if (!process_alive(g_watch[i].pid)) {
+                printf("%-8s %7d %-10.10s (終了)\n", clock, (int)g_watch[i].pid,
+                       g_watch[i].s->role);
+                watch_remove(i);
+                continue;
+            }
+            if (rows++ % HEADER_EVERY == 0)
+                print_header();
+            print_row(&g_watch[i], dt, clock);
+            i++;
+        }
+        fflush(stdout);
+
+        if (scan)
+            watch_scan();
+        else if (g_num_watch == 0)
+            break;
+    }
+    return 0;
+}
@@ -0,0 +1,341 @@
+/*
+ * kernels.h - ソフトウェアプリフェッチ付きのコピー/走査カーネル
+ *
+ * ハードウェアプリフェッチャは 4KB ページ境界を越えて先読みしないため、
+ * 現在位置から dist バイト先のキャッシュラインを明示的にプリフェッチする
+ * 版を用意し、xpmem でアタッチしたリモートのページで効くかを調べる。
+ *   PF_T0   prefetcht0  (全レベルのキャッシュへ)
+ *   PF_NTA  prefetchnta (キャッシュ汚染を抑える非テンポラル)
+ *   PF_NONE 同じループでプリフェッチだけしない (プリフェッチの効果だけを比べる基準)
+ * PF_OFF は common.h の op_memcpy / op_read_scan と同じ処理になる。
+ *
+ * memcpy / 直接アクセスのベンチマークで使うカーネルは BENCH_PREFETCH
+ * (off | t0 | nta | none, 既定 off) で選ぶ。距離の設定は common.h を参照。
+ *
+ * 後半は転送の整合性検査用のチェックサム (CRC32C と xxHash64)。
+ * コピーしながら計算する融合版と、計算だけの版がある。
+ */
+
+#ifndef KERNELS_H
+#define KERNELS_H
+
+#include "common.h"
+
+#define KERNEL_LINE 64
+
+enum {
+    PF_OFF = 0,
+    PF_T0,
+    PF_NTA,
+    PF_NONE,
+};
+
+static const char *const PF_NAMES[] = { "off", "t0", "nta", "none" };
+
+/* 先頭は mem_op_arg_t なので op_memcpy / op_read_scan にもそのまま渡せる */
+typedef struct {
+    mem_op_arg_t m;
+    int hint;           /* PF_* */
+    size_t dist;        /* 先読み距離 (bytes, KERNEL_LINE の倍数に切り上げ) */
+} kernel_arg_t;
+
+/* __builtin_prefetch の局所性は定数でなければならないので分岐で選ぶ */
+static inline void prefetch_line(const void *p, int hint)
+{
+    if (hint == PF_NONE)
+        return;
+    if (hint == PF_NTA)
+        __builtin_prefetch(p, 0, 0);
+    else
+        __builtin_prefetch(p, 0, 3);
+}
+
+/* dist 先をプリフェッチしながら1ラインずつコピーする */
+static inline void copy_prefetch(void *dst, const void *src, size_t size,
+                                 size_t dist, int hint)
+{
+    char *d = (char *)dst;
+    const char *s = (const char *)src;
+    size_t i = 0;
+
+    /* 領域の外はプリフェッチしない (xpmem の範囲外は未マップのことがある) */
+    size_t end = size > dist ? (size - dist) & ~(size_t)(KERNEL_LINE - 1) : 0;
+    for (; i < end; i += KERNEL_LINE) {
+        prefetch_line(s + i + dist, hint);
+        memcpy(d + i, s + i, KERNEL_LINE);
+    }
+    memcpy(d + i, s + i, size - i);
+}
+
+/* dist 先をプリフェッチしながら 8 バイトずつ読んで合計する */
+static inline uint64_t scan_prefetch(const void *src, size_t size, size_t dist, int hint)
+{
+    const uint64_t *p = (const uint64_t *)src;
+    size_t count = size / sizeof(uint64_t);
+    size_t per_line = KERNEL_LINE / sizeof(uint64_t);
+    size_t ahead = dist / sizeof(uint64_t);
+    size_t end = count > ahead ? (count - ahead) / per_line * per_line : 0;
+    uint64_t sum = 0;
+    size_t i = 0;
+
+    for (; i < end; i += per_line) {
+        prefetch_line(p + i + ahead, hint);
+        for (size_t j = 0; j < per_line; j++)
+            sum += p[i + j];
+    }
+    for (; i < count; i++)
+        sum += p[i];
+    return sum;
+}
+
+static inline void op_copy_kernel(void *arg)
+{
+    kernel_arg_t *a = (kernel_arg_t *)arg;
+    if (a->hint == PF_OFF) {
+        op_memcpy(&a->m);
+        return;
+    }
+    copy_prefetch(a->m.dst, a->m.src, a->m.size, a->dist, a->hint);
+    __asm__ volatile("" ::: "memory");
+}
+
+static inline void op_scan_kernel(void *arg)
+{
+    kernel_arg_t *a = (kernel_arg_t *)arg;
+    if (a->hint == PF_OFF) {
+        op_read_scan(&a->m);
+        return;
+    }
+    uint64_t sum = scan_prefetch(a->m.src, a->m.size, a->dist, a->hint);
+    a->m.sum += sum;
+    __asm__ volatile("" :: "r"(sum) : "memory");
+}
+
+static inline void kernel_set(kernel_arg_t *a, int hint, size_t dist)
+{
+    a->hint = hint;
+    a->dist = (dist + KERNEL_LINE - 1) & ~(size_t)(KERNEL_LINE - 1);
+    if (a->hint != PF_OFF && a->dist == 0)
+        a->dist = KERNEL_LINE;
+}
+
+/* BENCH_PREFETCH / BENCH_PREFETCH_DIST を読む。不明な名前は off */
+static inline void kernel_config_load(kernel_arg_t *a)
+{
+    const char *s = getenv("BENCH_PREFETCH");
+    int hint = PF_OFF;
+    for (int h = 0; s && h < (int)(sizeof(PF_NAMES) / sizeof(PF_NAMES[0])); h++)
+        if (strcmp(s, PF_NAMES[h]) == 0)
+            hint = h;
+    kernel_set(a, hint, (size_t)env_long("BENCH_PREFETCH_DIST", DEFAULT_PREFETCH_DIST));
+}
+
+/* 表示名: off なら base のまま、それ以外は "base-t0-d512" */
+static inline const char *kernel_label(const char *base, const kernel_arg_t *a,
+                                       char *buf, size_t buflen)
+{
+    if (a->hint == PF_OFF)
+        snprintf(buf, buflen, "%s", base);
+    else
+        snprintf(buf, buflen, "%s-%s-d%zu", base, PF_NAMES[a->hint], a->dist);
+    return buf;
+}
+
+/* ========== チェックサム (CRC32C / xxHash64) ========== */
+
+#define CRC32C_POLY 0x82F63B78u     /* Castagnoli (反転表現) */
+
+#ifndef __SSE4_2__
+/* crc32 命令が無い場合のテーブル版 (1バイトずつ) */
+static uint32_t crc32c_table[256];
+
+static inline void crc32c_table_init(void)
+{
+    if (crc32c_table[1])
+        return;
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t c = i;
+        for (int k = 0; k < 8; k++)
+            c = (c >> 1) ^ (CRC32C_POLY & (0u - (c & 1)));
+        crc32c_table[i] = c;
+    }
+}
+#endif
+
+static inline uint32_t crc32c_u8(uint32_t crc, uint8_t v)
+{
+#ifdef __SSE4_2__
+    return _mm_crc32_u8(crc, v);
+#else
+    crc32c_table_init();
+    return crc32c_table[(crc ^ v) & 0xFF] ^ (crc >> 8);
+#endif
+}
+
+static inline uint32_t crc32c_u64(uint32_t crc, uint64_t v)
+{
+#ifdef __SSE4_2__
+    return (uint32_t)_mm_crc32_u64(crc, v);
+#else
+    for (int k = 0; k < 8; k++)
+        crc = crc32c_u8(crc, (uint8_t)(v >> (k * 8)));
+    return crc;
+#endif
+}
+
+/* CRC32C を計算しながら src → dst へコピーする。dst が NULL なら計算だけ */
+static inline uint32_t copy_crc32c(void *dst, const void *src, size_t size)
+{
+    char *d = (char *)dst;
+    const char *s = (const char *)src;
+    uint32_t crc = ~0u;
+    size_t i = 0;
+
+    for (; i + 8 <= size; i += 8) {
+        uint64_t v;
+        memcpy(&v, s + i, 8);
+        if (d)
+            memcpy(d + i, &v, 8);
+        crc = crc32c_u64(crc, v);
+    }
+    for (; i < size; i++) {
+        if (d)
+            d[i] = s[i];
+        crc = crc32c_u8(crc, (uint8_t)s[i]);
+    }
+    return ~crc;
+}
+
+static inline uint32_t crc32c(const void *buf, size_t size)
+{
+    return copy_crc32c(NULL, buf, size);
+}
+
+/* xxHash64 (公開仕様どおり。seed は 0 で使う) */
+#define XXH_PRIME64_1 0x9E3779B185EBCA87ULL
+#define XXH_PRIME64_2 0xC2B2AE3D27D4EB4FULL
+#define XXH_PRIME64_3 0x165667B19E3779F9ULL
+#define XXH_PRIME64_4 0x85EBCA77C2B2CA63ULL
+#define XXH_PRIME64_5 0x27D4EB2F165667C5ULL
+
+static inline uint64_t xxh_rotl64(uint64_t x, int r)
+{
+    return (x << r) | (x >> (64 - r));
+}
+
+static inline uint64_t xxh64_round(uint64_t acc, uint64_t input)
+{
+    acc += input * XXH_PRIME64_2;
+    acc = xxh_rotl64(acc, 31);
+    return acc * XXH_PRIME64_1;
+}
+
+static inline uint64_t xxh64_merge(uint64_t acc, uint64_t val)
+{
+    acc ^= xxh64_round(0, val);
+    return acc * XXH_PRIME64_1 + XXH_PRIME64_4;
+}
+
+/* xxHash64 を計算しながら src → dst へコピーする。dst が NULL なら計算だけ */
+static inline uint64_t copy_xxh64(void *dst, const void *src, size_t size)
+{
+    char *d = (char *)dst;
+    const char *s = (const char *)src;
+    const uint64_t seed = 0;
+    uint64_t h;
+    size_t i = 0;
+
+    if (size >= 32) {
+        uint64_t v1 = seed + XXH_PRIME64_1 + XXH_PRIME64_2;
+        uint64_t v2 = seed + XXH_PRIME64_2;
+        uint64_t v3 = seed;
+        uint64_t v4 = seed - XXH_PRIME64_1;
+        /* 32 バイトのストライプを4本の独立したレーンで処理する */
+        for (; i + 32 <= size; i += 32) {
+            uint64_t w[4];
+            memcpy(w, s + i, 32);
+            if (d)
+                memcpy(d + i, w, 32);
+            v1 = xxh64_round(v1, w[0]);
+            v2 = xxh64_round(v2, w[1]);
+            v3 = xxh64_round(v3, w[2]);
+            v4 = xxh64_round(v4, w[3]);
+        }
+        h = xxh_rotl64(v1, 1) + xxh_rotl64(v2, 7) + xxh_rotl64(v3, 12) + xxh_rotl64(v4, 18);
+        h = xxh64_merge(h, v1);
+        h = xxh64_merge(h, v2);
+        h = xxh64_merge(h, v3);
+        h = xxh64_merge(h, v4);
+    } else {
+        h = seed + XXH_PRIME64_5;
+    }
+    h += (uint64_t)size;
+
+    if (d)
+        memcpy(d + i, s + i, size - i);
+    for (; i + 8 <= size; i += 8) {
+        uint64_t k;
+        memcpy(&k, s + i, 8);
+        h ^= xxh64_round(0, k);
+        h = xxh_rotl64(h, 27) * XXH_PRIME64_1 + XXH_PRIME64_4;
+    }
+    if (i + 4 <= size) {
+        uint32_t k;
+        memcpy(&k, s + i, 4);
+        h ^= (uint64_t)k * XXH_PRIME64_1;
+        h = xxh_rotl64(h, 23) * XXH_PRIME64_2 + XXH_PRIME64_3;
+        i += 4;
+    }
+    for (; i < size; i++) {
+        h ^= (uint8_t)s[i] * XXH_PRIME64_5;
+        h = xxh_rotl64(h, 11) * XXH_PRIME64_1;
+    }
+
+    h ^= h >> 33;
+    h *= XXH_PRIME64_2;
+    h ^= h >> 29;
+    h *= XXH_PRIME64_3;
+    h ^= h >> 32;
+    return h;
+}
+
+static inline uint64_t xxh64(const void *buf, size_t size)
+{
+    return copy_xxh64(NULL, buf, size);
+}
+
+/* チェックサム付きコピーの1操作 */
+enum {
+    CSUM_NONE = 0,
+    CSUM_CRC32C,
+    CSUM_XXH64,
+};
+
+typedef struct {
+    mem_op_arg_t m;
+    int algo;           /* CSUM_* */
+    int fused;          /* 1: コピーしながら計算, 0: コピー後に dst を読み直す */
+    uint64_t csum;      /* 直前の操作で得たチェックサム */
+} csum_op_arg_t;
+
+static inline void op_copy_csum(void *arg)
+{
+    csum_op_arg_t *a = (csum_op_arg_t *)arg;
+    void *dst = a->m.dst;
+    size_t size = a->m.size;
+
+    if (a->algo == CSUM_NONE) {
+        op_memcpy(&a->m);
+        return;
+    }
+    if (a->fused) {
+        a->csum = a->algo == CSUM_CRC32C ? copy_crc32c(dst, a->m.src, size)
+                                         : copy_xxh64(dst, a->m.src, size);
+    } else {
+        memcpy(dst, a->m.src, size);
+        a->csum = a->algo == CSUM_CRC32C ? crc32c(dst, size) : xxh64(dst, size);
+    }
+    __asm__ volatile("" :: "r"(a->csum) : "memory");
+}
+
+#endif /* KERNELS_H */
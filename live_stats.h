@@ -0,0 +1,210 @@
+/*
+ * live_stats.h - 実行中の計測を外から見るための共有統計ページ
+ *
+ * xpmem_exporter / xpmem_importer / shm_bench は起動時に
+ * POSIX 共有メモリ STATS_SHM_PREFIX<pid> を作り、ロックなしのカウンタを
+ * 更新し続ける:
+ *   bytes / ops   転送したバイト数と操作数
+ *   faults        ページフォルト数 (getrusage の minflt + majflt)
+ *   retries       seqlock の読み直しなど
+ *   phase         実行中の計測 (方式名)
+ *   hist          1操作の時間 (ns) の log2 ヒストグラム
+ * 更新は計測区間の外 (time_op の後など) でまとめて行い、ホットループには
+ * 入れない。ipcstat がこのページを読み取り専用で開き、1秒ごとの
+ * 変化量を表示する。BENCH_LIVE_STATS=0 で作らない。
+ * 名前は終了時 (atexit) に消すが、シグナルやクラッシュで終わると残るので、
+ * stats_open() と ipcstat が持ち主の死んだページを掃除する。
+ */
+
+#ifndef LIVE_STATS_H
+#define LIVE_STATS_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <signal.h>
+#include <dirent.h>
+#include <stdatomic.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+
+#define STATS_SHM_PREFIX   "/xpmem_bench_stats."
+#define STATS_MAGIC        0x5354415453504d58ULL   /* "XMPSTATS" */
+#define STATS_HIST_BUCKETS 40                      /* 1 ns .. 2^39 ns */
+#define STATS_PHASE_LEN    64
+#define STATS_ROLE_LEN     24
+
+typedef struct {
+    _Atomic uint64_t magic;     /* 初期化を終えてから書く */
+    int32_t pid;
+    char role[STATS_ROLE_LEN];
+    _Alignas(64) _Atomic uint64_t bytes;
+    _Atomic uint64_t ops;
+    _Atomic uint64_t faults;
+    _Atomic uint64_t retries;
+    _Atomic uint32_t phase_seq; /* phase を書き換え中は奇数 */
+    char phase[STATS_PHASE_LEN];
+    _Atomic uint64_t hist[STATS_HIST_BUCKETS];
+} live_stats_t;
+
+static live_stats_t *g_stats;
+static size_t g_stats_op_bytes;     /* 現在の計測の1操作あたりのバイト数 */
+static pid_t g_stats_owner;
+
+static inline void stats_shm_name(pid_t pid, char *buf, size_t len)
+{
+    snprintf(buf, len, STATS_SHM_PREFIX "%d", (int)pid);
+}
+
+/* 作成したプロセスだけが名前を消す (fork した子は触らない) */
+static inline void stats_close(void)
+{
+    if (!g_stats)
+        return;
+    munmap(g_stats, sizeof(*g_stats));
+    g_stats = NULL;
+    if (getpid() == g_stats_owner) {
+        char name[64];
+        stats_shm_name(g_stats_owner, name, sizeof(name));
+        shm_unlink(name);
+    }
+}
+
+/*
+ * /dev/shm に残った、持ち主のプロセスがもう居ないページの名前を消す。
+ * そのままだと pid が再利用されたときに古いカウンタが見えてしまう
+ */
+static inline void stats_reap_stale(void)
+{
+    DIR *d = opendir("/dev/shm");
+    if (!d)
+        return;
+    const char *prefix = STATS_SHM_PREFIX + 1;   /* 先頭の '/' を除く */
+    size_t plen = strlen(prefix);
+    struct dirent *de;
+    while ((de = readdir(d)) != NULL) {
+        if (strncmp(de->d_name, prefix, plen) != 0)
+            continue;
+        pid_t pid = (pid_t)atoi(de->d_name + plen);
+        if (pid > 0 && kill(pid, 0) != 0 && errno == ESRCH) {
+            char name[64];
+            stats_shm_name(pid, name, sizeof(name));
+            shm_unlink(name);
+        }
+    }
+    closedir(d);
+}
+
+static inline void stats_open(const char *role)
+{
+    const char *e = getenv("BENCH_LIVE_STATS");
+    if (e && strcmp(e, "0") == 0)
+        return;
+    stats_reap_stale();
+
+    char name[64];
+    g_stats_owner = getpid();
+    stats_shm_name(g_stats_owner, name, sizeof(name));
+    int fd = shm_open(name, O_CREAT | O_RDWR | O_TRUNC, 0644);
+    if (fd < 0)
+        return;
+    if (ftruncate(fd, sizeof(live_stats_t)) != 0) {
+        close(fd);
+        shm_unlink(name);
+        return;
+    }
+    void *p = mmap(NULL, sizeof(live_stats_t), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED) {
+        shm_unlink(name);
+        return;
+    }
+    g_stats = (live_stats_t *)p;
+    g_stats->pid = (int32_t)g_stats_owner;
+    snprintf(g_stats->role, sizeof(g_stats->role), "%s", role);
+    snprintf(g_stats->phase, sizeof(g_stats->phase), "start");
+    atomic_store_explicit(&g_stats->magic, STATS_MAGIC, memory_order_release);
+    atexit(stats_close);
+}
+
+/* 実行中の計測を切り替える。op_bytes は以降の1操作のバイト数 */
+static inline void stats_phase(const char *phase, size_t op_bytes)
+{
+    g_stats_op_bytes = op_bytes;
+    if (!g_stats)
+        return;
+    uint32_t s = atomic_load_explicit(&g_stats->phase_seq, memory_order_relaxed);
+    atomic_store_explicit(&g_stats->phase_seq, s + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    snprintf(g_stats->phase, sizeof(g_stats->phase), "%.*s", STATS_PHASE_LEN - 1, phase);
+    atomic_store_explicit(&g_stats->phase_seq, s + 2, memory_order_release);
+}
+
+/*
+ * 前回からのページフォルト数を足し込む。fork した子もページを共有するので
+ * 値を上書きせず、プロセスごとに前回値を持つ
+ */
+static inline void stats_faults(void)
+{
+    static pid_t pid;
+    static uint64_t last;
+    struct rusage ru;
+    if (!g_stats || getrusage(RUSAGE_SELF, &ru) != 0)
+        return;
+    if (pid != getpid()) {
+        pid = getpid();
+        last = 0;
+    }
+    uint64_t cur = (uint64_t)(ru.ru_minflt + ru.ru_majflt);
+    atomic_fetch_add_explicit(&g_stats->faults, cur - last, memory_order_relaxed);
+    last = cur;
+}
+
+/* 1操作 sec_per_op 秒の操作を n 回行った (バイト数は stats_phase の op_bytes) */
+static inline void stats_record(uint64_t n, double sec_per_op)
+{
+    if (!g_stats)
+        return;
+    uint64_t ns = (uint64_t)(sec_per_op * 1e9);
+    int b = ns ? 64 - __builtin_clzll(ns) : 0;
+    if (b >= STATS_HIST_BUCKETS)
+        b = STATS_HIST_BUCKETS - 1;
+    atomic_fetch_add_explicit(&g_stats->ops, n, memory_order_relaxed);
+    atomic_fetch_add_explicit(&g_stats->bytes, n * g_stats_op_bytes, memory_order_relaxed);
+    atomic_fetch_add_explicit(&g_stats->hist[b], n, memory_order_relaxed);
+}
+
+/* 時間を測らない処理 (エクスポータの書き換えなど) の操作数とバイト数 */
+static inline void stats_add(uint64_t ops, uint64_t bytes)
+{
+    if (!g_stats)
+        return;
+    atomic_fetch_add_explicit(&g_stats->ops, ops, memory_order_relaxed);
+    atomic_fetch_add_explicit(&g_stats->bytes, bytes, memory_order_relaxed);
+}
+
+static inline void stats_retries(uint64_t n)
+{
+    if (g_stats)
+        atomic_fetch_add_explicit(&g_stats->retries, n, memory_order_relaxed);
+}
+
+/* 読み手: phase を破れずに読む */
+static inline void stats_read_phase(const live_stats_t *s, char *buf, size_t len)
+{
+    for (;;) {
+        uint32_t s1 = atomic_load_explicit(&s->phase_seq, memory_order_acquire);
+        if (s1 & 1)
+            continue;
+        snprintf(buf, len, "%.*s", STATS_PHASE_LEN - 1, s->phase);
+        atomic_thread_fence(memory_order_acquire);
+        if (atomic_load_explicit(&s->phase_seq, memory_order_relaxed) == s1)
+            return;
+    }
+}
+
+#endif /* LIVE_STATS_H */
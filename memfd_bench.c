@@ -0,0 +1,379 @@
+/*
+ * memfd_bench.c - 封印 (seal) した memfd の SCM_RIGHTS 受け渡しベンチマーク
+ *
+ * xpmem との比較のため、エクスポータが memfd にデータを書いて
+ * F_SEAL_WRITE / F_SEAL_SHRINK / F_SEAL_GROW で封印し、その fd を
+ * UNIX ソケットの SCM_RIGHTS でインポータへ渡す方式を計測する。
+ * インポータは封印を自分で確認してから読み取り専用でマップするので、
+ * 送り手を信用しなくても内容が書き換わらないゼロコピーのバッファになる。
+ *
+ * 親プロセス (エクスポータ) → fork() した子プロセス (インポータ):
+ *   MEMFD-hand  fd 送信 → 子が受信・封印確認・mmap・munmap・close → 応答
+ *               (親が往復を計測。xpmem-att と比べる)
+ *   MEMFD-tch   子が mmap 直後に全ページの先頭を読む (ファーストタッチ込み。
+ *               xpmem-tch と比べる)
+ *   MEMFD-cpy   マップ済みの領域からローカルバッファへ memcpy
+ *   MEMFD-dir   マップ済みの領域を直接走査 (ゼロコピー)
+ *
+ * 使い方:
+ *   ./memfd_bench [最大テストサイズ(MB)]
+ *
+ * コンパイル:
+ *   gcc -O2 -o memfd_bench memfd_bench.c -lrt -lm
+ */
+
+#include "common.h"
+#include <sys/socket.h>
+#include <sys/wait.h>
+
+/* インポータが要求する封印 */
+#define REQUIRED_SEALS (F_SEAL_WRITE | F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL)
+
+/* 親 → 子の指示 (fd は SCM_RIGHTS で添付) */
+enum {
+    MFD_CMD_HANDOFF = 0,    /* 受信してマップ・解放するだけ */
+    MFD_CMD_BENCH,          /* この fd で MEMFD-tch / cpy / dir を計測 */
+    MFD_CMD_EXIT,
+};
+
+typedef struct {
+    int cmd;
+    size_t size;
+} memfd_cmd_t;
+
+/* 子 → 親: 応答バイト */
+#define ACK_OK   1
+#define ACK_BAD  2
+
+/* ========== SCM_RIGHTS ========== */
+
+static int send_fd(int sock, const memfd_cmd_t *cmd, int fd)
+{
+    char ctrl[CMSG_SPACE(sizeof(int))];
+    struct iovec iov = { (void *)cmd, sizeof(*cmd) };
+    struct msghdr msg = { 0 };
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+
+    if (fd >= 0) {
+        memset(ctrl, 0, sizeof(ctrl));
+        msg.msg_control = ctrl;
+        msg.msg_controllen = sizeof(ctrl);
+        struct cmsghdr *c = CMSG_FIRSTHDR(&msg);
+        c->cmsg_level = SOL_SOCKET;
+        c->cmsg_type = SCM_RIGHTS;
+        c->cmsg_len = CMSG_LEN(sizeof(int));
+        memcpy(CMSG_DATA(c), &fd, sizeof(int));
+    }
+
+    ssize_t n;
+    do {
+        n = sendmsg(sock, &msg, 0);
+    } while (n < 0 && errno == EINTR);
+    return n == (ssize_t)sizeof(*cmd) ? 0 : -1;
+}
+
+/* 指示を受け取る。fd が添付されていなければ *fd = -1 */
+static int recv_fd(int sock, memfd_cmd_t *cmd, int *fd)
+{
+    char ctrl[CMSG_SPACE(sizeof(int))];
+    struct iovec iov = { cmd, sizeof(*cmd) };
+    struct msghdr msg = { 0 };
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = ctrl;
+    msg.msg_controllen = sizeof(ctrl);
+
+    ssize_t n;
+    do {
+        n = recvmsg(sock, &msg, MSG_CMSG_CLOEXEC);
+    } while (n < 0 && errno == EINTR);
+    if (n != (ssize_t)sizeof(*cmd))
+        return -1;
+
+    *fd = -1;
+    struct cmsghdr *c = CMSG_FIRSTHDR(&msg);
+    if (c && c->cmsg_level == SOL_SOCKET && c->cmsg_type == SCM_RIGHTS)
+        memcpy(fd, CMSG_DATA(c), sizeof(int));
+    return 0;
+}
+
+/*
+ * 受け取った fd を検証して読み取り専用でマップする。
+ * 封印が足りない・サイズが合わない場合は送り手を信用せず拒否する。
+ */
+static void *map_sealed(int fd, size_t size)
+{
+    int seals = fcntl(fd, F_GET_SEALS);
+    if (seals < 0 || (seals & REQUIRED_SEALS) != REQUIRED_SEALS)
+        return NULL;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < size)
+        return NULL;
+    void *p = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+    return p == MAP_FAILED ? NULL : p;
+}
+
+/* ========== 子プロセス (インポータ) ========== */
+
+typedef struct {
+    int fd;
+    size_t size;
+    uint64_t sum;
+} touch_op_arg_t;
+
+/* mmap → 全ページにファーストタッチ → munmap */
+static void op_map_touch(void *arg)
+{
+    touch_op_arg_t *a = (touch_op_arg_t *)arg;
+    void *p = mmap(NULL, a->size, PROT_READ, MAP_SHARED, a->fd, 0);
+    if (p == MAP_FAILED)
+        return;
+    a->sum += touch_pages(p, a->size);
+    munmap(p, a->size);
+}
+
+static void child_bench(const char *method, bench_op_fn op, void *arg, size_t size,
+                        void *verify_buf)
+{
+    int reps = calibrate_inner_reps(op, arg);
+    printf("  内側ループ: %d 回/サンプル\n", reps);
+
+    for (int w = 0; w < g_cfg.warmup; w++)
+        time_op(op, arg, reps);
+
+    sample_set_t ss;
+    samples_init(&ss);
+    for (int r = 0; !samples_done(&ss); r++) {
+        if (verify_buf)
+            memset(verify_buf, 0, size);
+        double t = time_op(op, arg, reps);
+        samples_add(&ss, t);
+
+        if (r < REPEAT_COUNT)
+            print_result(method, size, t, r + 1);
+        if (r == 0 && verify_buf) {
+            size_t err = verify_pattern(verify_buf, size);
+            if (err)
+                fprintf(stderr, "  *** データ不整合! offset=%zu ***\n", err - 1);
+            else
+                printf("  ✓ データ検証OK\n");
+        }
+    }
+    print_summary(method, size, ss.v, ss.n);
+    samples_free(&ss);
+    printf("\n");
+}
+
+/* 1サイズ分の MEMFD-tch / MEMFD-cpy / MEMFD-dir */
+static int child_bench_size(int fd, size_t size, void *local_buf)
+{
+    const void *mapped = map_sealed(fd, size);
+    if (!mapped) {
+        fprintf(stderr, "  *** 封印されていない / 不正な memfd を拒否 ***\n");
+        return -1;
+    }
+
+    touch_op_arg_t t_op = { fd, size, 0 };
+    printf("  [MEMFD-tch] mmap + ファーストタッチ + munmap\n");
+    child_bench("MEMFD-tch", op_map_touch, &t_op, size, NULL);
+
+    mem_op_arg_t c_op = { local_buf, mapped, size, 0 };
+    printf("  [MEMFD-cpy] マップ済み memfd → ローカルバッファへ memcpy\n");
+    child_bench("MEMFD-cpy", op_memcpy, &c_op, size, local_buf);
+
+    mem_op_arg_t d_op = { NULL, mapped, size, 0 };
+    printf("  [MEMFD-dir] マップ済み memfd を直接走査\n");
+    child_bench("MEMFD-dir", op_read_scan, &d_op, size, NULL);
+
+    munmap((void *)mapped, size);
+    return 0;
+}
+
+static int run_importer(int sock, size_t max_size)
+{
+    pin_from_env(ENV_IMPORTER_CPU);
+
+    void *local_buf = alloc_aligned(max_size);
+    if (!local_buf)
+        return 1;
+    memset(local_buf, 0, max_size);
+
+    memfd_cmd_t cmd;
+    int fd;
+    while (recv_fd(sock, &cmd, &fd) == 0 && cmd.cmd != MFD_CMD_EXIT) {
+        unsigned char ack = ACK_OK;
+        if (fd < 0) {
+            ack = ACK_BAD;
+        } else if (cmd.cmd == MFD_CMD_HANDOFF) {
+            void *p = map_sealed(fd, cmd.size);
+            if (p)
+                munmap(p, cmd.size);
+            else
+                ack = ACK_BAD;
+        } else if (child_bench_size(fd, cmd.size, local_buf) != 0) {
+            ack = ACK_BAD;
+        }
+        if (fd >= 0)
+            close(fd);
+
+        fflush(stdout);  /* 親の出力と混ざらないよう応答前に出す */
+        if (sock_send_all(sock, &ack, 1) != 0)
+            break;
+    }
+
+    free(local_buf);
+    return 0;
+}
+
+/* ========== 親プロセス (エクスポータ) ========== */
+
+/* size バイトの memfd を作り、パターンを書いて封印する */
+static int make_sealed_memfd(size_t size)
+{
+    int fd = memfd_create("xpmem_bench_memfd", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    if (fd < 0) {
+        perror("memfd_create");
+        return -1;
+    }
+    if (ftruncate(fd, size) != 0) {
+        perror("ftruncate");
+        close(fd);
+        return -1;
+    }
+    void *p = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (p == MAP_FAILED) {
+        perror("mmap");
+        close(fd);
+        return -1;
+    }
+    fill_pattern(p, size);
+    /* F_SEAL_WRITE は書き込み可能なマッピングが残っていると失敗する */
+    munmap(p, size);
+
+    if (fcntl(fd, F_ADD_SEALS, REQUIRED_SEALS) != 0) {
+        perror("F_ADD_SEALS");
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+typedef struct {
+    int sock;
+    int fd;
+    size_t size;
+    int last_ack;
+} handoff_op_arg_t;
+
+static void op_handoff(void *arg)
+{
+    handoff_op_arg_t *a = (handoff_op_arg_t *)arg;
+    memfd_cmd_t cmd = { MFD_CMD_HANDOFF, a->size };
+    unsigned char ack = 0;
+    if (send_fd(a->sock, &cmd, a->fd) != 0)
+        return;
+    if (sock_recv_all(a->sock, &ack, 1) == 0)
+        a->last_ack = ack;
+}
+
+static void bench_handoff(int sock, int fd, size_t size)
+{
+    handoff_op_arg_t op = { sock, fd, size, 0 };
+
+    op_handoff(&op);
+    if (op.last_ack != ACK_OK) {
+        fprintf(stderr, "  *** インポータが memfd を拒否 ***\n");
+        return;
+    }
+
+    int reps = calibrate_inner_reps(op_handoff, &op);
+    printf("  内側ループ: %d 回/サンプル\n", reps);
+
+    for (int w = 0; w < g_cfg.warmup; w++)
+        time_op(op_handoff, &op, reps);
+
+    sample_set_t ss;
+    samples_init(&ss);
+    for (int r = 0; !samples_done(&ss); r++) {
+        double t = time_op(op_handoff, &op, reps);
+        samples_add(&ss, t);
+        if (r < REPEAT_COUNT)
+            print_result("MEMFD-hand", size, t, r + 1);
+    }
+    print_summary("MEMFD-hand", size, ss.v, ss.n);
+    samples_free(&ss);
+    printf("\n");
+}
+
+int main(int argc, char *argv[])
+{
+    size_t max_size = TEST_SIZES[NUM_TEST_SIZES - 1];
+    if (argc > 1) {
+        max_size = (size_t)atol(argv[1]) * 1024UL * 1024;
+    }
+
+    char sizebuf[64], timerbuf[128];
+    printf("=== 封印 memfd (SCM_RIGHTS) ベンチマーク ===\n");
+    printf("最大テストサイズ: %s\n", format_size(max_size, sizebuf, sizeof(sizebuf)));
+
+    bench_config_load();
+    timer_calibrate();
+    printf("タイマー: %s\n", timer_describe(timerbuf, sizeof(timerbuf)));
+    print_config();
+    printf("\n");
+
+    int sv[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, sv) != 0) {
+        perror("socketpair");
+        return 1;
+    }
+
+    fflush(stdout);  /* 未出力のバッファを子プロセスに複製しない */
+    pid_t pid = fork();
+    if (pid == 0) {
+        close(sv[0]);
+        _exit(run_importer(sv[1], max_size));
+    }
+    close(sv[1]);
+    int sock = sv[0];
+
+    pin_from_env(ENV_EXPORTER_CPU);
+
+    int rc = 0;
+    for (size_t si = 0; si < NUM_TEST_SIZES && rc == 0; si++) {
+        size_t size = TEST_SIZES[si];
+        if (size > max_size) break;
+
+        int fd = make_sealed_memfd(size);
+        if (fd < 0) {
+            rc = 1;
+            break;
+        }
+
+        printf("--- memfd %s ---\n", format_size(size, sizebuf, sizeof(sizebuf)));
+        printf("  [MEMFD-hand] fd 送信 → 受信・封印確認・mmap・munmap → 応答\n");
+        bench_handoff(sock, fd, size);
+        fflush(stdout);
+
+        /* 残りの計測は子プロセスが行って出力する */
+        memfd_cmd_t cmd = { MFD_CMD_BENCH, size };
+        unsigned char ack = 0;
+        if (send_fd(sock, &cmd, fd) != 0 || sock_recv_all(sock, &ack, 1) != 0 ||
+            ack != ACK_OK)
+            rc = 1;
+        close(fd);
+    }
+
+    memfd_cmd_t quit = { MFD_CMD_EXIT, 0 };
+    send_fd(sock, &quit, -1);
+
+    int status = 1;
+    waitpid(pid, &status, 0);
+    close(sock);
+
+    printf("ベンチマーク完了\n");
+    if (rc != 0)
+        return rc;
+    return WIFEXITED(status) ? WEXITSTATUS(status) : 1;
+}
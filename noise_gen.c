@@ -0,0 +1,233 @@
+/*
+ * noise_gen.c - 背景メモリトラフィック発生器 (ノイジーネイバー)
+ *
+ * 転送経路は、メモリ帯域を使う他のジョブとソケットを共有することが多く、
+ * 空いたマシンでの数値は楽観的になる。このプロセスは指定した CPU / NUMA
+ * ノードでスレッドを動かし、目標の帯域でメモリを読み書きし続ける:
+ *   read   ストリーミング読み出し
+ *   write  ストリーミング書き込み
+ *   rand   キャッシュライン単位のランダム読み出し
+ * 各スレッドは固定先の CPU で自分のバッファに最初に触れる (first touch) ため、
+ * バッファはそのノードのメモリに載る。
+ *
+ * 準備ができると "NOISE READY" を出力し、SIGTERM / SIGINT を受けるか
+ * BENCH_NOISE_SECONDS が過ぎるまで動き続け、最後に達成した帯域を表示する。
+ * 単体で裏で動かして任意のベンチマークと並べるか、統合ドライバの
+ * -n で負荷ごとに自動で起動する。
+ *
+ * 使い方:
+ *   BENCH_NOISE_MODE=write BENCH_NOISE_THREADS=4 BENCH_NOISE_MBPS=2000 ./noise_gen &
+ *   (設定は common.h の DEFAULT_NOISE_* を参照)
+ *
+ * コンパイル:
+ *   gcc -O2 -o noise_gen noise_gen.c -lrt -lpthread -lm
+ */
+
+#include "common.h"
+#include "topology.h"
+#include <pthread.h>
+#include <stdatomic.h>
+
+#define NOISE_MAX_THREADS 256
+#define NOISE_CHUNK       (1024 * 1024)  /* 帯域を調整する単位 (bytes) */
+#define NOISE_LINE        64
+
+enum { NOISE_READ = 0, NOISE_WRITE, NOISE_RAND };
+static const char *const NOISE_MODES[] = { "read", "write", "rand" };
+
+typedef struct {
+    int mode;
+    int cpu;                /* -1: 固定しない */
+    size_t size;
+    double bytes_per_sec;   /* 0: 無制限 */
+    uint64_t *buf;
+    _Atomic uint64_t bytes; /* 読み書きしたバイト数 */
+    double elapsed;
+    uint64_t sink;
+    int ready;
+    pthread_t tid;
+} noise_thread_t;
+
+static volatile sig_atomic_t g_stop;
+static _Atomic int g_run = 1;
+static _Atomic int g_ready;
+
+static void stop_handler(int sig)
+{
+    (void)sig;
+    g_stop = 1;
+}
+
+/* 1チャンク分のアクセス。バッファ内の位置 *pos を進める (size はチャンクの倍数) */
+static void noise_chunk(noise_thread_t *t, size_t *pos, uint64_t *rng)
+{
+    size_t words = t->size / sizeof(uint64_t);
+    size_t n = NOISE_CHUNK / sizeof(uint64_t);
+    uint64_t *restrict p = t->buf;
+    uint64_t sum = 0;
+
+    switch (t->mode) {
+    case NOISE_READ:
+        for (size_t i = 0; i < n; i++)
+            sum += p[*pos + i];
+        break;
+    case NOISE_WRITE:
+        for (size_t i = 0; i < n; i++)
+            p[*pos + i] = i;
+        break;
+    case NOISE_RAND: {
+        size_t lines = t->size / NOISE_LINE;
+        for (size_t i = 0; i < NOISE_CHUNK / NOISE_LINE; i++) {
+            *rng ^= *rng << 13;
+            *rng ^= *rng >> 7;
+            *rng ^= *rng << 17;
+            sum += p[(*rng % lines) * (NOISE_LINE / sizeof(uint64_t))];
+        }
+        break;
+    }
+    }
+    *pos = (*pos + n) % words;
+    t->sink += sum;
+}
+
+static void *noise_main(void *arg)
+{
+    noise_thread_t *t = (noise_thread_t *)arg;
+    if (t->cpu >= 0)
+        pin_cpu(t->cpu);
+
+    /* 固定した CPU で最初に触れて、そのノードにページを置く */
+    t->buf = mmap(NULL, t->size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (t->buf == MAP_FAILED) {
+        perror("mmap");
+        t->buf = NULL;
+        atomic_fetch_add(&g_ready, 1);
+        return NULL;
+    }
+    fill_pattern(t->buf, t->size);
+    t->ready = 1;
+    atomic_fetch_add(&g_ready, 1);
+
+    size_t pos = 0;
+    uint64_t rng = 0x9e3779b97f4a7c15ULL ^ (uint64_t)(uintptr_t)t;
+    double start = get_time_sec();
+    uint64_t done = 0;
+    while (atomic_load_explicit(&g_run, memory_order_relaxed)) {
+        noise_chunk(t, &pos, &rng);
+        done += NOISE_CHUNK;
+        atomic_store_explicit(&t->bytes, done, memory_order_relaxed);
+
+        /* 目標帯域より先行していればその分だけ眠る */
+        if (t->bytes_per_sec > 0) {
+            double ahead = (double)done / t->bytes_per_sec - (get_time_sec() - start);
+            if (ahead > 0) {
+                struct timespec ts = { (time_t)ahead, (long)((ahead - (time_t)ahead) * 1e9) };
+                nanosleep(&ts, NULL);
+            }
+        }
+    }
+    t->elapsed = get_time_sec() - start;
+    return NULL;
+}
+
+static int parse_mode(const char *s)
+{
+    for (int m = 0; m < (int)(sizeof(NOISE_MODES) / sizeof(NOISE_MODES[0])); m++)
+        if (strcmp(s, NOISE_MODES[m]) == 0)
+            return m;
+    return -1;
+}
+
+int main(void)
+{
+    const char *mode_name = getenv("BENCH_NOISE_MODE");
+    if (!mode_name || !*mode_name)
+        mode_name = DEFAULT_NOISE_MODE;
+    int mode = parse_mode(mode_name);
+    if (mode < 0) {
+        fprintf(stderr, "不明な BENCH_NOISE_MODE: %s (read / write / rand)\n", mode_name);
+        return 1;
+    }
+
+    long nthreads = env_long("BENCH_NOISE_THREADS", DEFAULT_NOISE_THREADS);
+    long mbps = env_long("BENCH_NOISE_MBPS", 0);
+    size_t size = (size_t)env_long("BENCH_NOISE_MB", DEFAULT_NOISE_MB) * 1024UL * 1024;
+    double seconds = env_double("BENCH_NOISE_SECONDS", 0);
+    if (nthreads < 1)
+        nthreads = 1;
+    if (nthreads > NOISE_MAX_THREADS)
+        nthreads = NOISE_MAX_THREADS;
+    size -= size % NOISE_CHUNK;
+    if (size < NOISE_CHUNK)
+        size = NOISE_CHUNK;
+
+    long cpus[NOISE_MAX_THREADS];
+    int ncpus = env_long_list("BENCH_NOISE_CPUS", "", cpus, NOISE_MAX_THREADS);
+    long node = env_long("BENCH_NOISE_NODE", -1);
+    if (ncpus == 0 && node >= 0) {
+        ncpus = topo_node_cpus(node, cpus, NOISE_MAX_THREADS);
+        if (ncpus == 0)
+            fprintf(stderr, "警告: NUMA ノード %ld の CPU を読めません (固定しない)\n", node);
+    }
+
+    char sizebuf[64];
+    printf("=== 背景メモリトラフィック ===\n");
+    printf("モード: %s, %ld スレッド, バッファ %s/スレッド, 目標 ",
+           NOISE_MODES[mode], nthreads, format_size(size, sizebuf, sizeof(sizebuf)));
+    if (mbps > 0)
+        printf("%ld MB/s/スレッド", mbps);
+    else
+        printf("無制限");
+    if (ncpus > 0)
+        printf(", CPU %ld 〜 (%d 個を順に使用)", cpus[0], ncpus);
+    printf("\n");
+
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = stop_handler;
+    sigaction(SIGTERM, &sa, NULL);
+    sigaction(SIGINT, &sa, NULL);
+
+    static noise_thread_t th[NOISE_MAX_THREADS];
+    for (long t = 0; t < nthreads; t++) {
+        th[t].mode = mode;
+        th[t].cpu = ncpus > 0 ? (int)cpus[t % ncpus] : -1;
+        th[t].size = size;
+        th[t].bytes_per_sec = mbps > 0 ? (double)mbps * 1024 * 1024 : 0;
+        if (pthread_create(&th[t].tid, NULL, noise_main, &th[t]) != 0) {
+            perror("pthread_create");
+            return 1;
+        }
+    }
+    while (atomic_load(&g_ready) < nthreads && !g_stop)
+        usleep(1000);
+
+    int failed = 0;
+    for (long t = 0; t < nthreads; t++)
+        failed |= !th[t].ready;
+    if (!failed) {
+        printf("NOISE READY\n");
+        fflush(stdout);
+    }
+
+    double start = get_time_sec();
+    while (!failed && !g_stop && (seconds <= 0 || get_time_sec() - start < seconds))
+        usleep(10000);
+
+    atomic_store(&g_run, 0);
+    double total = 0;
+    uint64_t sink = 0;
+    for (long t = 0; t < nthreads; t++) {
+        pthread_join(th[t].tid, NULL);
+        double gbps = th[t].elapsed > 0
+            ? (double)atomic_load(&th[t].bytes) / th[t].elapsed / (1024.0 * 1024 * 1024) : 0;
+        printf("  スレッド %ld (CPU %d): %.2f GB/s\n", t, th[t].cpu, gbps);
+        total += gbps;
+        sink += th[t].sink;
+        if (th[t].buf)
+            munmap(th[t].buf, size);
+    }
+    __asm__ volatile("" :: "g"(sink));
+    printf("背景トラフィック合計: %.2f GB/s (%.1f 秒)\n", total, get_time_sec() - start);
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,215 @@
+/*
+ * perf_counters.h - perf_event_open によるハードウェアカウンタ計測
+ *
+ * cycles / instructions / LLC ミス / dTLB ロードミス / ページフォルト /
+ * コンテキストスイッチをひとつのカウンタグループとして計測区間の前後で
+ * 有効化・無効化する。VM や perf_event_paranoid の制限で PMU が
+ * 使えない環境ではソフトウェアイベント (ページフォルト, コンテキスト
+ * スイッチ) のみのグループにフォールバックする。
+ */
+
+#ifndef PERF_COUNTERS_H
+#define PERF_COUNTERS_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+/* 計測するイベント (表示順) */
+enum {
+    PC_CYCLES = 0,
+    PC_INSTRUCTIONS,
+    PC_LLC_MISSES,
+    PC_DTLB_MISSES,
+    PC_PAGE_FAULTS,
+    PC_CTX_SWITCHES,
+    PC_NUM_EVENTS
+};
+
+static const char *const PC_EVENT_NAMES[PC_NUM_EVENTS] = {
+    "cycles", "instr", "LLC-miss", "dTLB-miss", "PF", "CS",
+};
+
+/* 1回分 (または累積) のカウンタ値。mask のビットが立っているものが有効 */
+typedef struct {
+    uint32_t mask;
+    uint64_t val[PC_NUM_EVENTS];
+} perf_sample_t;
+
+/* カウンタグループ */
+typedef struct {
+    int leader_fd;
+    int fd[PC_NUM_EVENTS];      /* -1: 未使用 */
+    int slot[PC_NUM_EVENTS];    /* グループ読み出し時の並び順 */
+    int nr;                     /* グループ内のイベント数 */
+    int hw_available;           /* ハードウェアイベントが1つ以上開けたか */
+} perf_group_t;
+
+static inline int perf_event_open_one(uint32_t type, uint64_t config, int group_fd)
+{
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    attr.disabled = (group_fd == -1);   /* リーダーのみ無効状態で作成 */
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_GROUP |
+                       PERF_FORMAT_TOTAL_TIME_ENABLED |
+                       PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+    int fd = (int)syscall(SYS_perf_event_open, &attr, 0, -1, group_fd, 0);
+    if (fd < 0 && (errno == EACCES || errno == EPERM)) {
+        /* perf_event_paranoid >= 2 ではユーザ空間のみなら許可される */
+        attr.exclude_kernel = 1;
+        fd = (int)syscall(SYS_perf_event_open, &attr, 0, -1, group_fd, 0);
+    }
+    return fd;
+}
+
+#define PC_HW_CACHE(id, op, res) \
+    ((uint64_t)(id) | ((uint64_t)(op) << 8) | ((uint64_t)(res) << 16))
+
+static inline void perf_group_add(perf_group_t *g, int ev,
+                                  uint32_t type, uint64_t config)
+{
+    int fd = perf_event_open_one(type, config, g->leader_fd);
+    if (fd < 0)
+        return;
+    if (g->leader_fd == -1)
+        g->leader_fd = fd;
+    g->fd[ev] = fd;
+    g->slot[ev] = g->nr++;
+}
+
+/*
+ * カウンタグループを開く。ハードウェアイベントが1つも開けない場合は
+ * ソフトウェアイベントのみになる。全滅した場合は nr == 0 で、
+ * 以降の start/stop は何もしない。
+ */
+static inline void perf_group_open(perf_group_t *g)
+{
+    memset(g, 0, sizeof(*g));
+    g->leader_fd = -1;
+    for (int i = 0; i < PC_NUM_EVENTS; i++) {
+        g->fd[i] = -1;
+        g->slot[i] = -1;
+    }
+
+    /* リーダーは cycles。開けなければ PMU 無しとみなす */
+    perf_group_add(g, PC_CYCLES, PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES);
+    if (g->leader_fd != -1) {
+        perf_group_add(g, PC_INSTRUCTIONS, PERF_TYPE_HARDWARE,
+                       PERF_COUNT_HW_INSTRUCTIONS);
+        perf_group_add(g, PC_LLC_MISSES, PERF_TYPE_HW_CACHE,
+                       PC_HW_CACHE(PERF_COUNT_HW_CACHE_LL,
+                                   PERF_COUNT_HW_CACHE_OP_READ,
+                                   PERF_COUNT_HW_CACHE_RESULT_MISS));
+        if (g->fd[PC_LLC_MISSES] == -1)
+            perf_group_add(g, PC_LLC_MISSES, PERF_TYPE_HARDWARE,
+                           PERF_COUNT_HW_CACHE_MISSES);
+        perf_group_add(g, PC_DTLB_MISSES, PERF_TYPE_HW_CACHE,
+                       PC_HW_CACHE(PERF_COUNT_HW_CACHE_DTLB,
+                                   PERF_COUNT_HW_CACHE_OP_READ,
+                                   PERF_COUNT_HW_CACHE_RESULT_MISS));
+        g->hw_available = 1;
+    }
+
+    perf_group_add(g, PC_PAGE_FAULTS, PERF_TYPE_SOFTWARE,
+                   PERF_COUNT_SW_PAGE_FAULTS);
+    perf_group_add(g, PC_CTX_SWITCHES, PERF_TYPE_SOFTWARE,
+                   PERF_COUNT_SW_CONTEXT_SWITCHES);
+}
+
+static inline void perf_group_close(perf_group_t *g)
+{
+    for (int i = 0; i < PC_NUM_EVENTS; i++) {
+        if (g->fd[i] != -1)
+            close(g->fd[i]);
+        g->fd[i] = -1;
+    }
+    g->leader_fd = -1;
+    g->nr = 0;
+}
+
+static inline const char *perf_group_mode(const perf_group_t *g)
+{
+    if (g->nr == 0)
+        return "無効 (perf_event_open 失敗)";
+    return g->hw_available ? "ハードウェア + ソフトウェア"
+                           : "ソフトウェアのみ (PMU 利用不可)";
+}
+
+/* 計測区間の直前に呼ぶ */
+static inline void perf_group_start(perf_group_t *g)
+{
+    if (g->nr == 0)
+        return;
+    ioctl(g->leader_fd, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+    ioctl(g->leader_fd, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+}
+
+/* 計測区間の直後に呼び、カウンタ値を out に格納する */
+static inline void perf_group_stop(perf_group_t *g, perf_sample_t *out)
+{
+    memset(out, 0, sizeof(*out));
+    if (g->nr == 0)
+        return;
+    ioctl(g->leader_fd, PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+
+    /* PERF_FORMAT_GROUP: nr, time_enabled, time_running, values[nr] */
+    uint64_t buf[3 + PC_NUM_EVENTS];
+    ssize_t n = read(g->leader_fd, buf, sizeof(buf));
+    if (n < (ssize_t)(3 * sizeof(uint64_t)))
+        return;
+
+    uint64_t nr = buf[0], enabled = buf[1], running = buf[2];
+    for (int i = 0; i < PC_NUM_EVENTS; i++) {
+        if (g->slot[i] < 0 || (uint64_t)g->slot[i] >= nr)
+            continue;
+        uint64_t v = buf[3 + g->slot[i]];
+        /* 多重化された場合は有効時間で補正 */
+        if (running > 0 && running < enabled)
+            v = (uint64_t)((double)v * (double)enabled / (double)running);
+        out->val[i] = v;
+        out->mask |= 1u << i;
+    }
+}
+
+static inline void perf_sample_add(perf_sample_t *acc, const perf_sample_t *s)
+{
+    acc->mask |= s->mask;
+    for (int i = 0; i < PC_NUM_EVENTS; i++)
+        acc->val[i] += s->val[i];
+}
+
+/*
+ * 累積カウンタ値を 1イテレーションあたり / 1バイトあたりで表示する。
+ * print_summary() の直後に呼ぶ想定。
+ */
+static inline void print_perf_summary(const char *method, size_t size,
+                                      const perf_sample_t *acc, int iters)
+{
+    if (acc->mask == 0 || iters <= 0)
+        return;
+
+    double bytes = (double)size * iters;
+    printf("  [%s] perf       |", method);
+    for (int i = 0; i < PC_NUM_EVENTS; i++) {
+        if (!(acc->mask & (1u << i)))
+            continue;
+        printf(" %s %.4g/it %.3g/B |", PC_EVENT_NAMES[i],
+               (double)acc->val[i] / iters, (double)acc->val[i] / bytes);
+    }
+    if ((acc->mask & (1u << PC_CYCLES)) && (acc->mask & (1u << PC_INSTRUCTIONS))
+        && acc->val[PC_CYCLES] > 0)
+        printf(" IPC %.2f", (double)acc->val[PC_INSTRUCTIONS] / acc->val[PC_CYCLES]);
+    printf("\n");
+}
+
+#endif /* PERF_COUNTERS_H */
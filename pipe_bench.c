@@ -0,0 +1,320 @@
+/*
+ * pipe_bench.c - パイプ (write/read, vmsplice/splice) ベンチマーク
+ *
+ * xpmem や POSIX共有メモリとの比較のため、パイプでバッファを
+ * 別プロセスへ渡す速度を計測する。
+ *
+ * 親プロセス (エクスポータ) がパターンを書いたバッファを送り、
+ * fork() した子プロセス (インポータ) が受け取って1バイトの応答を返す
+ * までを1操作として親が計測する:
+ *   PIPE-rw    write() → read()              (送受信で2回コピー)
+ *   PIPE-vms   vmsplice(SPLICE_F_GIFT) → read()  (送信側のコピーなし)
+ *   PIPE-spl   vmsplice(SPLICE_F_GIFT) → splice() で子がマップした
+ *              memfd へ移す (ユーザ空間の read バッファを経由しない)
+ * パイプ容量は F_SETPIPE_SZ で切り替えてスイープする。
+ *
+ * 使い方:
+ *   ./pipe_bench [最大テストサイズ(MB)]
+ *   BENCH_PIPE_SIZES=64,256,1024 でパイプ容量 (KB) を指定
+ *   (既定 64,1024。/proc/sys/fs/pipe-max-size を超える値は上限に丸める)
+ *
+ * コンパイル:
+ *   gcc -O2 -o pipe_bench pipe_bench.c -lrt -lm
+ */
+
+#include "common.h"
+#include <sys/uio.h>
+#include <sys/wait.h>
+
+#define DEFAULT_PIPE_SIZES "64,1024"
+#define MAX_PIPE_SIZES     16
+
+/* 一般ユーザが F_SETPIPE_SZ で設定できる上限 (bytes)。読めなければ -1 */
+static long pipe_max_size(void)
+{
+    FILE *fp = fopen("/proc/sys/fs/pipe-max-size", "r");
+    if (!fp)
+        return -1;
+    long v;
+    if (fscanf(fp, "%ld", &v) != 1)
+        v = -1;
+    fclose(fp);
+    return v;
+}
+
+/* 受信方式 */
+enum {
+    PIPE_RECV_READ = 0,     /* read() でローカルバッファへ */
+    PIPE_RECV_SPLICE,       /* splice() で memfd へ */
+    PIPE_RECV_EXIT,
+};
+
+/* 送信方式 */
+enum {
+    PIPE_SEND_WRITE = 0,
+    PIPE_SEND_VMSPLICE,
+};
+
+/* 親 → 子: 1メッセージごとの指示 */
+typedef struct {
+    int recv_mode;          /* PIPE_RECV_* */
+    int verify;             /* 受信後にパターンを検証するか */
+    size_t size;
+} pipe_cmd_t;
+
+/* 子 → 親: 応答バイト */
+#define ACK_OK   1
+#define ACK_BAD  2
+
+typedef struct {
+    int cmd_fd;             /* 指示用パイプ (書き込み端) */
+    int data_fd;            /* データ用パイプ (書き込み端) */
+    int ack_fd;             /* 応答用パイプ (読み出し端) */
+    const char *src;
+    size_t size;
+    int send_mode;          /* PIPE_SEND_* */
+    int recv_mode;
+    int verify;
+    int last_ack;
+} pipe_op_arg_t;
+
+/* ページを参照としてパイプに渡す。容量を超える分は子の読み出しを待って続ける */
+static int vmsplice_all(int fd, const void *buf, size_t len)
+{
+    struct iovec iov = { (void *)buf, len };
+    while (iov.iov_len > 0) {
+        ssize_t n = vmsplice(fd, &iov, 1, SPLICE_F_GIFT);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        iov.iov_base = (char *)iov.iov_base + n;
+        iov.iov_len -= (size_t)n;
+    }
+    return 0;
+}
+
+/* 1操作: 指示 → データ送信 → 応答待ち */
+static void op_pipe_send(void *arg)
+{
+    pipe_op_arg_t *a = (pipe_op_arg_t *)arg;
+    pipe_cmd_t cmd = { a->recv_mode, a->verify, a->size };
+    unsigned char ack = 0;
+
+    if (sock_send_all(a->cmd_fd, &cmd, sizeof(cmd)) != 0)
+        return;
+    if (a->send_mode == PIPE_SEND_VMSPLICE)
+        vmsplice_all(a->data_fd, a->src, a->size);
+    else
+        sock_send_all(a->data_fd, a->src, a->size);
+    if (sock_recv_all(a->ack_fd, &ack, 1) == 0)
+        a->last_ack = ack;
+    a->verify = 0;
+}
+
+/* ========== 子プロセス (受信側) ========== */
+
+static int splice_all(int pipe_fd, int out_fd, size_t len)
+{
+    loff_t off = 0;
+    while (len > 0) {
+        ssize_t n = splice(pipe_fd, NULL, out_fd, &off, len, SPLICE_F_MOVE);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        if (n == 0)
+            return -1;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+static int run_receiver(int cmd_fd, int data_fd, int ack_fd, size_t max_size)
+{
+    pin_from_env(ENV_IMPORTER_CPU);
+
+    void *local_buf = alloc_aligned(max_size);
+    if (!local_buf)
+        return 1;
+    memset(local_buf, 0, max_size);
+
+    /* splice の受け先: 子がマップしている memfd */
+    int mfd = memfd_create("pipe_bench_dst", 0);
+    void *spl_buf = MAP_FAILED;
+    if (mfd >= 0 && ftruncate(mfd, max_size) == 0)
+        spl_buf = mmap(NULL, max_size, PROT_READ, MAP_SHARED, mfd, 0);
+    if (spl_buf == MAP_FAILED) {
+        perror("memfd");
+        free(local_buf);
+        return 1;
+    }
+
+    pipe_cmd_t cmd;
+    while (sock_recv_all(cmd_fd, &cmd, sizeof(cmd)) == 0 && cmd.recv_mode != PIPE_RECV_EXIT) {
+        int rc;
+        const void *dst;
+        if (cmd.recv_mode == PIPE_RECV_SPLICE) {
+            rc = splice_all(data_fd, mfd, cmd.size);
+            dst = spl_buf;
+        } else {
+            rc = sock_recv_all(data_fd, local_buf, cmd.size);
+            dst = local_buf;
+        }
+
+        unsigned char ack = ACK_OK;
+        if (rc != 0 || (cmd.verify && verify_pattern(dst, cmd.size)))
+            ack = ACK_BAD;
+        if (sock_send_all(ack_fd, &ack, 1) != 0)
+            break;
+    }
+
+    munmap(spl_buf, max_size);
+    close(mfd);
+    free(local_buf);
+    return 0;
+}
+
+/* ========== 親プロセス (送信側) ========== */
+
+/* 1方式・全サイズのベンチマーク */
+static void bench_pipe_variant(const char *method, pipe_op_arg_t *arg, size_t max_size)
+{
+    for (size_t si = 0; si < NUM_TEST_SIZES; si++) {
+        size_t size = TEST_SIZES[si];
+        if (size > max_size) break;
+
+        arg->size = size;
+        arg->verify = 1;
+        op_pipe_send(arg);
+        if (arg->last_ack == ACK_OK)
+            printf("  ✓ データ検証OK\n");
+        else
+            fprintf(stderr, "  *** データ不整合! (%s, %zu bytes) ***\n", method, size);
+
+        int reps = calibrate_inner_reps(op_pipe_send, arg);
+        printf("  内側ループ: %d 回/サンプル\n", reps);
+
+        for (int w = 0; w < g_cfg.warmup; w++)
+            time_op(op_pipe_send, arg, reps);
+
+        sample_set_t ss;
+        samples_init(&ss);
+        for (int r = 0; !samples_done(&ss); r++) {
+            double t = time_op(op_pipe_send, arg, reps);
+            samples_add(&ss, t);
+            if (r < REPEAT_COUNT)
+                print_result(method, size, t, r + 1);
+        }
+        print_summary(method, size, ss.v, ss.n);
+        samples_free(&ss);
+        printf("\n");
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    size_t max_size = TEST_SIZES[NUM_TEST_SIZES - 1];
+    if (argc > 1) {
+        max_size = (size_t)atol(argv[1]) * 1024UL * 1024;
+    }
+
+    long pipe_kb[MAX_PIPE_SIZES];
+    int num_pipe_sizes = env_long_list("BENCH_PIPE_SIZES", DEFAULT_PIPE_SIZES,
+                                       pipe_kb, MAX_PIPE_SIZES);
+
+    char sizebuf[64], timerbuf[128];
+    printf("=== パイプ (write/read, vmsplice/splice) ベンチマーク ===\n");
+    printf("最大テストサイズ: %s\n", format_size(max_size, sizebuf, sizeof(sizebuf)));
+
+    bench_config_load();
+    timer_calibrate();
+    printf("タイマー: %s\n", timer_describe(timerbuf, sizeof(timerbuf)));
+    print_config();
+    printf("\n");
+
+    int cmd_p[2], data_p[2], ack_p[2];
+    if (pipe(cmd_p) != 0 || pipe(data_p) != 0 || pipe(ack_p) != 0) {
+        perror("pipe");
+        return 1;
+    }
+
+    fflush(stdout);  /* 未出力のバッファを子プロセスに複製しない */
+    pid_t pid = fork();
+    if (pid == 0) {
+        close(cmd_p[1]);
+        close(data_p[1]);
+        close(ack_p[0]);
+        _exit(run_receiver(cmd_p[0], data_p[0], ack_p[1], max_size));
+    }
+    close(cmd_p[0]);
+    close(data_p[0]);
+    close(ack_p[1]);
+
+    pin_from_env(ENV_EXPORTER_CPU);
+
+    /* vmsplice(SPLICE_F_GIFT) はページ境界に揃ったバッファが前提 */
+    void *src = alloc_aligned(max_size);
+    if (!src) {
+        kill(pid, SIGKILL);
+        return 1;
+    }
+    fill_pattern(src, max_size);
+
+    pipe_op_arg_t arg = { cmd_p[1], data_p[1], ack_p[0], src, 0, 0, 0, 0, 0 };
+
+    static const struct {
+        const char *name;
+        int send_mode;
+        int recv_mode;
+        const char *desc;
+    } variants[] = {
+        { "PIPE-rw",  PIPE_SEND_WRITE,    PIPE_RECV_READ,   "write() → read()" },
+        { "PIPE-vms", PIPE_SEND_VMSPLICE, PIPE_RECV_READ,   "vmsplice(SPLICE_F_GIFT) → read()" },
+        { "PIPE-spl", PIPE_SEND_VMSPLICE, PIPE_RECV_SPLICE, "vmsplice(SPLICE_F_GIFT) → splice() → memfd" },
+    };
+
+    long pipe_max = pipe_max_size();
+    for (int p = 0; p < num_pipe_sizes; p++) {
+        if (pipe_kb[p] <= 0)
+            continue;
+        long want = pipe_kb[p] * 1024;
+        if (pipe_max > 0 && want > pipe_max) {
+            printf("パイプ容量 %ld KB は pipe-max-size (%ld KB) に丸めます\n", pipe_kb[p],
+                   pipe_max / 1024);
+            want = pipe_max;
+        }
+        int actual = fcntl(data_p[1], F_SETPIPE_SZ, (int)want);
+        if (actual < 0) {
+            fprintf(stderr, "F_SETPIPE_SZ(%ld KB): %s\n", want / 1024, strerror(errno));
+            actual = fcntl(data_p[1], F_GETPIPE_SZ);
+        }
+        format_size((size_t)actual, sizebuf, sizeof(sizebuf));
+
+        for (size_t v = 0; v < sizeof(variants) / sizeof(variants[0]); v++) {
+            char method[64];
+            snprintf(method, sizeof(method), "%s-p%zuK", variants[v].name,
+                     (size_t)actual / 1024);
+            printf("--- パイプ ベンチマーク: %s (パイプ容量 %s) ---\n",
+                   variants[v].desc, sizebuf);
+            printf("  (送信から子プロセスの受信完了応答まで)\n\n");
+
+            arg.send_mode = variants[v].send_mode;
+            arg.recv_mode = variants[v].recv_mode;
+            bench_pipe_variant(method, &arg, max_size);
+        }
+    }
+
+    pipe_cmd_t quit = { PIPE_RECV_EXIT, 0, 0 };
+    sock_send_all(cmd_p[1], &quit, sizeof(quit));
+    close(cmd_p[1]);
+    close(data_p[1]);
+
+    int status = 1;
+    waitpid(pid, &status, 0);
+    close(ack_p[0]);
+    free(src);
+
+    printf("ベンチマーク完了\n");
+    return WIFEXITED(status) ? WEXITSTATUS(status) : 1;
+}
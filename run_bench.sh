@@ -5,8 +5,17 @@
 # このスクリプトは:
 # 1. xpmemカーネルモジュールの確認
 # 2. xpmemベンチマークの実行 (exporter + importer)
-# 3. POSIX共有メモリベンチマークの実行
+# 3. POSIX共有メモリ・ファイル・パイプ・memfd・コア間レイテンシ・STREAM の実行
 # 4. 結果の保存
+# 5. ベースラインがあれば比較 (性能劣化があれば終了コード 1)
+#
+# 使い方:
+#   ./run_bench.sh                              # ベンチマーク実行
+#   ./run_bench.sh baseline [ログ]              # ログ (省略時は最新) をベースラインに登録
+#   ./run_bench.sh compare <基準ログ> <新ログ>   # 2つの結果を比較
+#
+# 環境変数:
+#   REGRESSION_THRESHOLD  劣化とみなす時間増加率 [%] (既定 5)
 #
 
 set -e
@@ -15,6 +24,8 @@ SCRIPT_DIR="$(cd "$(dirname "$0")" && pwd)"
 LOG_DIR="$SCRIPT_DIR/results"
 TIMESTAMP=$(date +%Y%m%d_%H%M%S)
 LOG_FILE="$LOG_DIR/bench_${TIMESTAMP}.log"
+BASELINE_FILE="$LOG_DIR/baseline.log"
+REGRESSION_THRESHOLD="${REGRESSION_THRESHOLD:-5}"
 
 # ========== ユーティリティ ==========
 
@@ -43,6 +54,31 @@ check_prerequisites() {
         cd "$SCRIPT_DIR" && make shm 2>&1 | tee -a "$LOG_FILE"
     fi
 
+    if [ ! -f "$SCRIPT_DIR/file_bench" ]; then
+        log "ファイルベンチマークのバイナリが見つかりません。ビルドを試みます..."
+        cd "$SCRIPT_DIR" && make file 2>&1 | tee -a "$LOG_FILE"
+    fi
+
+    if [ ! -f "$SCRIPT_DIR/pipe_bench" ]; then
+        log "パイプベンチマークのバイナリが見つかりません。ビルドを試みます..."
+        cd "$SCRIPT_DIR" && make pipe 2>&1 | tee -a "$LOG_FILE"
+    fi
+
+    if [ ! -f "$SCRIPT_DIR/memfd_bench" ]; then
+        log "memfdベンチマークのバイナリが見つかりません。ビルドを試みます..."
+        cd "$SCRIPT_DIR" && make memfd 2>&1 | tee -a "$LOG_FILE"
+    fi
+
+    if [ ! -f "$SCRIPT_DIR/c2c_bench" ]; then
+        log "コア間レイテンシのバイナリが見つかりません。ビルドを試みます..."
+        cd "$SCRIPT_DIR" && make c2c 2>&1 | tee -a "$LOG_FILE"
+    fi
+
+    if [ ! -f "$SCRIPT_DIR/stream_bench" ]; then
+        log "STREAMベンチマークのバイナリが見つかりません。ビルドを試みます..."
+        cd "$SCRIPT_DIR" && make stream 2>&1 | tee -a "$LOG_FILE"
+    fi
+
     # xpmemモジュール確認
     if [ ! -e /dev/xpmem ]; then
         log "WARNING: /dev/xpmem が見つかりません"
@@ -95,31 +131,20 @@ run_xpmem_bench() {
 
     log "=== xpmem ベンチマーク開始 ==="
 
-    # クリーンアップ
-    rm -f /tmp/xpmem_segid /tmp/xpmem_ready /tmp/xpmem_done
-
     # エクスポータをバックグラウンドで起動
     log "エクスポータ起動中..."
     "$SCRIPT_DIR/xpmem_exporter" 2>&1 | tee -a "$LOG_FILE" &
     EXPORTER_PID=$!
 
-    # エクスポータの準備完了を待つ
-    local wait_count=0
-    while [ ! -f /tmp/xpmem_ready ] && [ $wait_count -lt 30 ]; do
-        sleep 1
-        wait_count=$((wait_count + 1))
-    done
-
-    if [ ! -f /tmp/xpmem_ready ]; then
-        log "ERROR: エクスポータがタイムアウトしました"
+    # インポータ実行 (エクスポータがレジストリに登録するのを最大 60 秒待つ)
+    log "インポータ (ベンチマーク) 開始..."
+    BENCH_SEG_TIMEOUT=${BENCH_SEG_TIMEOUT:-60} "$SCRIPT_DIR/xpmem_importer" 2>&1 | tee -a "$LOG_FILE"
+    if [ "${PIPESTATUS[0]}" -ne 0 ]; then
+        log "ERROR: インポータが失敗しました (エクスポータのタイムアウト?)"
         kill $EXPORTER_PID 2>/dev/null
         return 1
     fi
 
-    # インポータ実行
-    log "インポータ (ベンチマーク) 開始..."
-    "$SCRIPT_DIR/xpmem_importer" 2>&1 | tee -a "$LOG_FILE"
-
     # エクスポータの終了を待つ
     wait $EXPORTER_PID 2>/dev/null || true
 
@@ -138,9 +163,158 @@ run_shm_bench() {
     log ""
 }
 
+# ========== ファイルベンチマーク ==========
+
+run_file_bench() {
+    log "=== ファイル (mmap / read / O_DIRECT) ベンチマーク開始 ==="
+
+    "$SCRIPT_DIR/file_bench" 2>&1 | tee -a "$LOG_FILE"
+
+    log "=== ファイル ベンチマーク完了 ==="
+    log ""
+}
+
+# ========== パイプベンチマーク ==========
+
+run_pipe_bench() {
+    log "=== パイプ (write/read, vmsplice/splice) ベンチマーク開始 ==="
+
+    "$SCRIPT_DIR/pipe_bench" 2>&1 | tee -a "$LOG_FILE"
+
+    log "=== パイプ ベンチマーク完了 ==="
+    log ""
+}
+
+# ========== memfd ベンチマーク ==========
+
+run_memfd_bench() {
+    log "=== 封印 memfd (SCM_RIGHTS) ベンチマーク開始 ==="
+
+    "$SCRIPT_DIR/memfd_bench" 2>&1 | tee -a "$LOG_FILE"
+
+    log "=== 封印 memfd ベンチマーク完了 ==="
+    log ""
+}
+
+# ========== コア間レイテンシ ==========
+
+run_c2c_bench() {
+    log "=== コア間キャッシュライン受け渡しレイテンシ開始 ==="
+
+    "$SCRIPT_DIR/c2c_bench" 2>&1 | tee -a "$LOG_FILE"
+
+    log "=== コア間レイテンシ完了 ==="
+    log ""
+}
+
+# ========== STREAM (ルーフライン) ==========
+
+run_stream_bench() {
+    log "=== STREAM 方式 メモリ帯域ベンチマーク開始 ==="
+
+    "$SCRIPT_DIR/stream_bench" 2>&1 | tee -a "$LOG_FILE"
+
+    log "=== STREAM ベンチマーク完了 ==="
+    log ""
+}
+
+# ========== ベースライン比較 ==========
+
+#
+# 各ベンチマークが出力する RESULT 行を backend, size, threads, placement で
+# 突き合わせる。平均の差が両者の95%信頼区間の半幅を合成した値
+# (sqrt(ci_a^2 + ci_b^2)) を超えたものを有意とみなし、時間が
+# REGRESSION_THRESHOLD % 以上増えていれば劣化として終了コード 1 を返す。
+#
+compare_results() {
+    local base="$1" new="$2"
+    [ -f "$base" ] || die "ベースラインが見つかりません: $base"
+    [ -f "$new" ]  || die "結果ファイルが見つかりません: $new"
+
+    echo "=== ベースライン比較 (劣化しきい値: ${REGRESSION_THRESHOLD}%) ==="
+    echo "  基準: $base"
+    echo "  新規: $new"
+    echo ""
+
+    awk -v thr="$REGRESSION_THRESHOLD" '
+        function field(name,   i, kv) {
+            for (i = 2; i <= NF; i++) {
+                split($i, kv, "=")
+                if (kv[1] == name) return kv[2]
+            }
+            return ""
+        }
+        /^RESULT / {
+            key = field("backend") SUBSEP field("size") SUBSEP field("threads") SUBSEP field("placement")
+            if (FILENAME == ARGV[1]) {
+                bmean[key] = field("mean_us"); bci[key] = field("ci95_us")
+            } else {
+                if (!(key in nmean)) order[++nkeys] = key
+                nmean[key] = field("mean_us"); nci[key] = field("ci95_us")
+            }
+        }
+        END {
+            printf "  %-12s %12s %4s %-12s %14s %14s %9s  %s\n",
+                   "backend", "size", "thr", "placement", "base_us", "new_us", "delta", "判定"
+            reg = 0; imp = 0; unmatched = 0
+            for (k = 1; k <= nkeys; k++) {
+                key = order[k]
+                split(key, p, SUBSEP)
+                if (!(key in bmean)) { unmatched++; continue }
+                b = bmean[key] + 0; n = nmean[key] + 0
+                if (b <= 0) continue
+                delta = (n - b) / b * 100
+                ci = sqrt(bci[key] * bci[key] + nci[key] * nci[key])
+                sig = (n - b > ci || b - n > ci)
+                status = "-"
+                if (sig && delta >= thr)       { status = "REGRESSION"; reg++ }
+                else if (sig && delta > 0)     { status = "slower" }
+                else if (sig && -delta >= thr) { status = "IMPROVED"; imp++ }
+                else if (sig)                  { status = "faster" }
+                printf "  %-12s %12s %4s %-12s %14.4f %14.4f %+8.2f%%  %s\n",
+                       p[1], p[2], p[3], p[4], b, n, delta, status
+            }
+            for (key in bmean)
+                if (!(key in nmean)) unmatched++
+            printf "\n  劣化: %d  改善: %d  対応なし: %d\n", reg, imp, unmatched
+            exit (reg > 0)
+        }
+    ' "$base" "$new"
+}
+
+# 最新の結果ログを返す
+latest_log() {
+    ls -1t "$LOG_DIR"/bench_*.log 2>/dev/null | head -1
+}
+
+save_baseline() {
+    local src="${1:-$(latest_log)}"
+    [ -n "$src" ] && [ -f "$src" ] || die "ベースラインにする結果ログがありません"
+    mkdir -p "$LOG_DIR"
+    cp "$src" "$BASELINE_FILE"
+    echo "ベースラインを登録しました: $src -> $BASELINE_FILE"
+}
+
 # ========== メイン ==========
 
 main() {
+    case "${1:-run}" in
+        baseline)
+            save_baseline "$2"
+            return
+            ;;
+        compare)
+            [ $# -ge 3 ] || die "使い方: $0 compare <基準ログ> <新ログ>"
+            compare_results "$2" "$3"
+            return
+            ;;
+        run)
+            ;;
+        *)
+            die "不明なコマンド: $1"
+            ;;
+    esac
+
     mkdir -p "$LOG_DIR"
 
     echo "================================================="
@@ -153,11 +327,23 @@ main() {
     check_prerequisites
     run_xpmem_bench
     run_shm_bench
+    run_file_bench
+    run_pipe_bench
+    run_memfd_bench
+    run_c2c_bench
+    run_stream_bench
 
     log "================================================="
     log "  全ベンチマーク完了"
     log "  結果: $LOG_FILE"
     log "================================================="
+
+    # ベースラインがあれば自動で比較 (劣化があれば非ゼロで終了)
+    if [ -f "$BASELINE_FILE" ]; then
+        echo ""
+        compare_results "$BASELINE_FILE" "$LOG_FILE" | tee -a "$LOG_FILE"
+        return "${PIPESTATUS[0]}"
+    fi
 }
 
 main "$@"
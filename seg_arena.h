@@ -0,0 +1,195 @@
+/*
+ * seg_arena.h - エクスポート領域内のオフセットベース・アリーナアロケータ
+ *
+ * エクスポータは公開するセグメントの補助領域をアリーナとして管理し、
+ * 可変長オブジェクトを確保して「アリーナ先頭からのオフセット」を
+ * ハンドルとして公開する。インポータは自分の attach アドレスを基点に
+ * ハンドルを解決するので、プロセスごとにマッピングアドレスが違っても
+ * シリアライズせずにオブジェクトグラフを辿れる。
+ *
+ * - 小さいオブジェクトは2のべき乗のサイズクラスごとのスラブから確保し、
+ *   arena_free() でクラスのフリーリストに戻す
+ * - SLAB_MAX_CLASS_SIZE を超えるものはバンプ確保のみ (解放しない)
+ * - 確保・解放はエクスポータ (1スレッド) のみが行う前提。インポータは
+ *   ヘッダのルート表と arena_ptr() による解決だけを使う
+ */
+
+#ifndef SEG_ARENA_H
+#define SEG_ARENA_H
+
+#include <stdint.h>
+#include <string.h>
+#include <stdatomic.h>
+
+#define ARENA_MAGIC          0x41524e4158504d45ULL   /* "EMPXANRA" */
+#define ARENA_ALIGN          64
+#define ARENA_MIN_CLASS      6                      /* 64 B */
+#define ARENA_NUM_CLASSES    12                     /* 64 B .. 128 KB */
+#define SLAB_MAX_CLASS_SIZE  (1UL << (ARENA_MIN_CLASS + ARENA_NUM_CLASSES - 1))
+#define ARENA_SLAB_BYTES     (256UL * 1024)
+#define ARENA_MAX_ROOTS      32
+#define ARENA_ROOT_NAME_LEN  24
+
+/* アリーナ先頭からのオフセット。0 は NULL */
+typedef uint64_t arena_handle_t;
+
+/* 名前付きルート: インポータが最初に辿る入口 */
+typedef struct {
+    char name[ARENA_ROOT_NAME_LEN];
+    _Atomic arena_handle_t handle;
+} arena_root_t;
+
+typedef struct {
+    uint64_t magic;
+    uint64_t capacity;                           /* アリーナ全体のバイト数 */
+    uint64_t top;                                /* バンプ位置 */
+    arena_handle_t free_list[ARENA_NUM_CLASSES]; /* サイズクラスごとの空きブロック */
+    uint64_t allocated;                          /* 確保中のバイト数 (統計) */
+    arena_root_t roots[ARENA_MAX_ROOTS];
+} arena_header_t;
+
+static inline void *arena_ptr(const void *base, arena_handle_t h)
+{
+    return h ? (char *)base + h : NULL;
+}
+
+static inline arena_handle_t arena_handle_of(const void *base, const void *p)
+{
+    return p ? (arena_handle_t)((const char *)p - (const char *)base) : 0;
+}
+
+static inline uint64_t arena_align_up(uint64_t x, uint64_t a)
+{
+    return (x + a - 1) & ~(a - 1);
+}
+
+/* base から capacity バイトをアリーナとして初期化する */
+static inline arena_header_t *arena_init(void *base, size_t capacity)
+{
+    arena_header_t *a = (arena_header_t *)base;
+    memset(a, 0, sizeof(*a));
+    a->magic = ARENA_MAGIC;
+    a->capacity = capacity;
+    a->top = arena_align_up(sizeof(*a), ARENA_ALIGN);
+    return a;
+}
+
+/* インポータ側: 既存のアリーナを検証して返す。不正なら NULL */
+static inline const arena_header_t *arena_open(const void *base, size_t capacity)
+{
+    const arena_header_t *a = (const arena_header_t *)base;
+    if (capacity < sizeof(*a) || a->magic != ARENA_MAGIC || a->capacity > capacity)
+        return NULL;
+    return a;
+}
+
+static inline arena_handle_t arena_bump(arena_header_t *a, uint64_t size, uint64_t align)
+{
+    uint64_t off = arena_align_up(a->top, align);
+    if (off + size > a->capacity)
+        return 0;
+    a->top = off + size;
+    return off;
+}
+
+/* size を収めるサイズクラス。スラブ対象外なら -1 */
+static inline int arena_class_of(size_t size)
+{
+    if (size > SLAB_MAX_CLASS_SIZE)
+        return -1;
+    int c = 0;
+    while ((1UL << (ARENA_MIN_CLASS + c)) < size)
+        c++;
+    return c;
+}
+
+/* 空のクラスにスラブを1枚切り出してフリーリストに並べる */
+static inline int arena_refill(arena_header_t *a, int cls)
+{
+    uint64_t bsize = 1UL << (ARENA_MIN_CLASS + cls);
+    uint64_t slab = bsize > ARENA_SLAB_BYTES ? bsize : ARENA_SLAB_BYTES;
+    arena_handle_t s = arena_bump(a, slab, ARENA_ALIGN);
+    if (!s)
+        return -1;
+    /* 後ろから積んで、先頭ブロックから順に払い出されるようにする */
+    for (uint64_t off = slab; off >= bsize; off -= bsize) {
+        arena_handle_t blk = s + off - bsize;
+        *(arena_handle_t *)arena_ptr(a, blk) = a->free_list[cls];
+        a->free_list[cls] = blk;
+    }
+    return 0;
+}
+
+/* size バイトを確保してハンドルを返す。失敗時 0 */
+static inline arena_handle_t arena_alloc(arena_header_t *a, size_t size)
+{
+    if (size == 0)
+        size = 1;
+    int cls = arena_class_of(size);
+    if (cls < 0) {
+        arena_handle_t h = arena_bump(a, size, ARENA_ALIGN);
+        if (h)
+            a->allocated += size;
+        return h;
+    }
+    if (!a->free_list[cls] && arena_refill(a, cls) != 0)
+        return 0;
+    arena_handle_t h = a->free_list[cls];
+    a->free_list[cls] = *(arena_handle_t *)arena_ptr(a, h);
+    a->allocated += 1UL << (ARENA_MIN_CLASS + cls);
+    return h;
+}
+
+/* 確保時と同じ size を渡して解放する (大きいものは何もしない) */
+static inline void arena_free(arena_header_t *a, arena_handle_t h, size_t size)
+{
+    int cls = arena_class_of(size ? size : 1);
+    if (!h || cls < 0)
+        return;
+    *(arena_handle_t *)arena_ptr(a, h) = a->free_list[cls];
+    a->free_list[cls] = h;
+    a->allocated -= 1UL << (ARENA_MIN_CLASS + cls);
+}
+
+/* 名前付きルートを公開する (同名があれば上書き)。成功で 0 */
+static inline int arena_publish(arena_header_t *a, const char *name, arena_handle_t h)
+{
+    int empty = -1;
+    for (int i = 0; i < ARENA_MAX_ROOTS; i++) {
+        if (a->roots[i].name[0] == '\0') {
+            if (empty < 0) empty = i;
+            continue;
+        }
+        if (strncmp(a->roots[i].name, name, ARENA_ROOT_NAME_LEN) == 0) {
+            atomic_store_explicit(&a->roots[i].handle, h, memory_order_release);
+            return 0;
+        }
+    }
+    if (empty < 0)
+        return -1;
+    strncpy(a->roots[empty].name, name, ARENA_ROOT_NAME_LEN - 1);
+    atomic_store_explicit(&a->roots[empty].handle, h, memory_order_release);
+    return 0;
+}
+
+static inline arena_handle_t arena_lookup(const arena_header_t *a, const char *name)
+{
+    for (int i = 0; i < ARENA_MAX_ROOTS; i++) {
+        if (strncmp(a->roots[i].name, name, ARENA_ROOT_NAME_LEN) == 0)
+            return atomic_load_explicit(&((arena_header_t *)a)->roots[i].handle,
+                                        memory_order_acquire);
+    }
+    return 0;
+}
+
+/* ========== ベンチマーク用オブジェクト ========== */
+
+/* 連結リストで公開する可変長オブジェクト */
+typedef struct {
+    arena_handle_t next;
+    uint32_t len;       /* data のバイト数 */
+    uint32_t seq;
+    uint8_t data[];
+} arena_obj_t;
+
+#endif /* SEG_ARENA_H */
@@ -0,0 +1,271 @@
+/*
+ * seg_extent.h - 不連続な区間 (extent) の gather / scatter
+ *
+ * 実際のメッセージが1つの連続した範囲になることは少なく、セグメント上の
+ * (offset, length) の並び (extent リスト) をローカルの詰めたバッファへ
+ * 集める (gather)、またはその逆に撒く (scatter) ことになる。ここでは
+ *   loop  extent ごとに memcpy
+ *   mtN   N スレッドで extent を分担してコピー (スレッドは計測の間使い回す)
+ *   pvm   process_vm_readv / process_vm_writev に iovec で渡す (IOV_MAX 個ずつ)
+ * の3通りを用意する。pvm はエクスポータのアドレス空間での番地が要るので、
+ * BENCH_EXT_PVM=1 のときだけエクスポータはデータ領域の先頭番地と PID を
+ * アリーナに "segbase" として公開し、Yama (ptrace_scope=1) でも読めるよう
+ * PR_SET_PTRACER_ANY を設定する (どのプロセスからも ptrace できるようになるので
+ * 既定では行わず、インポータは pvm を省略する)。
+ */
+
+#ifndef SEG_EXTENT_H
+#define SEG_EXTENT_H
+
+#include <stdint.h>
+#include <string.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <sys/prctl.h>
+#include <sys/uio.h>
+#include "common.h"
+#include "seg_arena.h"
+
+#ifndef IOV_MAX
+#define IOV_MAX 1024
+#endif
+
+#define EXTENT_MAX_THREADS 64
+
+/* アリーナに置くデータ領域の番地 (エクスポータのアドレス空間) */
+typedef struct {
+    uint64_t addr;
+    int32_t pid;
+    uint32_t pad;
+} seg_base_t;
+
+typedef struct {
+    uint64_t off;               /* セグメント上の位置 (データ領域先頭から) */
+    uint64_t len;
+    uint64_t pos;               /* 詰めたバッファ上の位置 */
+} extent_t;
+
+/*
+ * エクスポータ側: データ領域の番地を公開し、ptrace を許す。
+ * BENCH_EXT_PVM=1 のときだけ呼ぶ。失敗時 NULL
+ */
+static inline seg_base_t *seg_base_create(arena_header_t *a, const void *buf)
+{
+    arena_handle_t h = arena_alloc(a, sizeof(seg_base_t));
+    if (!h)
+        return NULL;
+    seg_base_t *b = (seg_base_t *)arena_ptr(a, h);
+    memset(b, 0, sizeof(*b));
+    b->addr = (uint64_t)(uintptr_t)buf;
+    b->pid = getpid();
+    /* Yama が無ければ失敗するが、その場合は同じ uid なら読める */
+    prctl(PR_SET_PTRACER, PR_SET_PTRACER_ANY, 0, 0, 0);
+    arena_publish(a, "segbase", h);
+    return b;
+}
+
+/* インポータ側: 公開された番地を引く。無ければ NULL */
+static inline const seg_base_t *seg_base_lookup(const void *arena_base, size_t arena_size)
+{
+    const arena_header_t *a = arena_base ? arena_open(arena_base, arena_size) : NULL;
+    arena_handle_t h = a ? arena_lookup(a, "segbase") : 0;
+    return h ? (const seg_base_t *)arena_ptr(arena_base, h) : NULL;
+}
+
+/*
+ * span バイトの範囲に len バイトの extent を n 個並べ、詰めたときの合計を返す
+ * (n * len <= span)。範囲を間隔 span/n の枠に分け、順次は各枠の先頭を
+ * 前から順に使う。ランダムは枠の中で 64 バイト境界の位置をずらし、枠の順番を
+ * シャッフルする。どちらも extent は重ならないので、複数スレッドの scatter が
+ * 同じバイトを書くことはない。詰めたバッファ上では extent の順に隙間なく並ぶ
+ */
+static inline size_t extent_build(extent_t *e, size_t n, size_t len, size_t span, int random,
+                                  uint64_t seed)
+{
+    size_t stride = span / n;
+    size_t jitter = (stride - len) / 64 + 1;
+    uint64_t rng = seed ? seed : 1;
+    for (size_t i = 0; i < n; i++) {
+        e[i].off = i * stride + (random ? (xorshift64(&rng) % jitter) * 64 : 0);
+        e[i].len = len;
+        e[i].pos = i * len;
+    }
+    for (size_t i = n - 1; random && i > 0; i--) {
+        size_t j = xorshift64(&rng) % (i + 1);
+        uint64_t t = e[i].off;
+        e[i].off = e[j].off;
+        e[j].off = t;
+    }
+    return n * len;
+}
+
+/* gather した詰めたバッファが fill_pattern の内容と合わない extent の数 */
+static inline size_t extent_verify(const char *packed, const extent_t *e, size_t n)
+{
+    size_t bad = 0;
+    for (size_t i = 0; i < n; i++)
+        for (uint64_t k = 0; k < e[i].len; k++)
+            if ((uint8_t)packed[e[i].pos + k] != (uint8_t)((e[i].off + k) & 0xFF)) {
+                bad++;
+                break;
+            }
+    return bad;
+}
+
+/* ========== extent ごとの memcpy ========== */
+
+typedef struct {
+    char *seg;                  /* アタッチしたデータ領域の先頭 */
+    char *packed;               /* 詰めたローカルバッファ */
+    const extent_t *e;
+    size_t n;
+    int scatter;                /* 0: gather (seg → packed), 1: scatter (packed → seg) */
+} extent_arg_t;
+
+static inline void extent_copy_range(const extent_arg_t *a, size_t lo, size_t hi)
+{
+    if (a->scatter) {
+        for (size_t i = lo; i < hi; i++)
+            memcpy(a->seg + a->e[i].off, a->packed + a->e[i].pos, a->e[i].len);
+    } else {
+        for (size_t i = lo; i < hi; i++)
+            memcpy(a->packed + a->e[i].pos, a->seg + a->e[i].off, a->e[i].len);
+    }
+}
+
+static inline void op_extent_loop(void *arg)
+{
+    const extent_arg_t *a = (const extent_arg_t *)arg;
+    extent_copy_range(a, 0, a->n);
+}
+
+/* ========== 複数スレッドでの分担 ========== */
+
+typedef struct extent_pool extent_pool_t;
+
+typedef struct {
+    extent_pool_t *pool;
+    int idx;
+    pthread_t tid;
+} extent_worker_t;
+
+/*
+ * 呼び出し元を含む nthreads 本で extent を連続した区間に分けてコピーする。
+ * 1回ごとにスレッドを作ると作成時間を計ってしまうので、ワーカは gen が
+ * 進むのを待って自分の区間をコピーし、pending を減らす
+ */
+struct extent_pool {
+    const extent_arg_t *job;
+    int nthreads;
+    _Atomic uint64_t gen;       /* 仕事を出すたびに進める */
+    _Atomic int pending;        /* まだ終わっていないワーカの数 */
+    _Atomic int stop;
+    extent_worker_t w[EXTENT_MAX_THREADS];
+};
+
+static inline void extent_pool_slice(const extent_pool_t *p, int idx)
+{
+    const extent_arg_t *a = p->job;
+    extent_copy_range(a, a->n * (size_t)idx / (size_t)p->nthreads,
+                      a->n * (size_t)(idx + 1) / (size_t)p->nthreads);
+}
+
+static inline void *extent_worker_main(void *arg)
+{
+    extent_worker_t *w = (extent_worker_t *)arg;
+    extent_pool_t *p = w->pool;
+    uint64_t seen = 0;
+    for (;;) {
+        int spins = 0;
+        uint64_t g;
+        while ((g = atomic_load_explicit(&p->gen, memory_order_acquire)) == seen &&
+               !atomic_load_explicit(&p->stop, memory_order_relaxed))
+            spin_backoff(&spins);
+        if (g == seen)
+            break;
+        seen = g;
+        extent_pool_slice(p, w->idx);
+        atomic_fetch_sub_explicit(&p->pending, 1, memory_order_release);
+    }
+    return NULL;
+}
+
+/* nthreads 本 (呼び出し元を含む) で始める。作れた本数に合わせて減らし、それを返す */
+static inline int extent_pool_start(extent_pool_t *p, const extent_arg_t *job, int nthreads)
+{
+    memset(p, 0, sizeof(*p));
+    p->job = job;
+    if (nthreads > EXTENT_MAX_THREADS)
+        nthreads = EXTENT_MAX_THREADS;
+    p->nthreads = 1;
+    for (int t = 1; t < nthreads; t++) {
+        p->w[t].pool = p;
+        p->w[t].idx = t;
+        if (pthread_create(&p->w[t].tid, NULL, extent_worker_main, &p->w[t]) != 0)
+            break;
+        p->nthreads++;
+    }
+    return p->nthreads;
+}
+
+static inline void extent_pool_stop(extent_pool_t *p)
+{
+    atomic_store_explicit(&p->stop, 1, memory_order_relaxed);
+    for (int t = 1; t < p->nthreads; t++)
+        pthread_join(p->w[t].tid, NULL);
+}
+
+/* 1回分のコピー (arg は extent_pool_t) */
+static inline void op_extent_mt(void *arg)
+{
+    extent_pool_t *p = (extent_pool_t *)arg;
+    atomic_store_explicit(&p->pending, p->nthreads - 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&p->gen, 1, memory_order_release);
+    extent_pool_slice(p, 0);
+    int spins = 0;
+    while (atomic_load_explicit(&p->pending, memory_order_acquire) > 0)
+        spin_backoff(&spins);
+}
+
+/* ========== process_vm_readv / process_vm_writev ========== */
+
+typedef struct {
+    const extent_arg_t *job;
+    pid_t pid;
+    struct iovec *riov;         /* extent ごとのエクスポータ側の iovec */
+    int err;                    /* 失敗した errno (0: 成功) */
+} extent_pvm_arg_t;
+
+/* riov に extent ごとのエクスポータ側の番地を入れる */
+static inline void extent_pvm_setup(extent_pvm_arg_t *a, const extent_arg_t *job,
+                                    const seg_base_t *base, struct iovec *riov)
+{
+    a->job = job;
+    a->pid = base->pid;
+    a->riov = riov;
+    a->err = 0;
+    for (size_t i = 0; i < job->n; i++) {
+        riov[i].iov_base = (void *)(uintptr_t)(base->addr + job->e[i].off);
+        riov[i].iov_len = job->e[i].len;
+    }
+}
+
+/* ローカル側は詰めたバッファの1区間なので、IOV_MAX 個ずつ1回の呼び出しで済む */
+static inline void op_extent_pvm(void *arg)
+{
+    extent_pvm_arg_t *a = (extent_pvm_arg_t *)arg;
+    const extent_arg_t *j = a->job;
+    for (size_t i = 0; i < j->n && !a->err; i += IOV_MAX) {
+        size_t k = j->n - i < IOV_MAX ? j->n - i : IOV_MAX;
+        size_t bytes = j->e[i + k - 1].pos + j->e[i + k - 1].len - j->e[i].pos;
+        struct iovec local = { j->packed + j->e[i].pos, bytes };
+        ssize_t r = j->scatter
+            ? process_vm_writev(a->pid, &local, 1, a->riov + i, k, 0)
+            : process_vm_readv(a->pid, &local, 1, a->riov + i, k, 0);
+        if (r != (ssize_t)bytes)
+            a->err = r < 0 ? errno : EIO;
+    }
+}
+
+#endif /* SEG_EXTENT_H */
@@ -0,0 +1,225 @@
+/*
+ * seg_init.h - エクスポート領域の並列初期化と遅延公開
+ *
+ * 最大サイズが大きいと、1スレッドの memset + fill_pattern だけで
+ * 公開までに数秒〜数分かかる。ここでは領域を連続した区間に分けて
+ * 複数スレッドで
+ *   1. プリフォルト   MADV_POPULATE_WRITE (使えなければ1ページずつ書く)
+ *   2. パターン書き込み fill_pattern と同じ内容 (データ領域のみ)
+ * を行う。スレッドはエクスポータと同じ NUMA ノードの CPU に固定するので、
+ * ページは従来どおりエクスポータのノードに載る。
+ *
+ * 遅延公開 (BENCH_INIT_LAZY=1) ではデータ領域の初期化の前にセグメントを
+ * 公開し、初期化を裏で進める (アリーナは公開前に自分で触れるので対象外)。
+ * 完了はアリーナの "initctl" で知らせ、インポータはデータ領域を読む
+ * 計測の前に init_ctl_wait() で待つ。
+ */
+
+#ifndef SEG_INIT_H
+#define SEG_INIT_H
+
+#include <stdint.h>
+#include <string.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include "common.h"
+#include "seg_arena.h"
+#include "topology.h"
+
+#ifndef MADV_POPULATE_WRITE
+#define MADV_POPULATE_WRITE 23
+#endif
+
+#define INIT_MAX_THREADS 256
+
+/* アリーナに置く初期化の完了通知 */
+typedef struct {
+    _Atomic uint32_t ready;     /* データ領域の初期化が終わったら 1 */
+    uint32_t pad;
+    double ready_sec;           /* エクスポータ起動から完了までの秒数 */
+} init_ctl_t;
+
+typedef struct seg_init seg_init_t;
+
+typedef struct {
+    seg_init_t *init;
+    size_t lo, hi;              /* 受け持つ区間 (ページ境界) */
+    int cpu;                    /* -1: 固定しない */
+    int populated;              /* MADV_POPULATE_WRITE で済んだら 1 */
+    int started;                /* スレッドを作れた */
+    double prefault_sec, fill_sec;
+    pthread_t tid;
+} init_worker_t;
+
+struct seg_init {
+    char *buf;
+    size_t seg_size;            /* プリフォルトする範囲 */
+    size_t fill_size;           /* パターンを書く範囲 (データ領域) */
+    int nthreads;
+    int node;                   /* スレッドを固定したノード (-1: 固定しない) */
+    double start;               /* エクスポータ起動時刻 (get_time_sec) */
+    double prefault_sec, fill_sec, ready_sec;
+    int populated;              /* 全スレッドが MADV_POPULATE_WRITE を使えた */
+    init_ctl_t *ctl;            /* 遅延公開なら完了をここで知らせる */
+    int background;             /* 遅延公開の裏スレッドを作った */
+    pthread_t tid;
+    init_worker_t w[INIT_MAX_THREADS];
+};
+
+/* エクスポータ側: 完了通知を確保して公開する。失敗時 NULL */
+static inline init_ctl_t *init_ctl_create(arena_header_t *a)
+{
+    arena_handle_t h = arena_alloc(a, sizeof(init_ctl_t));
+    if (!h)
+        return NULL;
+    init_ctl_t *c = (init_ctl_t *)arena_ptr(a, h);
+    memset(c, 0, sizeof(*c));
+    arena_publish(a, "initctl", h);
+    return c;
+}
+
+/* インポータ側: 完了まで待つ。待った秒数を返す (通知が無ければ 0) */
+static inline double init_ctl_wait(const void *arena_base, size_t arena_size)
+{
+    const arena_header_t *a = arena_base ? arena_open(arena_base, arena_size) : NULL;
+    arena_handle_t h = a ? arena_lookup(a, "initctl") : 0;
+    if (!h)
+        return 0;
+    const init_ctl_t *c = (const init_ctl_t *)arena_ptr(arena_base, h);
+    double t0 = get_time_sec();
+    while (!atomic_load_explicit(&c->ready, memory_order_acquire))
+        usleep(1000);
+    return get_time_sec() - t0;
+}
+
+static inline void *init_worker_main(void *arg)
+{
+    init_worker_t *w = (init_worker_t *)arg;
+    seg_init_t *s = w->init;
+    if (w->cpu >= 0)
+        pin_cpu(w->cpu);
+
+    /* 1. プリフォルト (ゼロページのまま確保だけする) */
+    char *p = s->buf + w->lo;
+    size_t len = w->hi - w->lo;
+    double t0 = get_time_sec();
+    w->populated = len == 0 || madvise(p, len, MADV_POPULATE_WRITE) == 0;
+    if (!w->populated)
+        for (size_t off = 0; off < len; off += 4096)
+            ((volatile char *)p)[off] = ((volatile char *)p)[off];
+    double t1 = get_time_sec();
+
+    /* 2. パターン (区間の先頭は 256 の倍数なので fill_pattern と同じ内容になる) */
+    if (w->lo < s->fill_size)
+        fill_pattern(p, (w->hi < s->fill_size ? w->hi : s->fill_size) - w->lo);
+    w->prefault_sec = t1 - t0;
+    w->fill_sec = get_time_sec() - t1;
+    return NULL;
+}
+
+/*
+ * buf の seg_size バイトを初期化する準備。threads が 0 以下なら
+ * エクスポータのノードの CPU 数。start は起動時刻 (time-to-ready の基点)
+ */
+static inline void seg_init_setup(seg_init_t *s, void *buf, size_t seg_size, size_t fill_size,
+                                  long threads, double start)
+{
+    memset(s, 0, sizeof(*s));
+    s->buf = (char *)buf;
+    s->seg_size = seg_size;
+    s->fill_size = fill_size;
+    s->start = start;
+
+    long cpus[INIT_MAX_THREADS];
+    int cpu = sched_getcpu();
+    s->node = cpu >= 0 ? topo_cpu_node(cpu) : -1;
+    int ncpus = s->node >= 0 ? topo_node_cpus(s->node, cpus, INIT_MAX_THREADS) : 0;
+    if (ncpus == 0)
+        s->node = -1;
+    if (threads <= 0)
+        threads = ncpus > 0 ? ncpus : sysconf(_SC_NPROCESSORS_ONLN);
+    if (threads > INIT_MAX_THREADS)
+        threads = INIT_MAX_THREADS;
+    /* 1スレッドあたり 64 MB 未満なら増やしても速くならない */
+    long useful = (long)(seg_size / (64UL * 1024 * 1024)) + 1;
+    if (threads > useful)
+        threads = useful;
+    s->nthreads = (int)(threads < 1 ? 1 : threads);
+
+    size_t pages = (seg_size + 4095) / 4096;
+    for (int t = 0; t < s->nthreads; t++) {
+        init_worker_t *w = &s->w[t];
+        w->init = s;
+        w->lo = pages * (size_t)t / (size_t)s->nthreads * 4096;
+        w->hi = pages * (size_t)(t + 1) / (size_t)s->nthreads * 4096;
+        if (w->hi > seg_size)
+            w->hi = seg_size;
+        w->cpu = ncpus > 0 ? (int)cpus[t % ncpus] : -1;
+    }
+}
+
+/* 初期化を実行して終わるまで待つ (遅延公開では裏スレッドで呼ばれる) */
+static inline void seg_init_run(seg_init_t *s)
+{
+    for (int t = 0; t < s->nthreads; t++) {
+        s->w[t].started = pthread_create(&s->w[t].tid, NULL, init_worker_main, &s->w[t]) == 0;
+        if (!s->w[t].started)
+            init_worker_main(&s->w[t]);     /* 作れなければ自分で受け持つ */
+    }
+    s->populated = 1;
+    for (int t = 0; t < s->nthreads; t++) {
+        init_worker_t *w = &s->w[t];
+        if (w->started)
+            pthread_join(w->tid, NULL);
+        s->populated &= w->populated;
+        /* 区間ごとの時間の最大 (一番遅いスレッド) を各段階の時間とする */
+        if (w->prefault_sec > s->prefault_sec)
+            s->prefault_sec = w->prefault_sec;
+        if (w->fill_sec > s->fill_sec)
+            s->fill_sec = w->fill_sec;
+    }
+    s->ready_sec = get_time_sec() - s->start;
+    if (s->ctl) {
+        s->ctl->ready_sec = s->ready_sec;
+        atomic_store_explicit(&s->ctl->ready, 1, memory_order_release);
+    }
+}
+
+static inline void *seg_init_thread(void *arg)
+{
+    seg_init_run((seg_init_t *)arg);
+    return NULL;
+}
+
+/*
+ * 遅延公開: 裏で初期化を始める。完了は ctl で知らせる。
+ * スレッドを作れなければその場で初期化して -1
+ */
+static inline int seg_init_start(seg_init_t *s, init_ctl_t *ctl)
+{
+    s->ctl = ctl;
+    s->background = pthread_create(&s->tid, NULL, seg_init_thread, s) == 0;
+    if (!s->background)
+        seg_init_run(s);
+    return s->background ? 0 : -1;
+}
+
+static inline void seg_init_join(seg_init_t *s)
+{
+    if (s->background)
+        pthread_join(s->tid, NULL);
+    s->background = 0;
+}
+
+static inline void seg_init_report(const seg_init_t *s)
+{
+    char sizebuf[64];
+    printf("初期化: %s を %d スレッド", format_size(s->seg_size, sizebuf, sizeof(sizebuf)),
+           s->nthreads);
+    if (s->node >= 0)
+        printf(" (NUMA ノード %d の CPU)", s->node);
+    printf(", プリフォルト %.3f 秒 (%s), パターン %.3f 秒 (最も遅いスレッド)\n", s->prefault_sec,
+           s->populated ? "MADV_POPULATE_WRITE" : "ページごとに書き込み", s->fill_sec);
+}
+
+#endif /* SEG_INIT_H */
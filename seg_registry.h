@@ -0,0 +1,585 @@
+/*
+ * seg_registry.h - 名前付きセグメントのレジストリ (ホスト内の共有ディレクトリ)
+ *
+ * エクスポータは公開したセグメントを名前で登録し、インポータは名前で
+ * 引いて segid・サイズ・所有者 pid・NUMA ノード・世代を得る。
+ * 1ホストで複数のデータセットを同時に公開できるよう、固定パスのファイル
+ * 1つではなく POSIX 共有メモリ上のハッシュ表にする。
+ *
+ * - オープンアドレス法 (線形探索)。名前の FNV-1a ハッシュで位置を決め、
+ *   ハッシュと名前の両方を比べるので衝突しても取り違えない
+ * - 削除は墓標 (REG_DEAD) にして探索の連鎖を切らない。直後が空きなら
+ *   墓標の並びを空きに戻し、墓標と登録中の合計が 3/4 に達したら表を
+ *   詰め直す (登録と削除を繰り返しても空きが尽きない)
+ * - 書き込み (登録・削除) はヘッダのロックで直列化する。ロックには
+ *   持ち主の pid を入れ、持ち主が死んでいれば奪う。書き換えの途中で
+ *   死んでいた (epoch やスロットの seq が奇数のまま) なら、奪った側が
+ *   残っている登録から表を作り直す
+ * - 読み出しはロックなし。スロットごとの seqlock で破れた値を読まない。
+ *   詰め直しの間はヘッダの epoch が奇数になり、読み手は引き直す。
+ *   奇数のまま書き手が居なくなっていれば、待たずに「見つからない」とする
+ * - 同じ名前を登録し直すと同じスロットを上書きし、世代 (レジストリ全体で
+ *   単調増加) が変わる。インポータは reg_wait() で置き換えを待てる
+ */
+
+#ifndef SEG_REGISTRY_H
+#define SEG_REGISTRY_H
+
+#include <stdint.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <sys/syscall.h>
+#include "common.h"
+
+#define REG_MAGIC          0x3252474553504d58ULL   /* "XMPSEGR2" */
+#define REG_NAME_LEN       48
+#define REG_DEFAULT_SLOTS  8192
+
+enum { REG_EMPTY = 0, REG_LIVE, REG_DEAD };
+
+/* 登録内容。reg_lookup() はこれをコピーして返す */
+typedef struct {
+    char name[REG_NAME_LEN];
+    long long segid;
+    uint64_t size;              /* データ領域のサイズ */
+    uint64_t aux_offset;        /* 補助領域 (アリーナ) の開始オフセット */
+    uint64_t aux_size;          /* 補助領域のサイズ。0 なら無し */
+    int32_t pid;                /* 所有者 (エクスポータ) */
+    int32_t node;               /* データ領域先頭ページの NUMA ノード (-1: 不明) */
+    uint64_t generation;
+} reg_info_t;
+
+typedef struct {
+    _Alignas(64) _Atomic uint32_t seq;  /* 書き換え中は奇数 */
+    uint32_t state;                     /* REG_* */
+    uint64_t hash;
+    reg_info_t info;
+} reg_slot_t;
+
+typedef struct {
+    _Atomic uint64_t magic;     /* 初期化を終えてから書く */
+    uint64_t slots;             /* 2のべき乗 */
+    _Atomic int32_t lock;       /* 書き手の pid (0: 空き) */
+    _Atomic uint64_t next_gen;
+    _Atomic uint64_t live;      /* 登録中のエントリ数 */
+    _Atomic uint64_t dead;      /* 墓標の数 */
+    _Atomic uint32_t epoch;     /* 詰め直し中は奇数 */
+    _Atomic uint64_t changes;   /* 登録・削除のたびに増える (待つ側はこれだけ見る) */
+    _Alignas(64) reg_slot_t slot[];
+} reg_header_t;
+
+static inline size_t reg_bytes(uint64_t slots)
+{
+    return sizeof(reg_header_t) + slots * sizeof(reg_slot_t);
+}
+
+static inline uint64_t reg_hash(const char *name)
+{
+    uint64_t h = 0xcbf29ce484222325ULL;
+    for (const unsigned char *p = (const unsigned char *)name; *p; p++) {
+        h ^= *p;
+        h *= 0x100000001b3ULL;
+    }
+    return h;
+}
+
+/* 共有メモリ名。BENCH_REGISTRY で別のレジストリを使える */
+static inline const char *reg_default_name(void)
+{
+    const char *e = getenv("BENCH_REGISTRY");
+    return (e && *e) ? e : "/xpmem_bench_registry";
+}
+
+/*
+ * レジストリを開く。create なら無ければ slots 個 (2のべき乗に切り上げ)
+ * で作る。読み取り専用で開いた場合は reg_lookup() / reg_wait() だけ使う。
+ * 失敗時 NULL (形式が違えば消し方を表示し、errno = EPROTO)
+ */
+static inline reg_header_t *reg_open(const char *shm_name, int create, uint64_t slots)
+{
+    int fd = -1, creator = 0;
+    if (create) {
+        fd = shm_open(shm_name, O_CREAT | O_EXCL | O_RDWR, 0666);
+        creator = fd >= 0;
+        if (fd < 0 && errno != EEXIST)
+            return NULL;
+    }
+    if (fd < 0)
+        fd = shm_open(shm_name, create ? O_RDWR : O_RDONLY, 0);
+    if (fd < 0)
+        return NULL;
+
+    uint64_t n = 64;
+    while (n < slots)
+        n <<= 1;
+    if (creator && ftruncate(fd, (off_t)reg_bytes(n)) != 0) {
+        close(fd);
+        shm_unlink(shm_name);
+        return NULL;
+    }
+
+    /* 他のプロセスが作成中なら大きさが決まるまで待つ */
+    struct stat st;
+    for (int i = 0; fstat(fd, &st) == 0 && (size_t)st.st_size < sizeof(reg_header_t); i++) {
+        if (i >= 1000) {
+            close(fd);
+            return NULL;
+        }
+        usleep(1000);
+    }
+    int prot = create ? PROT_READ | PROT_WRITE : PROT_READ;
+    void *p = mmap(NULL, (size_t)st.st_size, prot, MAP_SHARED, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED)
+        return NULL;
+
+    reg_header_t *r = (reg_header_t *)p;
+    if (creator) {
+        r->slots = n;
+        atomic_store_explicit(&r->magic, REG_MAGIC, memory_order_release);
+    }
+    for (int i = 0;; i++) {
+        uint64_t magic = atomic_load_explicit(&r->magic, memory_order_acquire);
+        if (magic == REG_MAGIC)
+            break;
+        /* 別の版の形式 (または作成途中で止まったもの) は待っても直らない */
+        if (magic != 0 || i >= 1000) {
+            fprintf(stderr, "レジストリ %s の形式が違います (%s)。"
+                    "使っているプロセスが無ければ rm /dev/shm%s で消してください\n",
+                    shm_name, magic ? "別の版" : "作成途中で停止", shm_name);
+            munmap(p, (size_t)st.st_size);
+            errno = EPROTO;
+            return NULL;
+        }
+        usleep(1000);
+    }
+    return r;
+}
+
+static inline void reg_close(reg_header_t *r)
+{
+    if (r)
+        munmap(r, reg_bytes(r->slots));
+}
+
+/* ロック中に name のスロットを探す。無ければ *free_slot に使える位置 (無ければ NULL) */
+static inline reg_slot_t *reg_find_locked(reg_header_t *r, const char *name, uint64_t hash,
+                                          reg_slot_t **free_slot)
+{
+    uint64_t mask = r->slots - 1;
+    *free_slot = NULL;
+    for (uint64_t i = 0; i < r->slots; i++) {
+        reg_slot_t *s = &r->slot[(hash + i) & mask];
+        if (s->state == REG_EMPTY) {
+            if (!*free_slot)
+                *free_slot = s;
+            return NULL;
+        }
+        if (s->hash == hash && strncmp(s->info.name, name, REG_NAME_LEN) == 0)
+            return s;
+        if (s->state == REG_DEAD && !*free_slot)
+            *free_slot = s;
+    }
+    return NULL;
+}
+
+static inline void reg_slot_write(reg_slot_t *s, uint32_t state, uint64_t hash,
+                                  const reg_info_t *info)
+{
+    uint32_t seq = atomic_load_explicit(&s->seq, memory_order_relaxed);
+    atomic_store_explicit(&s->seq, seq + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    s->state = state;
+    s->hash = hash;
+    if (info)
+        s->info = *info;
+    atomic_store_explicit(&s->seq, seq + 2, memory_order_release);
+}
+
+/* 探索の上限 (登録中 + 墓標)。新しい名前はこれを超えて入れない */
+static inline uint64_t reg_load_limit(const reg_header_t *r)
+{
+    return r->slots - r->slots / 4;
+}
+
+/*
+ * ロック中に墓標を取り除いて表を詰め直す。登録中のエントリは世代を
+ * 保ったまま入れ直す。作業用のメモリが取れなければ何もしない
+ */
+static inline void reg_compact_locked(reg_header_t *r)
+{
+    /* 書き手が途中で死んだ後は live が合っていないことがあるので数え直す */
+    uint64_t n = 0;
+    for (uint64_t i = 0; i < r->slots; i++)
+        n += r->slot[i].state == REG_LIVE;
+    reg_info_t *keep = malloc((n ? n : 1) * sizeof(*keep));
+    if (!keep)
+        return;
+
+    /* 前の詰め直しが途中で止まっていれば epoch は既に奇数 */
+    uint32_t epoch = atomic_load_explicit(&r->epoch, memory_order_relaxed) | 1;
+    atomic_store_explicit(&r->epoch, epoch, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+
+    uint64_t k = 0, mask = r->slots - 1;
+    for (uint64_t i = 0; i < r->slots; i++) {
+        reg_slot_t *s = &r->slot[i];
+        if (s->state == REG_LIVE && k < n)
+            keep[k++] = s->info;
+        if (s->state != REG_EMPTY)
+            reg_slot_write(s, REG_EMPTY, 0, NULL);
+    }
+    for (uint64_t j = 0; j < k; j++) {
+        uint64_t hash = reg_hash(keep[j].name);
+        uint64_t i = hash;
+        while (r->slot[i & mask].state != REG_EMPTY)
+            i++;
+        reg_slot_write(&r->slot[i & mask], REG_LIVE, hash, &keep[j]);
+    }
+    atomic_store(&r->live, k);
+    atomic_store(&r->dead, 0);
+
+    atomic_store_explicit(&r->epoch, epoch + 1, memory_order_release);
+    free(keep);
+}
+
+/*
+ * 奪ったロックの持ち主が書き換えの途中で死んでいたら表を作り直す。
+ * 奇数のまま残ったスロットは中身が破れているかもしれないので捨てる
+ * (そこにあった登録と、詰め直しで取り出されたまま戻らなかった登録は失われる)
+ */
+static inline void reg_repair_locked(reg_header_t *r, int32_t owner)
+{
+    int broken = atomic_load_explicit(&r->epoch, memory_order_relaxed) & 1;
+    for (uint64_t i = 0; i < r->slots; i++) {
+        reg_slot_t *s = &r->slot[i];
+        uint32_t seq = atomic_load_explicit(&s->seq, memory_order_relaxed);
+        if (seq & 1) {
+            s->state = REG_EMPTY;
+            atomic_store_explicit(&s->seq, seq + 1, memory_order_release);
+            broken = 1;
+        }
+    }
+    if (!broken)
+        return;
+    fprintf(stderr, "レジストリ: 書き手 (pid %d) が書き換えの途中で終了したため表を作り直します\n",
+            (int)owner);
+    reg_compact_locked(r);
+}
+
+static inline void reg_lock(reg_header_t *r)
+{
+    int32_t me = (int32_t)getpid();
+    int spins = 0;
+    for (;;) {
+        int32_t owner = 0;
+        if (atomic_compare_exchange_weak_explicit(&r->lock, &owner, me,
+                                                  memory_order_acquire, memory_order_relaxed))
+            return;
+        /* 持ち主が死んでいたら奪い、書きかけの状態を直す */
+        if (owner != 0 && kill(owner, 0) != 0 && errno == ESRCH &&
+            atomic_compare_exchange_strong_explicit(&r->lock, &owner, me,
+                                                    memory_order_acquire, memory_order_relaxed)) {
+            reg_repair_locked(r, owner);
+            return;
+        }
+        spin_backoff(&spins);
+    }
+}
+
+static inline void reg_unlock(reg_header_t *r)
+{
+    atomic_store_explicit(&r->lock, 0, memory_order_release);
+}
+
+/*
+ * info->name で登録する (既にあれば置き換える)。info->generation に
+ * 新しい世代を入れて返す。表が埋まっていれば 0
+ */
+static inline uint64_t reg_publish(reg_header_t *r, reg_info_t *info)
+{
+    info->name[REG_NAME_LEN - 1] = '\0';
+    uint64_t hash = reg_hash(info->name);
+    reg_lock(r);
+    reg_slot_t *free_slot;
+    reg_slot_t *s = reg_find_locked(r, info->name, hash, &free_slot);
+    /* 新しい名前で墓標込みの 3/4 に達していたら詰め直す (探索の連鎖を短く保つ) */
+    if (!s && atomic_load(&r->live) + atomic_load(&r->dead) >= reg_load_limit(r)) {
+        reg_compact_locked(r);
+        s = reg_find_locked(r, info->name, hash, &free_slot);
+    }
+    if (!s && atomic_load(&r->live) >= reg_load_limit(r))
+        free_slot = NULL;
+    if (!s)
+        s = free_slot;
+    if (!s) {
+        reg_unlock(r);
+        return 0;
+    }
+    uint32_t old_state = s->state;
+    info->generation = atomic_fetch_add(&r->next_gen, 1) + 1;
+    reg_slot_write(s, REG_LIVE, hash, info);
+    if (old_state == REG_DEAD)
+        atomic_fetch_sub(&r->dead, 1);
+    if (old_state != REG_LIVE)
+        atomic_fetch_add(&r->live, 1);
+    atomic_fetch_add_explicit(&r->changes, 1, memory_order_release);
+    reg_unlock(r);
+    return info->generation;
+}
+
+/*
+ * name の登録を消す。generation が 0 でなければ、その世代のまま
+ * (他のエクスポータに置き換えられていない) 場合だけ消す。消せたら 0
+ */
+static inline int reg_remove(reg_header_t *r, const char *name, uint64_t generation)
+{
+    uint64_t hash = reg_hash(name);
+    reg_lock(r);
+    reg_slot_t *free_slot;
+    reg_slot_t *s = reg_find_locked(r, name, hash, &free_slot);
+    int rc = -1;
+    if (s && s->state == REG_LIVE &&
+        (generation == 0 || s->info.generation == generation)) {
+        reg_slot_write(s, REG_DEAD, hash, NULL);
+        atomic_fetch_sub(&r->live, 1);
+        atomic_fetch_add(&r->dead, 1);
+        /*
+         * 直後が空きなら、そこで終わる墓標の並びは誰の探索にも要らない。
+         * 後ろから空きに戻す
+         */
+        uint64_t mask = r->slots - 1, i = (uint64_t)(s - r->slot);
+        if (r->slot[(i + 1) & mask].state == REG_EMPTY) {
+            for (uint64_t k = 0; k < r->slots && r->slot[(i - k) & mask].state == REG_DEAD; k++) {
+                reg_slot_write(&r->slot[(i - k) & mask], REG_EMPTY, 0, NULL);
+                atomic_fetch_sub(&r->dead, 1);
+            }
+        }
+        atomic_fetch_add_explicit(&r->changes, 1, memory_order_release);
+        rc = 0;
+    }
+    reg_unlock(r);
+    return rc;
+}
+
+#define REG_STALL_SPINS 65536  /* 奇数のままこれだけ回ったら書き手の生死を確かめる */
+
+/* seq が odd のまま、書き手 (ロックの持ち主) が居なくなっていれば真 */
+static inline int reg_writer_gone(const reg_header_t *r, const _Atomic uint32_t *seq, uint32_t odd)
+{
+    int32_t owner = atomic_load_explicit((_Atomic int32_t *)&r->lock, memory_order_acquire);
+    if (owner != 0 && (kill(owner, 0) == 0 || errno != ESRCH))
+        return 0;
+    /* 書き終えてからロックを放しただけかもしれないので、まだ同じ奇数か見直す */
+    return atomic_load_explicit((_Atomic uint32_t *)seq, memory_order_acquire) == odd;
+}
+
+/* 書き手が途中で死んで読めないスロットがあれば -1 (見つからない扱い) */
+static inline int reg_lookup_slots(const reg_header_t *r, const char *name, uint64_t hash,
+                                   reg_info_t *out)
+{
+    uint64_t mask = r->slots - 1;
+    for (uint64_t i = 0; i < r->slots; i++) {
+        const reg_slot_t *s = &r->slot[(hash + i) & mask];
+        uint32_t s1, state;
+        unsigned spins = 0;
+        int match;
+        do {
+            s1 = atomic_load_explicit(&s->seq, memory_order_acquire);
+            if (s1 & 1) {
+                if (++spins % REG_STALL_SPINS == 0 && reg_writer_gone(r, &s->seq, s1))
+                    return -1;
+                cpu_relax();
+                continue;
+            }
+            state = s->state;
+            match = state != REG_EMPTY && s->hash == hash &&
+                    strncmp(s->info.name, name, REG_NAME_LEN) == 0;
+            if (match && state == REG_LIVE)
+                *out = s->info;
+            atomic_thread_fence(memory_order_acquire);
+        } while ((s1 & 1) || atomic_load_explicit(&s->seq, memory_order_relaxed) != s1);
+
+        if (state == REG_EMPTY)
+            return -1;
+        if (match)
+            return state == REG_LIVE ? 0 : -1;
+    }
+    return -1;
+}
+
+/*
+ * ロックなしで name を引く。見つかれば *out にコピーして 0。
+ * 詰め直しの途中で書き手が死んでいれば、次の書き手が直すまで -1
+ */
+static inline int reg_lookup(const reg_header_t *r, const char *name, reg_info_t *out)
+{
+    uint64_t hash = reg_hash(name);
+    _Atomic uint32_t *epoch = (_Atomic uint32_t *)&r->epoch;
+    unsigned spins = 0;
+    for (;;) {
+        uint32_t e = atomic_load_explicit(epoch, memory_order_acquire);
+        if (e & 1) {
+            if (++spins % REG_STALL_SPINS == 0 && reg_writer_gone(r, epoch, e))
+                return -1;
+            cpu_relax();
+            continue;
+        }
+        int rc = reg_lookup_slots(r, name, hash, out);
+        atomic_thread_fence(memory_order_acquire);
+        if (atomic_load_explicit(epoch, memory_order_relaxed) == e)
+            return rc;
+    }
+}
+
+/*
+ * name が世代 after_gen 以外で登録されるまで待つ (最初の登録なら 0、
+ * 置き換えなら今の世代を渡す)。timeout_sec 秒 (0 以下なら無制限) で -1
+ */
+static inline int reg_wait(const reg_header_t *r, const char *name, uint64_t after_gen,
+                           double timeout_sec, reg_info_t *out)
+{
+    double start = get_time_sec();
+    uint64_t seen = ~0ULL;
+    for (;;) {
+        /* 変更が無ければ表を引かずに changes だけ見る */
+        uint64_t c = atomic_load_explicit(&r->changes, memory_order_acquire);
+        if (c != seen) {
+            seen = c;
+            if (reg_lookup(r, name, out) == 0 && out->generation != after_gen)
+                return 0;
+        }
+        if (timeout_sec > 0 && get_time_sec() - start >= timeout_sec)
+            return -1;
+        usleep(1000);
+    }
+}
+
+/* addr のページが載っている NUMA ノード (分からなければ -1) */
+static inline int reg_node_of(const void *addr)
+{
+#ifdef SYS_move_pages
+    void *page = (void *)((uintptr_t)addr & ~(uintptr_t)4095);
+    int status = -1;
+    if (syscall(SYS_move_pages, 0, 1UL, &page, NULL, &status, 0) == 0 && status >= 0)
+        return status;
+#endif
+    (void)addr;
+    return -1;
+}
+
+/* ========== ルックアップベンチマーク ========== */
+
+#define REG_BATCH 1024
+
+typedef struct {
+    const reg_header_t *reg;
+    char names[REG_BATCH][REG_NAME_LEN];
+    uint64_t sum;
+} reg_lookup_arg_t;
+
+static inline void op_reg_lookup(void *arg)
+{
+    reg_lookup_arg_t *a = (reg_lookup_arg_t *)arg;
+    reg_info_t info;
+    uint64_t sum = 0;
+    for (int i = 0; i < REG_BATCH; i++)
+        if (reg_lookup(a->reg, a->names[i], &info) == 0)
+            sum += info.generation;
+    a->sum += sum;
+    __asm__ volatile("" :: "r"(sum) : "memory");
+}
+
+typedef struct {
+    reg_header_t *reg;
+    reg_info_t infos[REG_BATCH];
+} reg_publish_arg_t;
+
+/* 登録済みの名前を登録し直す (置き換え) */
+static inline void op_reg_publish(void *arg)
+{
+    reg_publish_arg_t *a = (reg_publish_arg_t *)arg;
+    for (int i = 0; i < REG_BATCH; i++)
+        reg_publish(a->reg, &a->infos[i]);
+}
+
+/* op を計測して1操作あたりの時間で結果を表示する */
+static inline void reg_measure(const char *label, bench_op_fn op, void *arg)
+{
+    stats_phase(label, REG_BATCH * sizeof(reg_slot_t));
+    int reps = calibrate_inner_reps(op, arg);
+    for (int w = 0; w < g_cfg.warmup; w++)
+        time_op(op, arg, reps);
+
+    sample_set_t ss;
+    samples_init(&ss);
+    while (!samples_done(&ss))
+        samples_add(&ss, time_op(op, arg, reps) / REG_BATCH);
+
+    print_summary(label, sizeof(reg_slot_t), ss.v, ss.n);
+    sample_stats_t st;
+    compute_stats(ss.v, ss.n, &st);
+    printf("  [%s] %.1f ns/op, %.2f Mop/s (中央値)\n", label, st.median * 1e9, 1e-6 / st.median);
+    samples_free(&ss);
+}
+
+/*
+ * entries 個の名前を登録した一時レジストリで、ヒットするルックアップ、
+ * ミスするルックアップ、置き換えの登録を計測する
+ */
+static inline void bench_registry(long entries)
+{
+    if (entries <= 0)
+        return;
+    char shm_name[64];
+    snprintf(shm_name, sizeof(shm_name), "/xpmem_bench_registry.bench.%d", (int)getpid());
+    shm_unlink(shm_name);
+    reg_header_t *r = reg_open(shm_name, 1, (uint64_t)entries * 2);
+    shm_unlink(shm_name);   /* 開いたマッピングだけで使う */
+    if (!r) {
+        fprintf(stderr, "計測用レジストリを作れません\n");
+        return;
+    }
+
+    printf("\n--- レジストリ ルックアップベンチマーク ---\n");
+    printf("  (%ld エントリ / %lu スロット, 時間は1操作あたり)\n\n",
+           entries, (unsigned long)r->slots);
+
+    reg_info_t info;
+    memset(&info, 0, sizeof(info));
+    long n = 0;
+    for (; n < entries; n++) {
+        snprintf(info.name, sizeof(info.name), "dataset-%06ld", n);
+        info.segid = n;
+        info.size = (uint64_t)n * 4096;
+        info.pid = (int32_t)getpid();
+        info.node = -1;
+        if (!reg_publish(r, &info))
+            break;
+    }
+    if (n < entries)
+        printf("  (表が埋まったので %ld エントリで計測)\n", n);
+
+    static reg_lookup_arg_t lk;
+    static reg_publish_arg_t pub;
+    uint64_t rng = 0x2545F4914F6CDD1DULL;
+    lk.reg = r;
+    for (int i = 0; i < REG_BATCH; i++) {
+        long k = (long)(xorshift64(&rng) % (uint64_t)n);
+        snprintf(lk.names[i], REG_NAME_LEN, "dataset-%06ld", k);
+        pub.infos[i] = info;
+        snprintf(pub.infos[i].name, REG_NAME_LEN, "dataset-%06ld", k);
+    }
+    reg_measure("REG-lookup-hit", op_reg_lookup, &lk);
+
+    for (int i = 0; i < REG_BATCH; i++)
+        snprintf(lk.names[i], REG_NAME_LEN, "missing-%06d", i);
+    reg_measure("REG-lookup-miss", op_reg_lookup, &lk);
+
+    pub.reg = r;
+    reg_measure("REG-replace", op_reg_publish, &pub);
+
+    reg_close(r);
+}
+
+#endif /* SEG_REGISTRY_H */
@@ -0,0 +1,128 @@
+/*
+ * seg_soak.h - 長時間ソーク (xpmem_importer BENCH_SOAK) の相手側の制御
+ *
+ * copy / dir はインポータだけで回るが、ピンポンとリング転送には
+ * エクスポータ側の相手が要る。制御ブロックをアリーナに置き "soakctl"
+ * として公開し、インポータが mode を設定するとエクスポータの
+ * サービススレッドが soak_serve() に入り、mode が IDLE に戻るまで応答する。
+ *   SOAK_PINGPONG  ping に書かれた値を pong に返す (キャッシュライン1本の往復)
+ *   SOAK_RING      データ領域先頭の slots × chunk をリングとして、
+ *                  チャンク g を書いて full を進め、インポータが読んで empty を
+ *                  進めたスロットを再利用する (shm_bench のチャンクリングと同じ手順)
+ * チャンクの中身は8バイトごとに通し番号 g。インポータは先頭と末尾を確かめる。
+ */
+
+#ifndef SEG_SOAK_H
+#define SEG_SOAK_H
+
+#include <stdint.h>
+#include <string.h>
+#include <stdatomic.h>
+#include "common.h"
+#include "seg_arena.h"
+
+#define SOAK_MAX_SLOTS 64
+
+enum { SOAK_IDLE = 0, SOAK_PINGPONG, SOAK_RING };
+
+typedef struct {
+    _Alignas(64) _Atomic uint64_t v;
+} soak_line_t;
+
+typedef struct {
+    _Atomic uint32_t mode;      /* インポータが設定する SOAK_* */
+    _Atomic uint32_t serving;   /* エクスポータが soak_serve() 中なら 1 */
+    uint32_t slots;             /* リングのスロット数 */
+    uint32_t pad;
+    uint64_t chunk;             /* リングのチャンクサイズ (bytes) */
+    soak_line_t ping, pong;
+    soak_line_t full[SOAK_MAX_SLOTS];   /* 書き終えたチャンク番号 + 1 */
+    soak_line_t empty[SOAK_MAX_SLOTS];  /* 読み終えたチャンク番号 + 1 */
+} soak_ctl_t;
+
+/* エクスポータ側: 制御ブロックを確保して公開する。失敗時 NULL */
+static inline soak_ctl_t *soak_ctl_create(arena_header_t *a)
+{
+    arena_handle_t h = arena_alloc(a, sizeof(soak_ctl_t));
+    if (!h)
+        return NULL;
+    soak_ctl_t *c = (soak_ctl_t *)arena_ptr(a, h);
+    memset(c, 0, sizeof(*c));
+    arena_publish(a, "soakctl", h);
+    return c;
+}
+
+/* エクスポータ側: リングの書き手。mode が変わったら戻る */
+static inline void soak_serve_ring(soak_ctl_t *c, void *data, uint32_t mode)
+{
+    uint32_t slots = c->slots;
+    size_t chunk = c->chunk;
+    int spins = 0;
+    for (uint64_t g = 0; atomic_load_explicit(&c->mode, memory_order_relaxed) == mode; g++) {
+        uint32_t s = (uint32_t)(g % slots);
+        /* スロットが前の周回で読み終えられるまで待つ */
+        while (g >= slots &&
+               atomic_load_explicit(&c->empty[s].v, memory_order_acquire) < g - slots + 1) {
+            if (atomic_load_explicit(&c->mode, memory_order_relaxed) != mode)
+                return;
+            spin_backoff(&spins);
+        }
+        spins = 0;
+        uint64_t *p = (uint64_t *)((char *)data + (size_t)s * chunk);
+        for (size_t i = 0; i < chunk / sizeof(uint64_t); i++)
+            p[i] = g;
+        atomic_store_explicit(&c->full[s].v, g + 1, memory_order_release);
+    }
+}
+
+/*
+ * エクスポータ側: mode が IDLE に戻るまで相手役を務める。
+ * data はデータ領域の先頭 (リングに使う)
+ */
+static inline void soak_serve(soak_ctl_t *c, void *data)
+{
+    atomic_store(&c->serving, 1);
+    uint32_t mode = atomic_load(&c->mode);
+
+    if (mode == SOAK_PINGPONG) {
+        uint64_t last = atomic_load_explicit(&c->pong.v, memory_order_relaxed);
+        int spins = 0;
+        while (atomic_load_explicit(&c->mode, memory_order_relaxed) == mode) {
+            uint64_t v = atomic_load_explicit(&c->ping.v, memory_order_acquire);
+            if (v != last) {
+                atomic_store_explicit(&c->pong.v, v, memory_order_release);
+                last = v;
+                spins = 0;
+                continue;
+            }
+            spin_backoff(&spins);
+        }
+    } else if (mode == SOAK_RING) {
+        soak_serve_ring(c, data, mode);
+    }
+    atomic_store(&c->serving, 0);
+}
+
+/*
+ * インポータ側: 相手役を止め、リングの状態を初期化してから mode で再開させる
+ * (SOAK_IDLE なら止めるだけ)
+ */
+static inline void soak_set(soak_ctl_t *c, uint32_t mode, uint32_t slots, size_t chunk)
+{
+    atomic_store(&c->mode, SOAK_IDLE);
+    while (atomic_load(&c->serving))
+        sched_yield();
+    if (mode == SOAK_IDLE)
+        return;
+    c->slots = slots;
+    c->chunk = chunk;
+    atomic_store(&c->ping.v, 0);
+    atomic_store(&c->pong.v, 0);
+    for (int i = 0; i < SOAK_MAX_SLOTS; i++) {
+        atomic_store(&c->full[i].v, 0);
+        atomic_store(&c->empty[i].v, 0);
+    }
+    atomic_store(&c->mode, mode);
+}
+
+#endif /* SEG_SOAK_H */
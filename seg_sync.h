@@ -0,0 +1,271 @@
+/*
+ * seg_sync.h - エクスポート領域の差分同期 (ページバージョン表)
+ *
+ * エクスポータはデータ領域のページごとに uint32_t のバージョンを持ち、
+ * ページを書き換えるたびにバージョンを進める (協調型のダーティ追跡)。
+ * インポータは前回の同期で見たバージョンを覚えておき、変わったページ
+ * だけをコピーすれば自分の複製を最新にできる。
+ *
+ * 制御ブロックとバージョン表はアリーナに置き "syncctl" として公開する。
+ * ベンチマークではインポータが req を進めて「permille‰ のページを
+ * 書き換えて」と依頼し、エクスポータのサービススレッドが書き換えて
+ * done を req に揃える。同期中にエクスポータは書き込まない。
+ *
+ * 後半はエクスポータが書き続けている最中に一貫したスナップショットを
+ * 取るための seqlock ("seqctl")。領域ごとにシーケンス番号を持ち、
+ * 書き込み中は奇数になる。読み手はコピーの前後で番号が同じ偶数なら
+ * 採用し、違えば読み直す。
+ */
+
+#ifndef SEG_SYNC_H
+#define SEG_SYNC_H
+
+#include <stdint.h>
+#include <string.h>
+#include <stdatomic.h>
+#include "common.h"
+#include "seg_arena.h"
+
+#define SYNC_PAGE_SIZE 4096UL
+
+typedef struct {
+    _Atomic uint64_t req;       /* インポータが進める依頼番号 */
+    _Atomic uint64_t done;      /* エクスポータが処理済みの依頼番号 */
+    _Atomic uint32_t stop;      /* サービススレッドの終了指示 */
+    uint32_t permille;          /* 書き換えるページの割合 (‰) */
+    uint64_t size;              /* 書き換える範囲 (データ領域先頭から) */
+    uint64_t npages;            /* バージョン表の要素数 */
+    uint64_t dirtied;           /* 直前の依頼で書き換えたページ数 */
+    arena_handle_t versions;    /* _Atomic uint32_t[npages] */
+} sync_ctl_t;
+
+static inline _Atomic uint32_t *sync_versions(const void *arena, const sync_ctl_t *c)
+{
+    return (_Atomic uint32_t *)arena_ptr(arena, c->versions);
+}
+
+/* エクスポータ側: data_size 分のバージョン表を確保して公開する。失敗時 NULL */
+static inline sync_ctl_t *sync_ctl_create(arena_header_t *a, size_t data_size)
+{
+    uint64_t npages = data_size / SYNC_PAGE_SIZE;
+    arena_handle_t hc = arena_alloc(a, sizeof(sync_ctl_t));
+    arena_handle_t hv = arena_alloc(a, npages * sizeof(uint32_t));
+    if (!hc || !hv)
+        return NULL;
+
+    sync_ctl_t *c = (sync_ctl_t *)arena_ptr(a, hc);
+    memset(c, 0, sizeof(*c));
+    memset(arena_ptr(a, hv), 0, npages * sizeof(uint32_t));
+    c->npages = npages;
+    c->versions = hv;
+    arena_publish(a, "syncctl", hc);
+    return c;
+}
+
+/*
+ * エクスポータ側: 未処理の依頼があれば [0, size) のうち permille‰ の
+ * ページ (最低1ページ) を書き換えてバージョンを進める。処理したら 1
+ */
+static inline int sync_service_step(const void *arena, sync_ctl_t *c, void *data,
+                                    uint64_t *rng)
+{
+    uint64_t req = atomic_load_explicit(&c->req, memory_order_acquire);
+    if (req == atomic_load_explicit(&c->done, memory_order_relaxed))
+        return 0;
+
+    _Atomic uint32_t *ver = sync_versions(arena, c);
+    uint64_t pages = c->size / SYNC_PAGE_SIZE;
+    if (pages > c->npages)
+        pages = c->npages;
+    uint64_t count = 0;
+    if (c->permille > 0 && pages > 0) {
+        count = pages * c->permille / 1000;
+        if (count == 0)
+            count = 1;
+    }
+
+    for (uint64_t i = 0; i < count; i++) {
+        uint64_t p = xorshift64(rng) % pages;
+        uint32_t v = atomic_load_explicit(&ver[p], memory_order_relaxed) + 1;
+        memset((char *)data + p * SYNC_PAGE_SIZE, (int)(v + p), SYNC_PAGE_SIZE);
+        atomic_store_explicit(&ver[p], v, memory_order_release);
+    }
+    c->dirtied = count;
+    atomic_store_explicit(&c->done, req, memory_order_release);
+    return 1;
+}
+
+/* インポータ側: 書き換えを依頼して完了を待つ */
+static inline void sync_request(sync_ctl_t *c, uint32_t permille, size_t size)
+{
+    c->permille = permille;
+    c->size = size;
+    uint64_t req = atomic_load_explicit(&c->req, memory_order_relaxed) + 1;
+    atomic_store_explicit(&c->req, req, memory_order_release);
+    while (atomic_load_explicit(&c->done, memory_order_acquire) != req)
+        sched_yield();
+}
+
+/* インポータ側: 現在のバージョンを seen に写す (全体コピーの直後に呼ぶ) */
+static inline void sync_snapshot(const void *arena, const sync_ctl_t *c,
+                                 uint32_t *seen, size_t size)
+{
+    _Atomic uint32_t *ver = sync_versions(arena, c);
+    for (uint64_t p = 0; p < size / SYNC_PAGE_SIZE; p++)
+        seen[p] = atomic_load_explicit(&ver[p], memory_order_acquire);
+}
+
+/*
+ * インポータ側: seen と違うページだけ remote → local へコピーする。
+ * コピーしたバイト数を返す
+ */
+static inline size_t sync_pull(const void *arena, const sync_ctl_t *c, uint32_t *seen,
+                               void *local, const void *remote, size_t size)
+{
+    _Atomic uint32_t *ver = sync_versions(arena, c);
+    size_t moved = 0;
+    for (uint64_t p = 0; p < size / SYNC_PAGE_SIZE; p++) {
+        uint32_t v = atomic_load_explicit(&ver[p], memory_order_acquire);
+        if (v == seen[p])
+            continue;
+        memcpy((char *)local + p * SYNC_PAGE_SIZE,
+               (const char *)remote + p * SYNC_PAGE_SIZE, SYNC_PAGE_SIZE);
+        seen[p] = v;
+        moved += SYNC_PAGE_SIZE;
+    }
+    return moved;
+}
+
+/* ========== seqlock スナップショット ========== */
+
+#define SEQ_MIN_REGION SYNC_PAGE_SIZE
+
+typedef struct {
+    _Atomic int64_t rate;       /* ライタの書き込み回数/秒 (0: 停止, -1: 無制限) */
+    _Atomic uint32_t writing;   /* ライタが書き込み中なら 1 */
+    uint32_t pad;
+    uint64_t size;              /* 書き換える範囲 (データ領域先頭から) */
+    uint64_t region;            /* 1領域のバイト数 (SEQ_MIN_REGION の倍数) */
+    uint64_t nseq;              /* シーケンス番号の要素数 (最大領域数) */
+    _Atomic uint64_t writes;    /* 書き込んだ領域の累計 (統計) */
+    arena_handle_t seqs;        /* _Atomic uint32_t[nseq] */
+} seq_ctl_t;
+
+static inline _Atomic uint32_t *seq_counters(const void *arena, const seq_ctl_t *c)
+{
+    return (_Atomic uint32_t *)arena_ptr(arena, c->seqs);
+}
+
+/* 領域の中身: 8バイトごとに (領域番号 << 32 | シーケンス番号) */
+static inline uint64_t seq_tag(uint64_t region_idx, uint32_t seq)
+{
+    return (region_idx << 32) | seq;
+}
+
+/* エクスポータ側: data_size 分のシーケンス番号を確保して公開する。失敗時 NULL */
+static inline seq_ctl_t *seq_ctl_create(arena_header_t *a, size_t data_size)
+{
+    uint64_t nseq = data_size / SEQ_MIN_REGION;
+    arena_handle_t hc = arena_alloc(a, sizeof(seq_ctl_t));
+    arena_handle_t hs = arena_alloc(a, nseq * sizeof(uint32_t));
+    if (!hc || !hs)
+        return NULL;
+
+    seq_ctl_t *c = (seq_ctl_t *)arena_ptr(a, hc);
+    memset(c, 0, sizeof(*c));
+    memset(arena_ptr(a, hs), 0, nseq * sizeof(uint32_t));
+    c->nseq = nseq;
+    c->seqs = hs;
+    arena_publish(a, "seqctl", hc);
+    return c;
+}
+
+/*
+ * エクスポータ側: 書き込みが有効なら領域 *next を1つ書き換えて 1 を返す。
+ * writing と rate は seq_cst で読み書きし、seq_writer_set() が停止を
+ * 確認した後に書き込みが始まらないようにする
+ */
+static inline int seq_writer_step(const void *arena, seq_ctl_t *c, void *data,
+                                  uint64_t *next)
+{
+    atomic_store(&c->writing, 1);
+    if (atomic_load(&c->rate) == 0) {
+        atomic_store(&c->writing, 0);
+        return 0;
+    }
+
+    uint64_t nregions = c->size / c->region;
+    if (nregions == 0 || nregions > c->nseq) {
+        atomic_store(&c->writing, 0);
+        return 0;
+    }
+    uint64_t idx = *next % nregions;
+    *next = idx + 1;
+
+    _Atomic uint32_t *seq = &seq_counters(arena, c)[idx];
+    uint32_t s = atomic_load_explicit(seq, memory_order_relaxed);
+    atomic_store_explicit(seq, s + 1, memory_order_relaxed);   /* 奇数: 書き込み中 */
+    atomic_thread_fence(memory_order_release);
+
+    uint64_t tag = seq_tag(idx, s + 2);
+    uint64_t *p = (uint64_t *)((char *)data + idx * c->region);
+    for (size_t i = 0; i < c->region / sizeof(uint64_t); i++)
+        p[i] = tag;
+
+    atomic_store_explicit(seq, s + 2, memory_order_release);
+    atomic_fetch_add_explicit(&c->writes, 1, memory_order_relaxed);
+    atomic_store(&c->writing, 0);
+    return 1;
+}
+
+/*
+ * インポータ側: ライタを止めてから範囲・粒度を変え、rate で再開させる。
+ * 粒度が変わると番号と領域の対応が崩れるので、その場合は番号を 0 に戻す
+ */
+static inline void seq_writer_set(const void *arena, seq_ctl_t *c, size_t size,
+                                  size_t region, int64_t rate)
+{
+    atomic_store(&c->rate, 0);
+    while (atomic_load(&c->writing))
+        sched_yield();
+    if (c->size != size || c->region != region) {
+        _Atomic uint32_t *seq = seq_counters(arena, c);
+        for (uint64_t i = 0; i < c->nseq; i++)
+            atomic_store_explicit(&seq[i], 0, memory_order_relaxed);
+        c->size = size;
+        c->region = region;
+    }
+    atomic_store(&c->rate, rate);
+}
+
+/*
+ * インポータ側: 領域 idx を local にコピーする。書き込み中だった、または
+ * コピー中に書き換わったために読み直した回数を返す。*seq_out は採用した番号
+ */
+static inline uint64_t seq_read_region(const void *arena, const seq_ctl_t *c,
+                                       uint64_t idx, size_t region,
+                                       void *local, const void *remote,
+                                       uint32_t *seq_out)
+{
+    _Atomic uint32_t *seq = &seq_counters(arena, c)[idx];
+    uint64_t retries = 0;
+    for (;;) {
+        uint32_t s1 = atomic_load_explicit(seq, memory_order_acquire);
+        if (s1 & 1) {
+            /* 書き込み中: 終わるまで待ってから読み直す */
+            while (atomic_load_explicit(seq, memory_order_acquire) == s1)
+                cpu_relax();
+            retries++;
+            continue;
+        }
+        memcpy(local, remote, region);
+        atomic_thread_fence(memory_order_acquire);
+        if (atomic_load_explicit(seq, memory_order_relaxed) == s1) {
+            *seq_out = s1;
+            return retries;
+        }
+        retries++;
+    }
+}
+
+#endif /* SEG_SYNC_H */
@@ -6,30 +6,401 @@
  *
  * fork()で子プロセスを作り、親が書き込み → 子が読み取りの
  * パターンでベンチマークを行う。
+ * 続いて親が別の共有メモリに構築したハッシュテーブルを、子が自分で
+ * マッピングし直して (別アドレスで) 直接引く場合とコピーする場合を比べる。
+ * 制御ブロック上のキャッシュライン1本を往復させるピンポンの往復時間も測る。
+ * 最後に、親がデータを生成しながら子がコピーするパイプライン転送
+ * (N スロットのチャンクリング) を、全体を書いてから全体をコピーする
+ * 直列の場合と端から端までの時間で比べる。
+ *
+ * 使い方:
+ *   ./shm_bench [最大テストサイズ(MB)]
  *
  * コンパイル:
  *   gcc -O2 -o shm_bench shm_bench.c -lrt -lpthread
  */
 
 #include "common.h"
+#include "perf_counters.h"
+#include "shm_containers.h"
+#include "table_bench.h"
 #include <sys/wait.h>
+#include <stdatomic.h>
+
+/* 子プロセスへの指示 */
+enum {
+    CMD_COPY = 0,           /* data_size バイトをコピーして計測 */
+    CMD_TABLE,              /* 共有テーブルのルックアップベンチマーク */
+    CMD_RING,               /* run_stop まで、チャンクリングから受け取り続ける */
+    CMD_PINGPONG,           /* run_stop まで、pp_ping に pp_pong で応え続ける */
+};
+
+/*
+ * パイプライン転送のスロット状態。データ共有メモリの先頭 slots × chunk を
+ * リングとして使い、チャンクには実行をまたいだ通し番号 G を振る。
+ * スロット G % slots について、親はチャンク G を書いたら full = G + 1、
+ * 子はコピーし終えたら empty = G + 1 にする。偽共有を避けて1行ずつ置く
+ * (ピンポンの pp_ping / pp_pong も同じ形)
+ */
+#define RING_MAX_SLOTS 64
+
+typedef struct {
+    _Atomic uint64_t seq;
+    char pad[64 - sizeof(uint64_t)];
+} line_flag_t;
 
 /* 共有メモリ上の制御構造体 */
 typedef struct {
     volatile int phase;     /* 0: 待機, 1: データ準備完了, 2: コピー完了 */
+    volatile int command;   /* CMD_* */
     size_t data_size;
     int iteration;
-    double copy_time;       /* 子プロセスが計測した時間 */
+    double copy_time;       /* 子プロセスが計測した時間 (1操作あたり) */
+    int inner_reps;         /* 子プロセスが校正した内側ループ回数 */
     size_t verify_err;      /* 検証結果 */
+    perf_sample_t perf;     /* 子プロセスが計測したカウンタ値 */
+
+    /* CMD_RING */
+    size_t ring_total;              /* 1回の転送のバイト数 */
+    size_t ring_chunk;
+    int ring_slots;
+    _Atomic int run_stop;           /* CMD_RING / CMD_PINGPONG の終了指示 */
+    _Atomic uint64_t ring_done;     /* 子が受け取り終えた転送の回数 */
+    line_flag_t full[RING_MAX_SLOTS];
+    line_flag_t empty[RING_MAX_SLOTS];
+
+    /* CMD_PINGPONG: 親が pp_ping に書いた番号を子が pp_pong に返す */
+    line_flag_t pp_ping;
+    line_flag_t pp_pong;
 } shm_control_t;
 
 #define CTRL_SHM_NAME "/xpmem_bench_ctrl"
+#define TBL_SHM_NAME  "/xpmem_bench_tbl"
 
-int main(int argc, char *argv[])
+/*
+ * 親プロセスがパターンを書き込み、子プロセスにコピーさせて
+ * 子が計測した1操作あたりの時間を返す
+ */
+static double run_child_copy(shm_control_t *ctrl, void *shm_ptr,
+                             size_t size, int iteration)
+{
+    /* データを共有メモリに書き込む */
+    fill_pattern(shm_ptr, size);
+
+    ctrl->data_size = size;
+    ctrl->iteration = iteration;
+    ctrl->phase = 1; /* 子に通知 */
+
+    /* 子プロセスのコピー完了を待つ */
+    while (ctrl->phase != 2) {
+        usleep(100);
+    }
+
+    ctrl->phase = 0;
+    return ctrl->copy_time;
+}
+
+/* 子プロセスにコピー以外の指示を出し、完了を待つ */
+static void run_child_command(shm_control_t *ctrl, int command)
+{
+    fflush(stdout);
+    ctrl->command = command;
+    ctrl->phase = 1;
+    while (ctrl->phase != 2) {
+        usleep(100);
+    }
+    ctrl->command = CMD_COPY;
+    ctrl->phase = 0;
+}
+
+/* ========== ピンポン (制御ブロックのキャッシュライン往復) ========== */
+
+typedef struct {
+    shm_control_t *ctrl;
+    uint64_t seq;
+} pp_op_arg_t;
+
+/* 1操作 (親): 番号を送って子が返すまで (1往復) */
+static void op_pingpong(void *arg)
+{
+    pp_op_arg_t *a = (pp_op_arg_t *)arg;
+    uint64_t n = ++a->seq;
+    int spins = 0;
+    atomic_store_explicit(&a->ctrl->pp_ping.seq, n, memory_order_release);
+    while (atomic_load_explicit(&a->ctrl->pp_pong.seq, memory_order_acquire) != n)
+        spin_backoff(&spins);
+}
+
+/* 子: run_stop が立つまで pp_ping の番号を pp_pong にそのまま返す */
+static void child_pingpong(shm_control_t *c)
+{
+    uint64_t last = atomic_load_explicit(&c->pp_pong.seq, memory_order_relaxed);
+    int spins = 0;
+    for (;;) {
+        uint64_t n = atomic_load_explicit(&c->pp_ping.seq, memory_order_acquire);
+        if (n != last) {
+            atomic_store_explicit(&c->pp_pong.seq, n, memory_order_release);
+            last = n;
+            spins = 0;
+            continue;
+        }
+        if (atomic_load_explicit(&c->run_stop, memory_order_relaxed))
+            return;
+        spin_backoff(&spins);
+    }
+}
+
+/* 親: 往復時間を計測する (サイズはキャッシュライン1本として表示) */
+static void bench_pingpong(shm_control_t *ctrl)
+{
+    atomic_store(&ctrl->run_stop, 0);
+    atomic_store(&ctrl->pp_ping.seq, 0);
+    atomic_store(&ctrl->pp_pong.seq, 0);
+
+    fflush(stdout);
+    ctrl->command = CMD_PINGPONG;
+    ctrl->phase = 1;
+
+    pp_op_arg_t arg = { ctrl, 0 };
+    size_t size = sizeof(line_flag_t);
+    stats_phase("SHM-pp", size);
+    int reps = calibrate_inner_reps(op_pingpong, &arg);
+    printf("  内側ループ: %d 回/サンプル\n", reps);
+    for (int w = 0; w < g_cfg.warmup; w++)
+        time_op(op_pingpong, &arg, reps);
+
+    sample_set_t ss;
+    samples_init(&ss);
+    for (int r = 0; !samples_done(&ss); r++) {
+        double t = time_op(op_pingpong, &arg, reps);
+        samples_add(&ss, t);
+        if (r < REPEAT_COUNT)
+            print_result("SHM-pp", size, t, r + 1);
+    }
+    print_summary("SHM-pp", size, ss.v, ss.n);
+    samples_free(&ss);
+
+    atomic_store(&ctrl->run_stop, 1);
+    while (ctrl->phase != 2) {
+        usleep(100);
+    }
+    ctrl->command = CMD_COPY;
+    ctrl->phase = 0;
+}
+
+/* ========== パイプライン転送 (チャンクリング) ========== */
+
+#define MAX_RING_PARAMS 16
+
+typedef struct {
+    shm_control_t *ctrl;
+    char *ring;             /* データ共有メモリの先頭 */
+    size_t total;
+    size_t chunk;
+    int slots;
+    uint64_t next;          /* 次に書くチャンクの通し番号 */
+    uint64_t runs;          /* 開始した転送の回数 */
+} ring_op_arg_t;
+
+/*
+ * 1操作 (親): total バイトをチャンクごとに生成してスロットへ書き、
+ * 子が全体を受け取り終えるまで。スロットが空くまではスピンで待つ
+ */
+static void op_ring_transfer(void *arg)
+{
+    ring_op_arg_t *a = (ring_op_arg_t *)arg;
+    shm_control_t *c = a->ctrl;
+    size_t nchunks = a->total / a->chunk;
+
+    for (size_t k = 0; k < nchunks; k++) {
+        uint64_t g = a->next++;
+        int s = (int)(g % (uint64_t)a->slots);
+        if (g >= (uint64_t)a->slots) {
+            uint64_t want = g - (uint64_t)a->slots + 1;
+            int spins = 0;
+            while (atomic_load_explicit(&c->empty[s].seq, memory_order_acquire) != want)
+                spin_backoff(&spins);
+        }
+        /* チャンクは 256 の倍数なので、通しのパターンと同じ内容になる */
+        fill_pattern(a->ring + (size_t)s * a->chunk, a->chunk);
+        atomic_store_explicit(&c->full[s].seq, g + 1, memory_order_release);
+    }
+
+    a->runs++;
+    int spins = 0;
+    while (atomic_load_explicit(&c->ring_done, memory_order_acquire) != a->runs)
+        spin_backoff(&spins);
+}
+
+/*
+ * 子: run_stop が立つまでチャンクを受け取ってローカルバッファの該当位置へ
+ * コピーし続ける。最初の転送の後で全体を検証する
+ */
+static void child_ring_consume(shm_control_t *c, const char *ring, char *local_buf)
+{
+    size_t total = c->ring_total, chunk = c->ring_chunk;
+    uint64_t slots = (uint64_t)c->ring_slots;
+    size_t nchunks = total / chunk;
+    uint64_t g = 0, runs = 0;
+
+    memset(local_buf, 0, total);
+    for (;;) {
+        for (size_t k = 0; k < nchunks; k++, g++) {
+            int s = (int)(g % slots), spins = 0;
+            while (atomic_load_explicit(&c->full[s].seq, memory_order_acquire) != g + 1) {
+                if (atomic_load_explicit(&c->run_stop, memory_order_relaxed))
+                    return;
+                spin_backoff(&spins);
+            }
+            memcpy(local_buf + k * chunk, ring + (size_t)s * chunk, chunk);
+            atomic_store_explicit(&c->empty[s].seq, g + 1, memory_order_release);
+        }
+        if (++runs == 1)
+            c->verify_err = verify_pattern(local_buf, total);
+        atomic_store_explicit(&c->ring_done, runs, memory_order_release);
+    }
+}
+
+/*
+ * 親: 1構成 (チャンクサイズ × スロット数) を計測して中央値を返す。
+ * 子は計測の間ずっと CMD_RING を実行している
+ */
+static double bench_ring(shm_control_t *ctrl, void *shm_ptr, const char *method,
+                         size_t total, size_t chunk, int slots)
+{
+    ctrl->ring_total = total;
+    ctrl->ring_chunk = chunk;
+    ctrl->ring_slots = slots;
+    ctrl->verify_err = 0;
+    atomic_store(&ctrl->run_stop, 0);
+    atomic_store(&ctrl->ring_done, 0);
+    for (int s = 0; s < RING_MAX_SLOTS; s++) {
+        atomic_store(&ctrl->full[s].seq, 0);
+        atomic_store(&ctrl->empty[s].seq, 0);
+    }
+
+    fflush(stdout);
+    ctrl->command = CMD_RING;
+    ctrl->phase = 1;
+
+    ring_op_arg_t arg = { ctrl, (char *)shm_ptr, total, chunk, slots, 0, 0 };
+    stats_phase(method, total);
+    op_ring_transfer(&arg);
+    if (ctrl->verify_err)
+        fprintf(stderr, "  *** データ不整合! (%s) offset=%zu ***\n", method,
+                ctrl->verify_err - 1);
+    else
+        printf("  ✓ データ検証OK\n");
+
+    int reps = calibrate_inner_reps(op_ring_transfer, &arg);
+    printf("  内側ループ: %d 回/サンプル\n", reps);
+    for (int w = 0; w < g_cfg.warmup; w++)
+        time_op(op_ring_transfer, &arg, reps);
+
+    sample_set_t ss;
+    samples_init(&ss);
+    for (int r = 0; !samples_done(&ss); r++) {
+        double t = time_op(op_ring_transfer, &arg, reps);
+        samples_add(&ss, t);
+        if (r < REPEAT_COUNT)
+            print_result(method, total, t, r + 1);
+    }
+    print_summary(method, total, ss.v, ss.n);
+    sample_stats_t st;
+    compute_stats(ss.v, ss.n, &st);
+    samples_free(&ss);
+
+    atomic_store(&ctrl->run_stop, 1);
+    while (ctrl->phase != 2) {
+        usleep(100);
+    }
+    ctrl->command = CMD_COPY;
+    ctrl->phase = 0;
+    return st.median;
+}
+
+/* 親: 直列 (1スロット × 全体) と、チャンクサイズ × スロット数のスイープ */
+static void bench_ring_sweep(shm_control_t *ctrl, void *shm_ptr, size_t max_size)
+{
+    size_t total = (size_t)env_long("BENCH_RING_MB", DEFAULT_RING_MB) * 1024UL * 1024;
+    if (total > max_size)
+        total = max_size;
+
+    long chunks_kb[MAX_RING_PARAMS], slots[MAX_RING_PARAMS];
+    int nchunks = env_long_list("BENCH_RING_CHUNKS", DEFAULT_RING_CHUNKS,
+                                chunks_kb, MAX_RING_PARAMS);
+    int nslots = env_long_list("BENCH_RING_SLOTS", DEFAULT_RING_SLOTS,
+                               slots, MAX_RING_PARAMS);
+
+    /* 直列: 親が全体を書き終えてから子が全体をコピーする */
+    double base = bench_ring(ctrl, shm_ptr, "SHM-ring-ser", total, total, 1);
+    printf("\n");
+
+    char method[64], sizebuf[64];
+    for (int ci = 0; ci < nchunks; ci++) {
+        size_t chunk = (size_t)chunks_kb[ci] * 1024;
+        if (chunks_kb[ci] <= 0 || chunk >= total)
+            continue;
+        for (int si = 0; si < nslots; si++) {
+            if (slots[si] < 2 || slots[si] > RING_MAX_SLOTS ||
+                chunk * (size_t)slots[si] > max_size)
+                continue;
+            /* 端数のチャンクは扱わない */
+            size_t len = total / chunk * chunk;
+            snprintf(method, sizeof(method), "SHM-ring-c%zuK-s%ld",
+                     chunk / 1024, slots[si]);
+            printf("  チャンク %s × %ld スロット\n",
+                   format_size(chunk, sizebuf, sizeof(sizebuf)), slots[si]);
+            double t = bench_ring(ctrl, shm_ptr, method, len, chunk, (int)slots[si]);
+            if (base > 0 && t > 0)
+                printf("  [%s] 直列比 x%.2f (スループット)\n",
+                       method, ((double)len / t) / ((double)total / base));
+            printf("\n");
+        }
+    }
+}
+
+/* 親: テーブルを共有メモリに構築する。サイズを返す (失敗時 0) */
+static size_t build_shared_table(long entries)
+{
+    size_t bytes = shm_table_bytes(entries);
+    shm_unlink(TBL_SHM_NAME);
+    int fd = shm_open(TBL_SHM_NAME, O_CREAT | O_RDWR, 0666);
+    if (fd < 0) { perror("shm_open table"); return 0; }
+    if (ftruncate(fd, bytes) == -1) {
+        perror("ftruncate table");
+        close(fd);
+        return 0;
+    }
+    void *p = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED) { perror("mmap table"); return 0; }
+    shm_table_build(p, entries, 1);
+    munmap(p, bytes);
+    return bytes;
+}
+
+/* 子: テーブルを読み取り専用で別アドレスにマッピングしてベンチマーク */
+static void child_table_bench(void)
 {
-    (void)argc; (void)argv;
+    int fd = shm_open(TBL_SHM_NAME, O_RDONLY, 0);
+    if (fd < 0) { perror("shm_open table"); return; }
+    struct stat st;
+    fstat(fd, &st);
+    void *p = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED) { perror("mmap table"); return; }
+    bench_table_lookup("SHM", (const shm_table_t *)p);
+    munmap(p, st.st_size);
+    fflush(stdout);
+}
 
+int main(int argc, char *argv[])
+{
     size_t max_size = TEST_SIZES[NUM_TEST_SIZES - 1];
+    if (argc > 1) {
+        max_size = (size_t)atol(argv[1]) * 1024UL * 1024;
+    }
     char sizebuf[64];
 
     printf("=== POSIX共有メモリ (shm) ベンチマーク ===\n");
@@ -72,30 +443,66 @@ int main(int argc, char *argv[])
     /* ページフォルト解消 */
     memset(shm_ptr, 0, max_size);
 
+    /* 子プロセスにも引き継がれる (共有統計ページも親子で共有する) */
+    char timerbuf[128];
+    bench_config_load();
+    timer_calibrate();
+    stats_open("shm_bench");
+    printf("タイマー: %s\n", timer_describe(timerbuf, sizeof(timerbuf)));
+    print_config();
+    fflush(stdout);  /* 未出力のバッファを子プロセスに複製しない */
+
     pid_t pid = fork();
 
     if (pid == 0) {
         /* ===== 子プロセス (読み取り側) ===== */
+        pin_from_env(ENV_IMPORTER_CPU);
+
         void *local_buf = alloc_aligned(max_size);
         if (!local_buf) { _exit(1); }
         memset(local_buf, 0, max_size);
 
+        perf_group_t perf;
+        perf_group_open(&perf);
+        int reps = 1;
+
         while (1) {
             /* データ準備完了を待つ */
             while (ctrl->phase != 1) {
                 usleep(100);
             }
 
+            if (ctrl->command == CMD_TABLE) {
+                child_table_bench();
+                ctrl->phase = 2;
+                continue;
+            }
+            if (ctrl->command == CMD_PINGPONG) {
+                child_pingpong(ctrl);
+                ctrl->phase = 2;
+                continue;
+            }
+            if (ctrl->command == CMD_RING) {
+                child_ring_consume(ctrl, shm_ptr, local_buf);
+                ctrl->phase = 2;
+                continue;
+            }
+
             size_t size = ctrl->data_size;
             if (size == 0) break; /* 終了シグナル */
 
             /* 共有メモリからローカルへコピー (計測) */
-            memset(local_buf, 0, size);
-            double t0 = get_time_sec();
-            memcpy(local_buf, shm_ptr, size);
-            double t1 = get_time_sec();
+            mem_op_arg_t op = { local_buf, shm_ptr, size, 0 };
+            if (ctrl->iteration == 0) {
+                stats_phase("SHM-cpy", size);
+                reps = calibrate_inner_reps(op_memcpy, &op);
+            }
 
-            ctrl->copy_time = t1 - t0;
+            memset(local_buf, 0, size);
+            perf_group_start(&perf);
+            ctrl->copy_time = time_op(op_memcpy, &op, reps);
+            perf_group_stop(&perf, &ctrl->perf);
+            ctrl->inner_reps = reps;
 
             /* 検証 */
             ctrl->verify_err = verify_pattern(local_buf, size);
@@ -104,11 +511,19 @@ int main(int argc, char *argv[])
             ctrl->phase = 2;
         }
 
+        perf_group_close(&perf);
         free(local_buf);
         _exit(0);
 
     } else {
         /* ===== 親プロセス (書き込み側) ===== */
+        pin_from_env(ENV_EXPORTER_CPU);
+
+        /* 子プロセスと同じ権限なので、ここで開けるかどうかで判定できる */
+        perf_group_t probe;
+        perf_group_open(&probe);
+        printf("perfカウンタ: %s\n\n", perf_group_mode(&probe));
+        perf_group_close(&probe);
 
         printf("--- POSIX shm memcpy ベンチマーク ---\n");
         printf("  (共有メモリ → 別プロセスのローカルバッファへ memcpy)\n\n");
@@ -117,23 +532,24 @@ int main(int argc, char *argv[])
             size_t size = TEST_SIZES[si];
             if (size > max_size) break;
 
-            double times[REPEAT_COUNT];
-
-            for (int r = 0; r < REPEAT_COUNT; r++) {
-                /* データを共有メモリに書き込む */
-                fill_pattern(shm_ptr, size);
+            sample_set_t ss;
+            perf_sample_t pc_sum = {0};
+            int it = 0;
 
-                ctrl->data_size = size;
-                ctrl->iteration = r;
-                ctrl->phase = 1; /* 子に通知 */
+            /* ウォームアップ (子プロセスも同じ手順でコピーし、結果は捨てる) */
+            for (int w = 0; w < g_cfg.warmup; w++)
+                run_child_copy(ctrl, shm_ptr, size, it++);
 
-                /* 子プロセスのコピー完了を待つ */
-                while (ctrl->phase != 2) {
-                    usleep(100);
-                }
+            samples_init(&ss);
+            for (int r = 0; !samples_done(&ss); r++) {
+                double t = run_child_copy(ctrl, shm_ptr, size, it++);
+                samples_add(&ss, t);
+                perf_sample_add(&pc_sum, &ctrl->perf);
 
-                times[r] = ctrl->copy_time;
-                print_result("SHM-cpy  ", size, times[r], r + 1);
+                if (r == 0)
+                    printf("  内側ループ: %d 回/サンプル\n", ctrl->inner_reps);
+                if (r < REPEAT_COUNT)
+                    print_result("SHM-cpy  ", size, t, r + 1);
 
                 if (r == 0) {
                     if (ctrl->verify_err) {
@@ -143,18 +559,39 @@ int main(int argc, char *argv[])
                         printf("  ✓ データ検証OK\n");
                     }
                 }
-
-                ctrl->phase = 0;
             }
-            print_summary("SHM-cpy  ", size, times, REPEAT_COUNT);
+            print_summary("SHM-cpy  ", size, ss.v, ss.n);
+            print_perf_summary("SHM-cpy  ", size, &pc_sum,
+                               ss.n * ctrl->inner_reps);
+            samples_free(&ss);
             printf("\n");
         }
 
+        /* 制御ブロックのキャッシュラインを往復させるピンポン */
+        printf("--- POSIX shm ピンポン ベンチマーク ---\n");
+        printf("  (親が番号を書き、子が別のキャッシュラインに返すまでの往復時間)\n\n");
+        bench_pingpong(ctrl);
+        printf("\n");
+
+        /* 共有テーブルのルックアップ (子プロセスが実行・表示) */
+        printf("--- POSIX shm 共有テーブル ルックアップベンチマーク ---\n");
+        printf("  (親が構築したハッシュマップを子が直接参照 vs ローカルへコピーして参照)\n\n");
+        if (build_shared_table(env_long("BENCH_TBL_ENTRIES", DEFAULT_TBL_ENTRIES)) > 0)
+            run_child_command(ctrl, CMD_TABLE);
+        printf("\n");
+
+        /* 生成と受け取りを重ねるパイプライン転送 */
+        printf("--- POSIX shm パイプライン転送ベンチマーク ---\n");
+        printf("  (親がチャンクを生成してスロットへ書き、子が順にローカルへコピー。\n");
+        printf("   生成開始から子の受け取り完了まで。SHM-ring-ser は全体を書いてから全体をコピー)\n\n");
+        bench_ring_sweep(ctrl, shm_ptr, max_size);
+
         /* 子プロセスに終了を通知 */
         ctrl->data_size = 0;
         ctrl->phase = 1;
         wait(NULL);
 
+        stats_phase("done", 0);
         printf("ベンチマーク完了\n");
     }
 
@@ -163,6 +600,7 @@ int main(int argc, char *argv[])
     munmap(ctrl, sizeof(shm_control_t));
     shm_unlink(SHM_NAME);
     shm_unlink(CTRL_SHM_NAME);
+    shm_unlink(TBL_SHM_NAME);
 
     return 0;
 }
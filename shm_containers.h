@@ -0,0 +1,239 @@
+/*
+ * shm_containers.h - 共有メモリ上に置く再配置可能なコンテナ
+ *
+ * ポインタの代わりに「自分自身のアドレスからの相対オフセット」
+ * (offset_ptr) を持つので、エクスポータが自分のバッファ内に構築した
+ * コンテナを、インポータは xpmem の attach アドレスや POSIX shm の
+ * mmap アドレスがどこであってもそのまま (コピーせずに) 参照できる。
+ * ヘッダと要素配列を1ブロックに置けば、ブロックごと memcpy しても有効。
+ *
+ * - shm_vec_t:  固定要素サイズの可変長配列 (容量は構築時に固定)
+ * - shm_hmap_t: uint64 キー → uint64 値のオープンアドレス法ハッシュマップ
+ *
+ * 構築 (書き込み) はエクスポータ側の1スレッドのみ、参照は任意のプロセスから。
+ */
+
+#ifndef SHM_CONTAINERS_H
+#define SHM_CONTAINERS_H
+
+#include <stdint.h>
+#include <string.h>
+#include "common.h"
+
+/* ========== offset_ptr ========== */
+
+/* 0 は NULL。それ以外はこのフィールド自身のアドレスからのバイト差 */
+typedef int64_t offptr_t;
+
+static inline void *offptr_get(const offptr_t *op)
+{
+    return *op ? (char *)op + *op : NULL;
+}
+
+static inline void offptr_set(offptr_t *op, const void *p)
+{
+    *op = p ? (int64_t)((const char *)p - (const char *)op) : 0;
+}
+
+/* ========== ベクタ ========== */
+
+typedef struct {
+    offptr_t data;
+    uint64_t size;
+    uint64_t capacity;
+    uint64_t elem_size;
+} shm_vec_t;
+
+/* ヘッダ直後に要素配列を置く場合に必要なバイト数 */
+static inline size_t shm_vec_bytes(uint64_t capacity, uint64_t elem_size)
+{
+    return sizeof(shm_vec_t) + capacity * elem_size;
+}
+
+/* mem (shm_vec_bytes() バイト) にベクタを構築する */
+static inline shm_vec_t *shm_vec_init(void *mem, uint64_t capacity, uint64_t elem_size)
+{
+    shm_vec_t *v = (shm_vec_t *)mem;
+    v->size = 0;
+    v->capacity = capacity;
+    v->elem_size = elem_size;
+    offptr_set(&v->data, v + 1);
+    return v;
+}
+
+static inline void *shm_vec_at(const shm_vec_t *v, uint64_t i)
+{
+    return (char *)offptr_get(&v->data) + i * v->elem_size;
+}
+
+static inline int shm_vec_push(shm_vec_t *v, const void *elem)
+{
+    if (v->size >= v->capacity)
+        return -1;
+    memcpy(shm_vec_at(v, v->size), elem, v->elem_size);
+    v->size++;
+    return 0;
+}
+
+/* ========== ハッシュマップ ========== */
+
+#define SHM_HMAP_EMPTY UINT64_MAX   /* 空きスロットのキー (キーとしては使えない) */
+
+typedef struct {
+    uint64_t key;
+    uint64_t value;
+} shm_hmap_entry_t;
+
+typedef struct {
+    offptr_t slots;
+    uint64_t mask;      /* スロット数 - 1 (スロット数は2のべき乗) */
+    uint64_t count;
+} shm_hmap_t;
+
+static inline uint64_t shm_hash64(uint64_t x)
+{
+    /* splitmix64 の最終段 */
+    x ^= x >> 30; x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 27; x *= 0x94d049bb133111ebULL;
+    x ^= x >> 31;
+    return x;
+}
+
+/* entries 個を負荷率 1/2 以下で収めるスロット数 */
+static inline uint64_t shm_hmap_slots_for(uint64_t entries)
+{
+    uint64_t n = 16;
+    while (n < entries * 2)
+        n <<= 1;
+    return n;
+}
+
+static inline size_t shm_hmap_bytes(uint64_t entries)
+{
+    return sizeof(shm_hmap_t) + shm_hmap_slots_for(entries) * sizeof(shm_hmap_entry_t);
+}
+
+/* mem (shm_hmap_bytes(entries) バイト) に空のマップを構築する */
+static inline shm_hmap_t *shm_hmap_init(void *mem, uint64_t entries)
+{
+    shm_hmap_t *m = (shm_hmap_t *)mem;
+    uint64_t nslots = shm_hmap_slots_for(entries);
+    shm_hmap_entry_t *s = (shm_hmap_entry_t *)(m + 1);
+    for (uint64_t i = 0; i < nslots; i++) {
+        s[i].key = SHM_HMAP_EMPTY;
+        s[i].value = 0;
+    }
+    m->mask = nslots - 1;
+    m->count = 0;
+    offptr_set(&m->slots, s);
+    return m;
+}
+
+/* 挿入 (既存キーは上書き)。満杯なら -1 */
+static inline int shm_hmap_put(shm_hmap_t *m, uint64_t key, uint64_t value)
+{
+    shm_hmap_entry_t *s = (shm_hmap_entry_t *)offptr_get(&m->slots);
+    uint64_t i = shm_hash64(key) & m->mask;
+    for (uint64_t probe = 0; probe <= m->mask; probe++, i = (i + 1) & m->mask) {
+        if (s[i].key == key) {
+            s[i].value = value;
+            return 0;
+        }
+        if (s[i].key == SHM_HMAP_EMPTY) {
+            s[i].value = value;
+            s[i].key = key;
+            m->count++;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+/* 見つかれば 1 を返し *value に格納する */
+static inline int shm_hmap_get(const shm_hmap_t *m, uint64_t key, uint64_t *value)
+{
+    const shm_hmap_entry_t *s = (const shm_hmap_entry_t *)offptr_get(&m->slots);
+    uint64_t i = shm_hash64(key) & m->mask;
+    for (;;) {
+        if (s[i].key == key) {
+            *value = s[i].value;
+            return 1;
+        }
+        if (s[i].key == SHM_HMAP_EMPTY)
+            return 0;
+        i = (i + 1) & m->mask;
+    }
+}
+
+/* ========== ベンチマーク用テーブル ========== */
+
+/*
+ * 公開テーブル: キー一覧のベクタと、キー → 次のキー の巡回置換を持つ
+ * ハッシュマップ。値を辿るとすべてのキーを1周するので、依存連鎖の
+ * ルックアップでレイテンシを測れる。1ブロックにまとめて確保する。
+ */
+typedef struct {
+    offptr_t keys;      /* shm_vec_t (uint64_t) */
+    offptr_t map;       /* shm_hmap_t */
+    uint64_t bytes;     /* このブロック全体のバイト数 (コピー用) */
+} shm_table_t;
+
+static inline size_t shm_table_bytes(uint64_t entries)
+{
+    return sizeof(shm_table_t) + shm_vec_bytes(entries, sizeof(uint64_t)) + 64 +
+           shm_hmap_bytes(entries);
+}
+
+static inline uint64_t shm_gcd(uint64_t a, uint64_t b)
+{
+    while (b) {
+        uint64_t t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+/* mem に entries 個のテーブルを構築する。seed でキーを生成 */
+static inline shm_table_t *shm_table_build(void *mem, uint64_t entries, uint64_t seed)
+{
+    shm_table_t *t = (shm_table_t *)mem;
+    char *p = (char *)(t + 1);
+    shm_vec_t *keys = shm_vec_init(p, entries, sizeof(uint64_t));
+    p += (shm_vec_bytes(entries, sizeof(uint64_t)) + 63) & ~(size_t)63;
+    shm_hmap_t *map = shm_hmap_init(p, entries);
+
+    offptr_set(&t->keys, keys);
+    offptr_set(&t->map, map);
+    t->bytes = shm_table_bytes(entries);
+
+    /* 衝突しないキー: 奇数定数倍は 2^64 上の全単射 */
+    for (uint64_t i = 0; i < entries; i++) {
+        uint64_t k = (i + seed) * 0x9E3779B97F4A7C15ULL;
+        if (k == SHM_HMAP_EMPTY)
+            k = 0;
+        shm_vec_push(keys, &k);
+    }
+    /* キー i → キー (i + stride) mod n の巡回 (stride は n と互いに素) */
+    uint64_t stride = entries > 2 ? (entries / 2) | 1 : 1;
+    while (shm_gcd(stride, entries) != 1)
+        stride += 2;
+    for (uint64_t i = 0; i < entries; i++) {
+        uint64_t k = *(uint64_t *)shm_vec_at(keys, i);
+        uint64_t next = *(uint64_t *)shm_vec_at(keys, (i + stride) % entries);
+        shm_hmap_put(map, k, next);
+    }
+    return t;
+}
+
+static inline const shm_vec_t *shm_table_keys(const shm_table_t *t)
+{
+    return (const shm_vec_t *)offptr_get(&t->keys);
+}
+
+static inline const shm_hmap_t *shm_table_map(const shm_table_t *t)
+{
+    return (const shm_hmap_t *)offptr_get(&t->map);
+}
+
+#endif /* SHM_CONTAINERS_H */
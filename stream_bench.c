@@ -0,0 +1,271 @@
+/*
+ * stream_bench.c - STREAM 方式のメモリ帯域 (ルーフライン) 基準
+ *
+ * memcpy の速度だけでは、そのマシンでどこまで帯域が出るのかが
+ * 分からないため、ローカルメモリ上で STREAM と同じ形のカーネルを
+ * マルチスレッドで実行して到達可能な帯域を測る:
+ *   STREAM-copy   c[i] = a[i]               (2 × 8 bytes/要素)
+ *   STREAM-scale  b[i] = s * c[i]           (2 × 8)
+ *   STREAM-add    c[i] = a[i] + b[i]        (3 × 8)
+ *   STREAM-triad  a[i] = b[i] + s * c[i]    (3 × 8)
+ *   STREAM-read   sum += a[i]               (1 × 8, 読み取りのみ)
+ *   STREAM-write  a[i] = s                  (1 × 8, 書き込みのみ)
+ * 帯域は STREAM と同じく読み書きしたバイト数で数える
+ * (ライトアロケートの読み込みは数えない)。
+ * スレッド数は 1, 2, 4, ... と最大スレッド数まで増やし、RESULT 行の
+ * threads に記録する。統合ドライバはここで得た最大値をルーフラインとして、
+ * 各方式の結果をその何 % かで表示する。
+ *
+ * 使い方:
+ *   ./stream_bench
+ *   BENCH_STREAM_MB=256 で配列1本のサイズ (MB)
+ *   BENCH_STREAM_THREADS=16 で最大スレッド数 (既定: オンライン CPU 数)
+ *
+ * コンパイル:
+ *   gcc -O2 -o stream_bench stream_bench.c -lrt -lpthread -lm
+ */
+
+#include "common.h"
+#include <pthread.h>
+
+#define STREAM_SCALAR 3.0
+
+enum {
+    K_INIT = 0,
+    K_COPY,
+    K_SCALE,
+    K_ADD,
+    K_TRIAD,
+    K_READ,
+    K_WRITE,
+    K_EXIT,
+};
+
+static const struct {
+    const char *name;
+    int words;          /* 1要素あたりに読み書きする double の数 */
+} KERNELS[] = {
+    [K_COPY]  = { "STREAM-copy",  2 },
+    [K_SCALE] = { "STREAM-scale", 2 },
+    [K_ADD]   = { "STREAM-add",   3 },
+    [K_TRIAD] = { "STREAM-triad", 3 },
+    [K_READ]  = { "STREAM-read",  1 },
+    [K_WRITE] = { "STREAM-write", 1 },
+};
+
+/* スレッドプール: 全スレッドが start で揃い、各自の区間を処理して end で揃う */
+typedef struct {
+    double *a, *b, *c;
+    size_t n;
+    int nthreads;
+    int kernel;                 /* start の前に主スレッドが設定する */
+    pthread_barrier_t start;
+    pthread_barrier_t end;
+    uint64_t sums[256];         /* K_READ の結果 (最適化抑制用) */
+} stream_pool_t;
+
+typedef struct {
+    stream_pool_t *pool;
+    int id;
+} stream_worker_t;
+
+static void run_chunk(stream_pool_t *p, int id)
+{
+    size_t lo = p->n * (size_t)id / (size_t)p->nthreads;
+    size_t hi = p->n * (size_t)(id + 1) / (size_t)p->nthreads;
+    double *restrict a = p->a, *restrict b = p->b, *restrict c = p->c;
+    const double s = STREAM_SCALAR;
+
+    switch (p->kernel) {
+    case K_INIT:
+        for (size_t i = lo; i < hi; i++) {
+            a[i] = 1.0;
+            b[i] = 2.0;
+            c[i] = 0.0;
+        }
+        break;
+    case K_COPY:
+        for (size_t i = lo; i < hi; i++)
+            c[i] = a[i];
+        break;
+    case K_SCALE:
+        for (size_t i = lo; i < hi; i++)
+            b[i] = s * c[i];
+        break;
+    case K_ADD:
+        for (size_t i = lo; i < hi; i++)
+            c[i] = a[i] + b[i];
+        break;
+    case K_TRIAD:
+        for (size_t i = lo; i < hi; i++)
+            a[i] = b[i] + s * c[i];
+        break;
+    case K_READ: {
+        /*
+         * double の sum += a[i] は加算1本の依存連鎖になり、メモリではなく
+         * FP 加算のレイテンシで頭打ちになる。op_read_scan と同じくビット列を
+         * 整数で足し、さらに独立した4本の和に分けて1サイクルに複数読めるようにする
+         */
+        typedef uint64_t __attribute__((may_alias)) word_t;
+        const word_t *w = (const word_t *)a;
+        uint64_t s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+        size_t i = lo;
+        for (; i + 4 <= hi; i += 4) {
+            s0 += w[i];
+            s1 += w[i + 1];
+            s2 += w[i + 2];
+            s3 += w[i + 3];
+        }
+        for (; i < hi; i++)
+            s0 += w[i];
+        p->sums[id] += s0 + s1 + s2 + s3;
+        break;
+    }
+    case K_WRITE:
+        for (size_t i = lo; i < hi; i++)
+            a[i] = s;
+        break;
+    }
+}
+
+static void *worker_main(void *arg)
+{
+    stream_worker_t *w = (stream_worker_t *)arg;
+    stream_pool_t *p = w->pool;
+    for (;;) {
+        pthread_barrier_wait(&p->start);
+        if (p->kernel == K_EXIT)
+            return NULL;
+        run_chunk(p, w->id);
+        pthread_barrier_wait(&p->end);
+    }
+}
+
+/* 1操作: 全スレッドで kernel を1回 (主スレッドは id 0 を担当) */
+static void op_stream(void *arg)
+{
+    stream_pool_t *p = (stream_pool_t *)arg;
+    pthread_barrier_wait(&p->start);
+    run_chunk(p, 0);
+    pthread_barrier_wait(&p->end);
+}
+
+static int pool_start(stream_pool_t *p, int nthreads, pthread_t *tids, stream_worker_t *ws)
+{
+    p->nthreads = nthreads;
+    pthread_barrier_init(&p->start, NULL, (unsigned)nthreads);
+    pthread_barrier_init(&p->end, NULL, (unsigned)nthreads);
+    for (int t = 1; t < nthreads; t++) {
+        ws[t].pool = p;
+        ws[t].id = t;
+        if (pthread_create(&tids[t], NULL, worker_main, &ws[t]) != 0) {
+            perror("pthread_create");
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static void pool_stop(stream_pool_t *p, pthread_t *tids)
+{
+    p->kernel = K_EXIT;
+    pthread_barrier_wait(&p->start);
+    for (int t = 1; t < p->nthreads; t++)
+        pthread_join(tids[t], NULL);
+    pthread_barrier_destroy(&p->start);
+    pthread_barrier_destroy(&p->end);
+}
+
+/* 1カーネル・1スレッド数の計測。中央値の帯域 (GB/s) を返す */
+static double bench_kernel(stream_pool_t *p, int k)
+{
+    size_t bytes = p->n * sizeof(double) * (size_t)KERNELS[k].words;
+    p->kernel = k;
+
+    int reps = calibrate_inner_reps(op_stream, p);
+    for (int w = 0; w < g_cfg.warmup; w++)
+        time_op(op_stream, p, reps);
+
+    sample_set_t ss;
+    samples_init(&ss);
+    while (!samples_done(&ss))
+        samples_add(&ss, time_op(op_stream, p, reps));
+    print_summary(KERNELS[k].name, bytes, ss.v, ss.n);
+
+    sample_stats_t st;
+    compute_stats(ss.v, ss.n, &st);
+    samples_free(&ss);
+    return (double)bytes / st.median / (1024.0 * 1024 * 1024);
+}
+
+int main(void)
+{
+    size_t array_bytes = (size_t)env_long("BENCH_STREAM_MB", DEFAULT_STREAM_MB) * 1024UL * 1024;
+    long max_threads = env_long("BENCH_STREAM_THREADS", sysconf(_SC_NPROCESSORS_ONLN));
+    if (max_threads < 1)
+        max_threads = 1;
+    if (max_threads > 256)
+        max_threads = 256;
+
+    static stream_pool_t pool;
+    pool.n = array_bytes / sizeof(double);
+    pool.a = alloc_aligned(array_bytes);
+    pool.b = alloc_aligned(array_bytes);
+    pool.c = alloc_aligned(array_bytes);
+    if (!pool.a || !pool.b || !pool.c) {
+        fprintf(stderr, "配列の確保失敗\n");
+        return 1;
+    }
+
+    char sizebuf[64], timerbuf[128];
+    printf("=== STREAM 方式 メモリ帯域ベンチマーク (ルーフライン) ===\n");
+    printf("配列: 3 × %s, 最大 %ld スレッド\n",
+           format_size(array_bytes, sizebuf, sizeof(sizebuf)), max_threads);
+    bench_config_load();
+    timer_calibrate();
+    printf("タイマー: %s\n", timer_describe(timerbuf, sizeof(timerbuf)));
+    print_config();
+    printf("\n");
+
+    pthread_t tids[256];
+    stream_worker_t ws[256];
+
+    /* 最大スレッド数で初期化し、ページを各スレッドの区間に割り当てておく */
+    if (pool_start(&pool, (int)max_threads, tids, ws) != 0)
+        return 1;
+    pool.kernel = K_INIT;
+    op_stream(&pool);
+    pool_stop(&pool, tids);
+
+    double best[K_EXIT] = {0};
+    for (long t = 1; ; t = t * 2 < max_threads ? t * 2 : max_threads) {
+        printf("--- %ld スレッド ---\n", t);
+        g_result_ctx.threads = (int)t;
+        if (pool_start(&pool, (int)t, tids, ws) != 0)
+            return 1;
+        for (int k = K_COPY; k < K_EXIT; k++) {
+            double gbps = bench_kernel(&pool, k);
+            if (gbps > best[k])
+                best[k] = gbps;
+        }
+        pool_stop(&pool, tids);
+        printf("\n");
+        if (t == max_threads)
+            break;
+    }
+
+    printf("--- ルーフライン (スレッド数を振った最大値) ---\n");
+    for (int k = K_COPY; k < K_EXIT; k++)
+        printf("  %-14s %8.2f GB/s\n", KERNELS[k].name, best[k]);
+
+    uint64_t sum = 0;
+    for (int t = 0; t < (int)max_threads; t++)
+        sum += pool.sums[t];
+    __asm__ volatile("" :: "g"(sum));
+
+    free(pool.a);
+    free(pool.b);
+    free(pool.c);
+    printf("\nベンチマーク完了\n");
+    return 0;
+}
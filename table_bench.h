@@ -0,0 +1,133 @@
+/*
+ * table_bench.h - 共有テーブル (shm_containers.h) のルックアップベンチマーク
+ *
+ * エクスポータ (または shm_bench の親) が構築した shm_table_t を、
+ * 共有メモリ上で直接引く場合と、ローカルへまるごとコピーしてから引く
+ * 場合を比べる。独立したルックアップ (スループット) と、値を次のキーに
+ * する依存連鎖 (レイテンシ) を計り、コピーが元を取るルックアップ数を出す。
+ * xpmem_importer と shm_bench が使う。
+ */
+
+#ifndef TABLE_BENCH_H
+#define TABLE_BENCH_H
+
+#include "common.h"
+#include "buf_pool.h"
+#include "shm_containers.h"
+
+#define TBL_BATCH 4096
+
+typedef struct {
+    const shm_hmap_t *map;
+    uint64_t keys[TBL_BATCH];   /* ランダムに選んだキー (ローカル) */
+    uint64_t start;             /* 依存連鎖の開始キー */
+    uint64_t sum;
+} tbl_lookup_arg_t;
+
+/* 独立したルックアップ (スループット) */
+static inline void op_tbl_lookup(void *arg)
+{
+    tbl_lookup_arg_t *a = (tbl_lookup_arg_t *)arg;
+    uint64_t sum = 0, v;
+    for (int i = 0; i < TBL_BATCH; i++)
+        if (shm_hmap_get(a->map, a->keys[i], &v))
+            sum += v;
+    a->sum += sum;
+    __asm__ volatile("" :: "r"(sum) : "memory");
+}
+
+/* 値 = 次のキー を辿る依存連鎖 (レイテンシ) */
+static inline void op_tbl_chase(void *arg)
+{
+    tbl_lookup_arg_t *a = (tbl_lookup_arg_t *)arg;
+    uint64_t k = a->start;
+    for (int i = 0; i < TBL_BATCH; i++)
+        shm_hmap_get(a->map, k, &k);
+    a->start = k;
+    __asm__ volatile("" :: "r"(k) : "memory");
+}
+
+/* op を計測し、1ルックアップあたりの時間で結果を表示する。中央値を返す */
+static inline double tbl_measure(const char *label, bench_op_fn op, tbl_lookup_arg_t *arg)
+{
+    stats_phase(label, TBL_BATCH * sizeof(shm_hmap_entry_t));
+    int reps = calibrate_inner_reps(op, arg);
+    for (int w = 0; w < g_cfg.warmup; w++)
+        time_op(op, arg, reps);
+
+    sample_set_t ss;
+    samples_init(&ss);
+    while (!samples_done(&ss))
+        samples_add(&ss, time_op(op, arg, reps) / TBL_BATCH);
+
+    /* 1ルックアップで読むエントリ (16 B) をサイズとして扱う */
+    print_summary(label, sizeof(shm_hmap_entry_t), ss.v, ss.n);
+    sample_stats_t st;
+    compute_stats(ss.v, ss.n, &st);
+    printf("  [%s] %.1f ns/lookup, %.2f Mlookup/s (中央値)\n",
+           label, st.median * 1e9, 1e-6 / st.median);
+    samples_free(&ss);
+    return st.median;
+}
+
+/*
+ * 共有テーブル t を直接参照する場合と、ローカルにコピーしてから
+ * 参照する場合を比較する。prefix は結果ラベルの先頭 (例 "xpmem")。
+ */
+static inline void bench_table_lookup(const char *prefix, const shm_table_t *t)
+{
+    const shm_vec_t *keys = shm_table_keys(t);
+    uint64_t n = keys->size;
+    char label[64], sizebuf[64];
+    printf("  テーブル: %lu エントリ, %s\n", (unsigned long)n,
+           format_size(t->bytes, sizebuf, sizeof(sizebuf)));
+    if (n == 0)
+        return;
+
+    static tbl_lookup_arg_t arg;
+    uint64_t rng = 0x853c49e6748fea9bULL;
+    for (int i = 0; i < TBL_BATCH; i++)
+        arg.keys[i] = *(const uint64_t *)shm_vec_at(keys, xorshift64(&rng) % n);
+    arg.start = arg.keys[0];
+
+    /* 1. 共有メモリ上のテーブルを直接参照 */
+    arg.map = shm_table_map(t);
+    snprintf(label, sizeof(label), "%s-tbl-tp", prefix);
+    double dir_tp = tbl_measure(label, op_tbl_lookup, &arg);
+    snprintf(label, sizeof(label), "%s-tbl-lat", prefix);
+    tbl_measure(label, op_tbl_chase, &arg);
+
+    /* 2. テーブルをまるごとローカルへ memcpy (offset_ptr なのでそのまま使える) */
+    void *local = pool_get(t->bytes);
+    if (!local)
+        return;
+    memset(local, 0, t->bytes);
+    mem_op_arg_t cp = { local, t, t->bytes, 0 };
+    snprintf(label, sizeof(label), "%s-tbl-cpy", prefix);
+    stats_phase(label, t->bytes);
+    int reps = calibrate_inner_reps(op_memcpy, &cp);
+    sample_set_t ss;
+    samples_init(&ss);
+    while (!samples_done(&ss))
+        samples_add(&ss, time_op(op_memcpy, &cp, reps));
+    print_summary(label, t->bytes, ss.v, ss.n);
+    sample_stats_t cst;
+    compute_stats(ss.v, ss.n, &cst);
+    samples_free(&ss);
+
+    /* 3. コピーしたテーブルを参照 */
+    arg.map = shm_table_map((const shm_table_t *)local);
+    snprintf(label, sizeof(label), "%s-tbl-ltp", prefix);
+    double loc_tp = tbl_measure(label, op_tbl_lookup, &arg);
+    snprintf(label, sizeof(label), "%s-tbl-llat", prefix);
+    tbl_measure(label, op_tbl_chase, &arg);
+
+    if (dir_tp > loc_tp)
+        printf("  コピーが元を取るルックアップ数: %.0f 回\n",
+               cst.median / (dir_tp - loc_tp));
+    else
+        printf("  直接参照の方が速い (コピーは元を取れない)\n");
+    pool_put(local);
+}
+
+#endif /* TABLE_BENCH_H */
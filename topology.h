@@ -0,0 +1,169 @@
+/*
+ * topology.h - CPU トポロジの読み取りと CPU の組の分類
+ *
+ * /sys/devices/system/cpu/cpuN/ からソケット・物理コア・L3 を読み、
+ * 2つの論理CPUの関係を次のどれかに分類する:
+ *   TOPO_SMT     同じ物理コアの SMT 兄弟
+ *   TOPO_L3      別コアだが同じ L3 を共有
+ *   TOPO_DIE     同じソケットで L3 が別 (CCX / ダイ違い)
+ *   TOPO_SOCKET  別ソケット
+ * 配置スイープ (xpmem_bench -t) で CPU の組を選ぶのに使う。
+ * NUMA ノードと CPU の対応も読む (noise_gen の固定先、エクスポータの並列初期化)。
+ */
+
+#ifndef TOPOLOGY_H
+#define TOPOLOGY_H
+
+#include "common.h"
+
+#define TOPO_MAX_CPUS 1024
+#define TOPO_SYSFS    "/sys/devices/system/cpu"
+
+enum {
+    TOPO_SMT = 0,
+    TOPO_L3,
+    TOPO_DIE,
+    TOPO_SOCKET,
+    TOPO_NUM_CLASSES,
+};
+
+static const char *const TOPO_NAMES[TOPO_NUM_CLASSES] = { "smt", "l3", "die", "socket" };
+static const char *const TOPO_DESCS[TOPO_NUM_CLASSES] = {
+    "SMT 兄弟", "同じ L3", "別 L3 (CCX/ダイ違い)", "別ソケット",
+};
+
+typedef struct {
+    int online;
+    int package;        /* physical_package_id */
+    int core;           /* thread_siblings_list の先頭 CPU (物理コアの代表) */
+    int l3;             /* L3 を共有する CPU の先頭 (L3 が無ければ -1) */
+} cpu_topo_t;
+
+/* ファイル先頭の整数を読む。CPU リスト ("0-3,8") なら最初の CPU になる */
+static inline int sysfs_read_int(const char *path, int def)
+{
+    FILE *fp = fopen(path, "r");
+    if (!fp)
+        return def;
+    int v;
+    if (fscanf(fp, "%d", &v) != 1)
+        v = def;
+    fclose(fp);
+    return v;
+}
+
+/* cpu の L3 (level 3 の unified キャッシュ) を共有する CPU の先頭 */
+static inline int topo_read_l3(int cpu)
+{
+    char path[256];
+    for (int idx = 0; idx < 8; idx++) {
+        snprintf(path, sizeof(path), TOPO_SYSFS "/cpu%d/cache/index%d/level", cpu, idx);
+        int level = sysfs_read_int(path, -1);
+        if (level < 0)
+            break;
+        if (level != 3)
+            continue;
+        snprintf(path, sizeof(path), TOPO_SYSFS "/cpu%d/cache/index%d/shared_cpu_list",
+                 cpu, idx);
+        return sysfs_read_int(path, -1);
+    }
+    return -1;
+}
+
+/* 最後のレベルのキャッシュ (cpu0 から見たもの) の大きさ (bytes)。分からなければ 0 */
+static inline size_t topo_llc_bytes(void)
+{
+    char path[256];
+    int best_level = 0;
+    size_t best = 0;
+    for (int idx = 0; idx < 8; idx++) {
+        snprintf(path, sizeof(path), TOPO_SYSFS "/cpu0/cache/index%d/level", idx);
+        int level = sysfs_read_int(path, -1);
+        if (level < 0)
+            break;
+        /* size は "32768K" の形 (先頭の整数だけ読む) */
+        snprintf(path, sizeof(path), TOPO_SYSFS "/cpu0/cache/index%d/size", idx);
+        size_t bytes = (size_t)sysfs_read_int(path, 0) * 1024;
+        if (level > best_level || (level == best_level && bytes > best)) {
+            best_level = level;
+            best = bytes;
+        }
+    }
+    return best;
+}
+
+/* 全 CPU のトポロジを読む。CPU 数を返す (最大 max) */
+static inline int topo_load(cpu_topo_t *t, int max)
+{
+    long n = sysconf(_SC_NPROCESSORS_CONF);
+    if (n > max)
+        n = max;
+    char path[256];
+    for (int c = 0; c < n; c++) {
+        /* cpu0 には online が無いことが多い (常にオンライン) */
+        snprintf(path, sizeof(path), TOPO_SYSFS "/cpu%d/online", c);
+        t[c].online = sysfs_read_int(path, 1) == 1;
+        snprintf(path, sizeof(path), TOPO_SYSFS "/cpu%d/topology/physical_package_id", c);
+        t[c].package = sysfs_read_int(path, 0);
+        snprintf(path, sizeof(path), TOPO_SYSFS "/cpu%d/topology/thread_siblings_list", c);
+        t[c].core = sysfs_read_int(path, c);
+        t[c].l3 = topo_read_l3(c);
+    }
+    return (int)n;
+}
+
+/* NUMA ノードの CPU リスト ("0-7,16-23") を展開する。CPU 数を返す */
+static inline int topo_node_cpus(long node, long *out, int max)
+{
+    char path[128], list[4096];
+    snprintf(path, sizeof(path), "/sys/devices/system/node/node%ld/cpulist", node);
+    FILE *fp = fopen(path, "r");
+    if (!fp)
+        return 0;
+    if (!fgets(list, sizeof(list), fp))
+        list[0] = '\0';
+    fclose(fp);
+
+    int n = 0;
+    for (char *s = list; *s && *s != '\n' && n < max; ) {
+        char *end;
+        long lo = strtol(s, &end, 10), hi = lo;
+        if (end == s)
+            break;
+        if (*end == '-')
+            hi = strtol(end + 1, &end, 10);
+        for (long c = lo; c <= hi && n < max; c++)
+            out[n++] = c;
+        s = (*end == ',') ? end + 1 : end;
+    }
+    return n;
+}
+
+/* cpu が属する NUMA ノード (分からなければ -1) */
+static inline int topo_cpu_node(int cpu)
+{
+    char path[128];
+    for (int node = 0; node < 1024; node++) {
+        snprintf(path, sizeof(path), TOPO_SYSFS "/cpu%d/node%d", cpu, node);
+        if (access(path, F_OK) == 0)
+            return node;
+        snprintf(path, sizeof(path), "/sys/devices/system/node/node%d", node);
+        if (access(path, F_OK) != 0)
+            return -1;
+    }
+    return -1;
+}
+
+/* a と b (a != b) の関係を TOPO_* で返す */
+static inline int topo_classify(const cpu_topo_t *t, int a, int b)
+{
+    if (t[a].package != t[b].package)
+        return TOPO_SOCKET;
+    if (t[a].core == t[b].core)
+        return TOPO_SMT;
+    if (t[a].l3 >= 0 && t[a].l3 == t[b].l3)
+        return TOPO_L3;
+    return TOPO_DIE;
+}
+
+#endif /* TOPOLOGY_H */
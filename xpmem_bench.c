@@ -0,0 +1,818 @@
+/*
+ * xpmem_bench.c - 統合ベンチマークドライバ
+ *
+ * このプロセスは:
+ * 1. 登録されたバックエンドごとに必要なプロセスを fork/exec で起動する
+ *    (xpmem はエクスポータとインポータ、POSIX shm は shm_bench、
+ *    ファイルは file_bench、パイプは pipe_bench、memfd は memfd_bench、
+ *    コア間レイテンシは c2c_bench、帯域の基準は stream_bench)
+ * 2. エクスポータとインポータを指定CPUに固定し、継承した socketpair で
+ *    セグメント情報と完了通知を受け渡しさせる (/tmp の同期ファイルと
+ *    ポーリングを使わない)
+ * 3. 子プロセスの出力をそのまま表示しつつ RESULT 行を集め、
+ *    最後に全バックエンド・全配置の結果をまとめて表示する。
+ *    stream を実行していれば、各結果を STREAM のルーフラインに対する % でも示す
+ * 4. 配置をトポロジ (SMT 兄弟 / 同じ L3 / 別ダイ / 別ソケット) で分類し、
+ *    主要な結果を CPU の組 × 方式の行列にまとめる
+ * 5. -n を指定すると、負荷なしに続けて noise_gen で背景メモリトラフィックを
+ *    流しながら同じバックエンドを繰り返し、負荷なしからの低下をまとめる
+ *
+ * 使い方:
+ *   ./xpmem_bench [-s 最大サイズ(MB)] [-p E:I[,E:I...]] [-t 組数] [-n 負荷[,...]]
+ *                 [-b バックエンド[,...]] [-l]
+ *     -s  最大テストサイズ (MB)
+ *     -p  エクスポータCPU:インポータCPU の組。複数指定で配置スイープ
+ *     -t  トポロジの分類ごとに最大この数の CPU の組を自動で選んでスイープ
+ *         (0 なら全ての組)
+ *     -n  背景負荷 モード:スレッド数[:MB/s] (モードは read / write / rand、
+ *         MB/s は1スレッドあたり、省略で無制限)。例: -n read:2,write:4:2000
+ *         固定する CPU / ノードは BENCH_NOISE_CPUS / BENCH_NOISE_NODE で指定する
+ *     -b  実行するバックエンド (省略時は全て)
+ *     -l  登録済みバックエンドの一覧
+ *
+ * 各子プロセスは同じディレクトリにある実行ファイルを使う。
+ */
+
+#include "common.h"
+#include "topology.h"
+#include <sys/socket.h>
+#include <sys/wait.h>
+
+#define MAX_PLACEMENTS 4096
+#define MAX_RESULTS    65536
+#define MAX_NOISE      16
+
+typedef struct {
+    int exporter_cpu;   /* -1: 固定しない */
+    int importer_cpu;
+    int topo;           /* TOPO_*。分類できなければ -1 */
+} placement_t;
+
+/* 背景負荷 (-n) の1条件 */
+typedef struct {
+    char mode[8];
+    int threads;
+    long mbps;          /* 1スレッドあたり。0: 無制限 */
+    char label[48];     /* RESULT 行の配置に "+label" として付く */
+} noise_spec_t;
+
+typedef struct {
+    char bin_dir[4096];
+    long max_mb;        /* 0: 各バイナリの既定値 */
+    placement_t placements[MAX_PLACEMENTS];
+    int num_placements;
+    cpu_topo_t topo[TOPO_MAX_CPUS];
+    int num_cpus;
+    noise_spec_t noise[MAX_NOISE];
+    int num_noise;
+} driver_opts_t;
+
+/* 集めた RESULT 行 */
+static char *g_results[MAX_RESULTS];
+static int g_num_results;
+
+/* ========== 子プロセス管理 ========== */
+
+/*
+ * bin_dir/name を起動する。標準出力・標準エラーは out_fd へ、
+ * keep_fd は ENV_SOCK_FD で子に渡し、close_fd は子側で閉じる。
+ * env ("NAME=値" の NULL 終端リスト, NULL 可) は子にだけ設定する。
+ */
+static pid_t spawn(const driver_opts_t *o, const char *name, char *const extra_args[],
+                   const placement_t *pl, int out_fd, int keep_fd, int close_fd,
+                   char *const env[])
+{
+    pid_t pid = fork();
+    if (pid != 0)
+        return pid;
+
+    char path[4200], buf[32];
+    snprintf(path, sizeof(path), "%s/%s", o->bin_dir, name);
+
+    dup2(out_fd, STDOUT_FILENO);
+    dup2(out_fd, STDERR_FILENO);
+    close(out_fd);
+    if (close_fd >= 0)
+        close(close_fd);
+
+    if (keep_fd >= 0) {
+        snprintf(buf, sizeof(buf), "%d", keep_fd);
+        setenv(ENV_SOCK_FD, buf, 1);
+    }
+    if (pl->exporter_cpu >= 0) {
+        snprintf(buf, sizeof(buf), "%d", pl->exporter_cpu);
+        setenv(ENV_EXPORTER_CPU, buf, 1);
+    }
+    if (pl->importer_cpu >= 0) {
+        snprintf(buf, sizeof(buf), "%d", pl->importer_cpu);
+        setenv(ENV_IMPORTER_CPU, buf, 1);
+    }
+    for (int i = 0; env && env[i]; i++)
+        putenv(env[i]);
+
+    char *argv[8];
+    int argc = 0;
+    argv[argc++] = (char *)name;
+    for (int i = 0; extra_args && extra_args[i] && argc < 7; i++)
+        argv[argc++] = extra_args[i];
+    argv[argc] = NULL;
+
+    execv(path, argv);
+    fprintf(stderr, "execv %s: %s\n", path, strerror(errno));
+    _exit(127);
+}
+
+/* 子プロセスの出力を中継し、RESULT 行を記録する。EOF まで読む */
+static void relay_output(int fd)
+{
+    FILE *fp = fdopen(fd, "r");
+    if (!fp) {
+        close(fd);
+        return;
+    }
+    char line[1024];
+    while (fgets(line, sizeof(line), fp)) {
+        fputs(line, stdout);
+        if (strncmp(line, "RESULT ", 7) == 0 && g_num_results < MAX_RESULTS)
+            g_results[g_num_results++] = strdup(line);
+    }
+    fflush(stdout);
+    fclose(fp);
+}
+
+static int wait_child(pid_t pid, const char *name)
+{
+    int status;
+    if (waitpid(pid, &status, 0) < 0)
+        return -1;
+    if (WIFEXITED(status) && WEXITSTATUS(status) == 0)
+        return 0;
+    fprintf(stderr, "  *** %s が異常終了 (status=0x%x) ***\n", name, status);
+    return -1;
+}
+
+static char *max_mb_arg(const driver_opts_t *o, char *buf, size_t len)
+{
+    if (o->max_mb <= 0)
+        return NULL;
+    snprintf(buf, len, "%ld", o->max_mb);
+    return buf;
+}
+
+/* ========== 背景負荷 ========== */
+
+/* noise_gen を起動し、"NOISE READY" まで出力を中継する。失敗なら -1 */
+static pid_t start_noise(const driver_opts_t *o, const noise_spec_t *ns, FILE **out)
+{
+    int fds[2];
+    if (pipe(fds) != 0) {
+        perror("pipe");
+        return -1;
+    }
+
+    /* 後で起動するバックエンドに漏れないよう、noise_gen の環境にだけ入れる */
+    char mode[64], threads[64], mbps[64];
+    snprintf(mode, sizeof(mode), "BENCH_NOISE_MODE=%s", ns->mode);
+    snprintf(threads, sizeof(threads), "BENCH_NOISE_THREADS=%d", ns->threads);
+    snprintf(mbps, sizeof(mbps), "BENCH_NOISE_MBPS=%ld", ns->mbps);
+    char *env[] = { mode, threads, mbps, NULL };
+
+    static const placement_t unpinned = { -1, -1, -1 };
+    pid_t pid = spawn(o, "noise_gen", NULL, &unpinned, fds[1], -1, -1, env);
+    close(fds[1]);
+
+    *out = fdopen(fds[0], "r");
+    char line[1024];
+    while (*out && fgets(line, sizeof(line), *out)) {
+        fputs(line, stdout);
+        if (strncmp(line, "NOISE READY", 11) == 0) {
+            fflush(stdout);
+            return pid;
+        }
+    }
+    fprintf(stderr, "  *** noise_gen の起動に失敗 ***\n");
+    if (*out)
+        fclose(*out);
+    else
+        close(fds[0]);
+    wait_child(pid, "noise_gen");
+    return -1;
+}
+
+/* noise_gen を止め、達成した帯域の表示を中継する */
+static int stop_noise(pid_t pid, FILE *out)
+{
+    kill(pid, SIGTERM);
+    char line[1024];
+    while (fgets(line, sizeof(line), out))
+        fputs(line, stdout);
+    fflush(stdout);
+    fclose(out);
+    return wait_child(pid, "noise_gen");
+}
+
+/* ========== バックエンド ========== */
+
+/* xpmem: エクスポータとインポータを socketpair でつないで起動 */
+static int run_xpmem(const driver_opts_t *o, const placement_t *pl)
+{
+    int sv[2], out[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, sv) != 0 || pipe(out) != 0) {
+        perror("socketpair/pipe");
+        return -1;
+    }
+
+    char mb[32];
+    char *exp_args[] = { max_mb_arg(o, mb, sizeof(mb)), NULL };
+
+    pid_t ep = spawn(o, "xpmem_exporter", exp_args, pl, out[1], sv[0], sv[1], NULL);
+    pid_t ip = spawn(o, "xpmem_importer", NULL, pl, out[1], sv[1], sv[0], NULL);
+    close(sv[0]);
+    close(sv[1]);
+    close(out[1]);
+
+    relay_output(out[0]);
+
+    int rc = 0;
+    if (wait_child(ip, "xpmem_importer") != 0) rc = -1;
+    if (wait_child(ep, "xpmem_exporter") != 0) rc = -1;
+    return rc;
+}
+
+/* 内部で fork する単体バイナリを1つ起動する */
+static int run_single(const driver_opts_t *o, const placement_t *pl, const char *name)
+{
+    int out[2];
+    if (pipe(out) != 0) {
+        perror("pipe");
+        return -1;
+    }
+
+    char mb[32];
+    char *args[] = { max_mb_arg(o, mb, sizeof(mb)), NULL };
+
+    pid_t pid = spawn(o, name, args, pl, out[1], -1, -1, NULL);
+    close(out[1]);
+    relay_output(out[0]);
+    return wait_child(pid, name);
+}
+
+/* POSIX shm */
+static int run_shm(const driver_opts_t *o, const placement_t *pl)
+{
+    return run_single(o, pl, "shm_bench");
+}
+
+/* ファイル (BENCH_FILE で置き場所を指定) */
+static int run_file(const driver_opts_t *o, const placement_t *pl)
+{
+    return run_single(o, pl, "file_bench");
+}
+
+/* パイプ (BENCH_PIPE_SIZES で容量をスイープ) */
+static int run_pipe(const driver_opts_t *o, const placement_t *pl)
+{
+    return run_single(o, pl, "pipe_bench");
+}
+
+/* 封印 memfd を SCM_RIGHTS で受け渡し */
+static int run_memfd(const driver_opts_t *o, const placement_t *pl)
+{
+    return run_single(o, pl, "memfd_bench");
+}
+
+/* STREAM 方式の帯域基準 (ルーフライン) */
+static int run_stream(const driver_opts_t *o, const placement_t *pl)
+{
+    return run_single(o, pl, "stream_bench");
+}
+
+/* コア間レイテンシ行列 (CPU の固定は c2c_bench が組ごとに行う) */
+static int run_c2c(const driver_opts_t *o, const placement_t *pl)
+{
+    return run_single(o, pl, "c2c_bench");
+}
+
+typedef struct {
+    const char *name;
+    const char *desc;
+    int (*run)(const driver_opts_t *o, const placement_t *pl);
+    int once;           /* 配置・背景負荷によらないので最後に1回だけ実行する */
+} backend_t;
+
+/* 登録済みバックエンド (実行順) */
+static const backend_t BACKENDS[] = {
+    { "stream", "stream_bench (STREAM-copy/scale/add/triad/read/write, ルーフライン)", run_stream, 1 },
+    { "xpmem", "xpmem_exporter + xpmem_importer (xpmem-cpy, xpmem-dir, LOCAL-cpy, xpmem-att)", run_xpmem, 0 },
+    { "shm",   "shm_bench (SHM-cpy, SHM-pp, SHM-ring)",                           run_shm,   0 },
+    { "file",  "file_bench (FILE-map, FILE-pop, FILE-read, FILE-odir)",            run_file,  0 },
+    { "pipe",  "pipe_bench (PIPE-rw, PIPE-vms, PIPE-spl)",                        run_pipe,  0 },
+    { "memfd", "memfd_bench (MEMFD-hand, MEMFD-tch, MEMFD-cpy, MEMFD-dir)",       run_memfd, 0 },
+    { "c2c",   "c2c_bench (C2C-smt, C2C-l3, C2C-die, C2C-socket)",                run_c2c,   1 },
+};
+#define NUM_BACKENDS (sizeof(BACKENDS) / sizeof(BACKENDS[0]))
+
+/* ========== 結果まとめ ========== */
+
+static int result_field(const char *line, const char *key, char *out, size_t len)
+{
+    char pat[64];
+    snprintf(pat, sizeof(pat), " %s=", key);
+    const char *p = strstr(line, pat);
+    if (!p)
+        return -1;
+    p += strlen(pat);
+    size_t n = strcspn(p, " \n");
+    if (n >= len) n = len - 1;
+    memcpy(out, p, n);
+    out[n] = '\0';
+    return 0;
+}
+
+/* backend の STREAM 方式の結果のうち最大の帯域 (全スレッド数・配置)。無ければ 0 */
+static double stream_roofline(const char *backend)
+{
+    double best = 0;
+    for (int i = 0; i < g_num_results; i++) {
+        char be[64], gbps[32];
+        if (result_field(g_results[i], "backend", be, sizeof(be)) ||
+            result_field(g_results[i], "gbps", gbps, sizeof(gbps)) ||
+            strcmp(be, backend) != 0)
+            continue;
+        if (atof(gbps) > best)
+            best = atof(gbps);
+    }
+    return best;
+}
+
+/*
+ * ルーフラインに対する割合 (%)。コピー (ROOF_COPY) は読み書きの2倍の
+ * トラフィックとして STREAM-copy と、直接アクセス (ROOF_READ) は
+ * STREAM-read と比べる。キャッシュに収まるサイズは DRAM の帯域と比べても
+ * 意味が無いので LLC より大きいサイズだけ (llc が 0 なら全て)。対応しなければ負
+ */
+static const char *const ROOF_COPY[] = { "xpmem-cpy", "LOCAL-cpy", "SHM-cpy", "MEMFD-cpy" };
+static const char *const ROOF_READ[] = { "xpmem-dir", "MEMFD-dir" };
+
+static int name_in(const char *name, const char *const *list, size_t n)
+{
+    for (size_t i = 0; i < n; i++)
+        if (strcmp(name, list[i]) == 0)
+            return 1;
+    return 0;
+}
+
+static double roofline_pct(const char *backend, size_t size, size_t llc, double gbps,
+                           double copy_roof, double read_roof)
+{
+    if (size <= llc)
+        return -1;
+    if (name_in(backend, ROOF_COPY, sizeof(ROOF_COPY) / sizeof(ROOF_COPY[0])) && copy_roof > 0)
+        return gbps * 2 / copy_roof * 100;
+    if (name_in(backend, ROOF_READ, sizeof(ROOF_READ) / sizeof(ROOF_READ[0])) && read_roof > 0)
+        return gbps / read_roof * 100;
+    return -1;
+}
+
+static void print_report(void)
+{
+    double copy_roof = stream_roofline("STREAM-copy");
+    double read_roof = stream_roofline("STREAM-read");
+    size_t llc = topo_llc_bytes();
+    char llcbuf[64];
+
+    printf("\n========================================\n");
+    printf("  まとめ (%d 件)\n", g_num_results);
+    if (copy_roof > 0 || read_roof > 0)
+        printf("  ルーフライン: STREAM-copy %.2f GB/s, STREAM-read %.2f GB/s"
+               " (roof%% は LLC %s より大きいサイズのみ)\n", copy_roof, read_roof,
+               llc ? format_size(llc, llcbuf, sizeof(llcbuf)) : "不明");
+    printf("========================================\n");
+    printf("  %-14s %-12s %10s %12s %14s %9s %7s\n",
+           "placement", "backend", "size", "median GB/s", "mean us", "95%CI", "roof%");
+
+    for (int i = 0; i < g_num_results; i++) {
+        char pl[128], be[64], size[32], gbps[32], mean[32], ci[32], sizebuf[64];
+        if (result_field(g_results[i], "placement", pl, sizeof(pl)) ||
+            result_field(g_results[i], "backend", be, sizeof(be)) ||
+            result_field(g_results[i], "size", size, sizeof(size)) ||
+            result_field(g_results[i], "gbps", gbps, sizeof(gbps)) ||
+            result_field(g_results[i], "mean_us", mean, sizeof(mean)) ||
+            result_field(g_results[i], "ci95_us", ci, sizeof(ci)))
+            continue;
+        double m = atof(mean);
+        double roof = roofline_pct(be, (size_t)atoll(size), llc, atof(gbps), copy_roof,
+                                   read_roof);
+        char roofbuf[16] = "-";
+        if (roof >= 0)
+            snprintf(roofbuf, sizeof(roofbuf), "%.1f", roof);
+        printf("  %-14s %-12s %10s %12.2f %14.4f %8.2f%% %7s\n",
+               pl, be, format_size((size_t)atoll(size), sizebuf, sizeof(sizebuf)),
+               atof(gbps), m, m > 0 ? atof(ci) / m * 100 : 0.0, roofbuf);
+    }
+}
+
+/*
+ * トポロジ行列: 配置ごとに、各方式の最大サイズでの中央値を並べ、
+ * 分類ごとの平均を付ける
+ */
+static const struct {
+    const char *backend;
+    int latency;        /* 1: median us, 0: GB/s */
+} TOPO_METRICS[] = {
+    { "xpmem-cpy", 0 },
+    { "xpmem-dir", 0 },
+    { "SHM-cpy",   0 },
+    { "SHM-pp",    1 },
+};
+#define NUM_TOPO_METRICS (sizeof(TOPO_METRICS) / sizeof(TOPO_METRICS[0]))
+
+/* placement と backend が一致する結果のうち最大サイズの値。無ければ -1 */
+static int find_metric(const char *placement, const char *backend, int latency, double *val)
+{
+    long long best = -1;
+    for (int i = 0; i < g_num_results; i++) {
+        char pl[128], be[64], size[32], v[32];
+        if (result_field(g_results[i], "placement", pl, sizeof(pl)) ||
+            result_field(g_results[i], "backend", be, sizeof(be)) ||
+            result_field(g_results[i], "size", size, sizeof(size)) ||
+            result_field(g_results[i], latency ? "median_us" : "gbps", v, sizeof(v)))
+            continue;
+        if (strcmp(pl, placement) != 0 || strcmp(be, backend) != 0 || atoll(size) < best)
+            continue;
+        best = atoll(size);
+        *val = atof(v);
+    }
+    return best >= 0 ? 0 : -1;
+}
+
+static void print_topology_matrix(const driver_opts_t *o)
+{
+    double sum[TOPO_NUM_CLASSES][NUM_TOPO_METRICS] = {{0}};
+    int cnt[TOPO_NUM_CLASSES][NUM_TOPO_METRICS] = {{0}};
+    int any = 0;
+    for (int p = 0; p < o->num_placements; p++)
+        any |= o->placements[p].topo >= 0;
+    if (!any)
+        return;
+
+    printf("\n========================================\n");
+    printf("  トポロジ行列 (各方式の最大サイズの中央値)\n");
+    printf("========================================\n");
+    printf("  %-12s %-7s", "placement", "class");
+    for (size_t m = 0; m < NUM_TOPO_METRICS; m++)
+        printf(" %14s", TOPO_METRICS[m].backend);
+    printf("\n  %-12s %-7s", "", "");
+    for (size_t m = 0; m < NUM_TOPO_METRICS; m++)
+        printf(" %14s", TOPO_METRICS[m].latency ? "us" : "GB/s");
+    printf("\n");
+
+    for (int p = 0; p < o->num_placements; p++) {
+        const placement_t *pl = &o->placements[p];
+        if (pl->topo < 0)
+            continue;
+        char label[64];
+        snprintf(label, sizeof(label), "e%d-i%d", pl->exporter_cpu, pl->importer_cpu);
+        printf("  %-12s %-7s", label, TOPO_NAMES[pl->topo]);
+        for (size_t m = 0; m < NUM_TOPO_METRICS; m++) {
+            double v;
+            if (find_metric(label, TOPO_METRICS[m].backend, TOPO_METRICS[m].latency, &v) == 0) {
+                printf(" %14.3f", v);
+                sum[pl->topo][m] += v;
+                cnt[pl->topo][m]++;
+            } else {
+                printf(" %14s", "-");
+            }
+        }
+        printf("\n");
+    }
+
+    printf("  --- 分類ごとの平均 ---\n");
+    for (int c = 0; c < TOPO_NUM_CLASSES; c++) {
+        int have = 0;
+        for (size_t m = 0; m < NUM_TOPO_METRICS; m++)
+            have |= cnt[c][m] > 0;
+        if (!have)
+            continue;
+        printf("  %-12s %-7s", "mean", TOPO_NAMES[c]);
+        for (size_t m = 0; m < NUM_TOPO_METRICS; m++) {
+            if (cnt[c][m] > 0)
+                printf(" %14.3f", sum[c][m] / cnt[c][m]);
+            else
+                printf(" %14s", "-");
+        }
+        printf("  (%s)\n", TOPO_DESCS[c]);
+    }
+}
+
+/*
+ * 背景負荷の影響: 主要な方式について、負荷ありの各結果を同じ配置・
+ * サイズ・スレッド数の負荷なしの結果と比べる (帯域と中央値レイテンシ)
+ */
+static const char *const NOISE_METRICS[] = { "xpmem-cpy", "xpmem-dir", "SHM-cpy" };
+#define NUM_NOISE_METRICS (sizeof(NOISE_METRICS) / sizeof(NOISE_METRICS[0]))
+
+/* backend, size, threads, placement が一致する結果の行番号。無ければ -1 */
+static int find_result(const char *backend, const char *size, const char *threads,
+                       const char *placement)
+{
+    for (int i = 0; i < g_num_results; i++) {
+        char be[64], sz[32], th[16], pl[128];
+        if (result_field(g_results[i], "backend", be, sizeof(be)) ||
+            result_field(g_results[i], "size", sz, sizeof(sz)) ||
+            result_field(g_results[i], "threads", th, sizeof(th)) ||
+            result_field(g_results[i], "placement", pl, sizeof(pl)))
+            continue;
+        if (strcmp(be, backend) == 0 && strcmp(sz, size) == 0 &&
+            strcmp(th, threads) == 0 && strcmp(pl, placement) == 0)
+            return i;
+    }
+    return -1;
+}
+
+static double result_value(int i, const char *key)
+{
+    char v[32];
+    return result_field(g_results[i], key, v, sizeof(v)) == 0 ? atof(v) : 0;
+}
+
+static void print_noise_report(const driver_opts_t *o)
+{
+    if (o->num_noise == 0)
+        return;
+
+    printf("\n========================================\n");
+    printf("  背景負荷の影響 (負荷なしとの比較, diff は変化率)\n");
+    printf("========================================\n");
+    for (int s = 0; s < o->num_noise; s++) {
+        const noise_spec_t *ns = &o->noise[s];
+        char suffix[64];
+        snprintf(suffix, sizeof(suffix), "+%s", ns->label);
+        printf("--- %s (%s, %d スレッド, ", ns->label, ns->mode, ns->threads);
+        if (ns->mbps > 0)
+            printf("%ld MB/s/スレッド) ---\n", ns->mbps);
+        else
+            printf("無制限) ---\n");
+        printf("  %-14s %-10s %10s %9s %9s %7s %11s %11s %7s\n",
+               "placement", "backend", "size", "GB/s", "noisy", "diff%",
+               "median us", "noisy", "diff%");
+
+        for (int i = 0; i < g_num_results; i++) {
+            char be[64], sz[32], th[16], pl[128], sizebuf[64];
+            if (result_field(g_results[i], "backend", be, sizeof(be)) ||
+                result_field(g_results[i], "size", sz, sizeof(sz)) ||
+                result_field(g_results[i], "threads", th, sizeof(th)) ||
+                result_field(g_results[i], "placement", pl, sizeof(pl)))
+                continue;
+            size_t pl_len = strlen(pl), suf_len = strlen(suffix);
+            if (pl_len <= suf_len || strcmp(pl + pl_len - suf_len, suffix) != 0)
+                continue;
+            int want = 0;
+            for (size_t m = 0; m < NUM_NOISE_METRICS; m++)
+                want |= strcmp(be, NOISE_METRICS[m]) == 0;
+            if (!want)
+                continue;
+
+            pl[pl_len - suf_len] = '\0';
+            int base = find_result(be, sz, th, pl);
+            if (base < 0)
+                continue;
+            double bw0 = result_value(base, "gbps"), bw = result_value(i, "gbps");
+            double us0 = result_value(base, "median_us"), us = result_value(i, "median_us");
+            printf("  %-14s %-10s %10s %9.2f %9.2f %+6.1f%% %11.3f %11.3f %+6.1f%%\n",
+                   pl, be, format_size((size_t)atoll(sz), sizebuf, sizeof(sizebuf)),
+                   bw0, bw, bw0 > 0 ? (bw / bw0 - 1) * 100 : 0.0,
+                   us0, us, us0 > 0 ? (us / us0 - 1) * 100 : 0.0);
+        }
+    }
+}
+
+/* ========== 引数処理 ========== */
+
+static int parse_placements(driver_opts_t *o, const char *arg)
+{
+    char *dup = strdup(arg), *save = NULL;
+    for (char *tok = strtok_r(dup, ",", &save); tok; tok = strtok_r(NULL, ",", &save)) {
+        int e, i;
+        if (sscanf(tok, "%d:%d", &e, &i) != 2) {
+            fprintf(stderr, "配置の形式が不正: %s (E:I)\n", tok);
+            free(dup);
+            return -1;
+        }
+        if (o->num_placements >= MAX_PLACEMENTS)
+            break;
+        o->placements[o->num_placements].exporter_cpu = e;
+        o->placements[o->num_placements].importer_cpu = i;
+        o->placements[o->num_placements].topo = -1;
+        o->num_placements++;
+    }
+    free(dup);
+    return 0;
+}
+
+/* 分類ごとに最大 per_class 組 (0 なら全て) の CPU の組を配置に加える */
+static void add_topology_placements(driver_opts_t *o, int per_class)
+{
+    int count[TOPO_NUM_CLASSES] = {0};
+    for (int a = 0; a < o->num_cpus; a++) {
+        if (!o->topo[a].online)
+            continue;
+        for (int b = a + 1; b < o->num_cpus; b++) {
+            if (!o->topo[b].online)
+                continue;
+            int cls = topo_classify(o->topo, a, b);
+            if (per_class > 0 && count[cls] >= per_class)
+                continue;
+            if (o->num_placements >= MAX_PLACEMENTS)
+                return;
+            placement_t *pl = &o->placements[o->num_placements++];
+            pl->exporter_cpu = a;
+            pl->importer_cpu = b;
+            pl->topo = cls;
+            count[cls]++;
+        }
+    }
+    for (int c = 0; c < TOPO_NUM_CLASSES; c++)
+        printf("トポロジ %-6s (%s): %d 組\n", TOPO_NAMES[c], TOPO_DESCS[c], count[c]);
+}
+
+/* モード:スレッド数[:MB/s] のリストを読む */
+static int parse_noise(driver_opts_t *o, const char *arg)
+{
+    char *dup = strdup(arg), *save = NULL;
+    for (char *tok = strtok_r(dup, ",", &save); tok; tok = strtok_r(NULL, ",", &save)) {
+        noise_spec_t ns = { .threads = 1 };
+        int n = sscanf(tok, "%7[a-z]:%d:%ld", ns.mode, &ns.threads, &ns.mbps);
+        if (n < 2 || ns.threads < 1 || ns.mbps < 0 ||
+            (strcmp(ns.mode, "read") != 0 && strcmp(ns.mode, "write") != 0 &&
+             strcmp(ns.mode, "rand") != 0)) {
+            fprintf(stderr, "背景負荷の形式が不正: %s (read|write|rand:スレッド数[:MB/s])\n", tok);
+            free(dup);
+            return -1;
+        }
+        if (o->num_noise >= MAX_NOISE)
+            break;
+        if (ns.mbps > 0)
+            snprintf(ns.label, sizeof(ns.label), "%s%dt-%ldM", ns.mode, ns.threads, ns.mbps);
+        else
+            snprintf(ns.label, sizeof(ns.label), "%s%dt", ns.mode, ns.threads);
+        o->noise[o->num_noise++] = ns;
+    }
+    free(dup);
+    return 0;
+}
+
+static int backend_selected(const char *list, const char *name)
+{
+    if (!list)
+        return 1;
+    size_t n = strlen(name);
+    for (const char *p = list; *p; ) {
+        size_t len = strcspn(p, ",");
+        if (len == n && strncmp(p, name, n) == 0)
+            return 1;
+        p += len;
+        if (*p == ',') p++;
+    }
+    return 0;
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr, "使い方: %s [-s 最大サイズ(MB)] [-p E:I[,E:I...]] [-t 組数] "
+            "[-n 負荷[,...]] [-b バックエンド[,...]] [-l]\n", prog);
+}
+
+int main(int argc, char *argv[])
+{
+    static driver_opts_t opts;
+    const char *backend_list = NULL;
+    int topo_pairs = -1;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "s:p:t:n:b:lh")) != -1) {
+        switch (opt) {
+        case 's':
+            opts.max_mb = atol(optarg);
+            break;
+        case 'p':
+            if (parse_placements(&opts, optarg) != 0)
+                return 1;
+            break;
+        case 't':
+            topo_pairs = atoi(optarg);
+            break;
+        case 'n':
+            if (parse_noise(&opts, optarg) != 0)
+                return 1;
+            break;
+        case 'b':
+            backend_list = optarg;
+            break;
+        case 'l':
+            for (size_t i = 0; i < NUM_BACKENDS; i++)
+                printf("  %-8s %s\n", BACKENDS[i].name, BACKENDS[i].desc);
+            return 0;
+        default:
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    /* 子プロセスの実行ファイルは自身と同じディレクトリから探す */
+    ssize_t n = readlink("/proc/self/exe", opts.bin_dir, sizeof(opts.bin_dir) - 1);
+    if (n <= 0) {
+        perror("readlink /proc/self/exe");
+        return 1;
+    }
+    opts.bin_dir[n] = '\0';
+    char *slash = strrchr(opts.bin_dir, '/');
+    if (slash)
+        *slash = '\0';
+
+    printf("=== xpmem 統合ベンチマークドライバ ===\n");
+
+    /* -p で指定した組もトポロジで分類しておく */
+    opts.num_cpus = topo_load(opts.topo, TOPO_MAX_CPUS);
+    for (int p = 0; p < opts.num_placements; p++) {
+        placement_t *pl = &opts.placements[p];
+        if (pl->exporter_cpu >= 0 && pl->exporter_cpu < opts.num_cpus &&
+            pl->importer_cpu >= 0 && pl->importer_cpu < opts.num_cpus &&
+            pl->exporter_cpu != pl->importer_cpu)
+            pl->topo = topo_classify(opts.topo, pl->exporter_cpu, pl->importer_cpu);
+    }
+    if (topo_pairs >= 0)
+        add_topology_placements(&opts, topo_pairs);
+
+    if (opts.num_placements == 0) {
+        opts.placements[0].exporter_cpu = -1;
+        opts.placements[0].importer_cpu = -1;
+        opts.placements[0].topo = -1;
+        opts.num_placements = 1;
+    }
+
+    printf("配置: %d 通り\n", opts.num_placements);
+    if (opts.num_noise > 0)
+        printf("背景負荷: 負荷なし + %d 条件\n", opts.num_noise);
+
+    int failures = 0;
+    double t0 = get_time_sec();
+
+    /* s = -1 が負荷なし、以降が -n の各条件 */
+    for (int s = -1; s < opts.num_noise; s++) {
+        pid_t noise_pid = -1;
+        FILE *noise_out = NULL;
+        if (s >= 0) {
+            printf("\n##### 背景負荷 %s #####\n", opts.noise[s].label);
+            fflush(stdout);
+            noise_pid = start_noise(&opts, &opts.noise[s], &noise_out);
+            if (noise_pid < 0) {
+                failures++;
+                continue;
+            }
+            setenv(ENV_NOISE_LABEL, opts.noise[s].label, 1);
+        }
+
+        for (int p = 0; p < opts.num_placements; p++) {
+            const placement_t *pl = &opts.placements[p];
+            for (size_t b = 0; b < NUM_BACKENDS; b++) {
+                if (BACKENDS[b].once || !backend_selected(backend_list, BACKENDS[b].name))
+                    continue;
+                printf("\n##### [%s] exporter CPU %d / importer CPU %d #####\n",
+                       BACKENDS[b].name, pl->exporter_cpu, pl->importer_cpu);
+                fflush(stdout);
+                if (BACKENDS[b].run(&opts, pl) != 0)
+                    failures++;
+            }
+        }
+
+        if (noise_pid >= 0) {
+            unsetenv(ENV_NOISE_LABEL);
+            if (stop_noise(noise_pid, noise_out) != 0)
+                failures++;
+        }
+    }
+
+    /*
+     * 結果が配置によらないもの (stream のルーフライン、組ごとに自分で CPU を
+     * 固定する c2c) は配置・背景負荷ごとに繰り返さず、負荷なしで1回だけ測る
+     */
+    static const placement_t unpinned = { -1, -1, -1 };
+    for (size_t b = 0; b < NUM_BACKENDS; b++) {
+        if (!BACKENDS[b].once || !backend_selected(backend_list, BACKENDS[b].name))
+            continue;
+        printf("\n##### [%s] (配置によらず1回) #####\n", BACKENDS[b].name);
+        fflush(stdout);
+        if (BACKENDS[b].run(&opts, &unpinned) != 0)
+            failures++;
+    }
+
+    print_report();
+    print_topology_matrix(&opts);
+    print_noise_report(&opts);
+    printf("\n所要時間: %.1f 秒, 失敗: %d\n", get_time_sec() - t0, failures);
+
+    for (int i = 0; i < g_num_results; i++)
+        free(g_results[i]);
+    return failures ? 1 : 0;
+}
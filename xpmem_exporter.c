@@ -2,20 +2,36 @@
  * xpmem_exporter.c - XPMEM メモリエクスポータ (サーバ側)
  *
  * このプロセスは:
- * 1. 大容量メモリ領域を確保し、検証パターンで埋める
+ * 1. 大容量メモリ領域を確保し、複数スレッドでプリフォルトして検証パターンで埋める
+ *    (seg_init.h。BENCH_INIT_LAZY=1 なら公開後に裏で行う)
+ *    後ろに補助領域を付け、アリーナとしてオブジェクトを確保・公開する
  * 2. xpmem_make() でメモリ領域を公開する
- * 3. セグメントIDをファイル経由でインポータに通知する
+ * 3. セグメントを名前付きレジストリ (seg_registry.h) に登録してインポータに知らせる
+ *    (xpmem_bench から起動された場合は継承したソケット経由)
  * 4. インポータがコピーを完了するまで待機する
+ *    (その間、差分同期ベンチマークの書き換え依頼と seqlock ベンチマークの
+ *     連続書き込み、ソークのピンポン・リング転送の相手役をサービススレッドで行う)
+ * 5. 完了後にアリーナ確保・レジストリのマイクロベンチマークを行う
+ *    (公開を遅らせず、インポータの計測とも重ならないように)
  *
  * 使い方:
  *   ./xpmem_exporter [最大テストサイズ(MB)]
+ *   BENCH_SEG_NAME=name で登録名を変えると、1ホストで複数のエクスポータを並べられる
  *
  * コンパイル:
  *   gcc -O2 -o xpmem_exporter xpmem_exporter.c -lxpmem -lrt
  */
 
 #include <xpmem.h>
+#include <pthread.h>
 #include "common.h"
+#include "seg_arena.h"
+#include "seg_extent.h"
+#include "seg_init.h"
+#include "seg_registry.h"
+#include "seg_soak.h"
+#include "seg_sync.h"
+#include "shm_containers.h"
 
 static volatile int g_running = 1;
 
@@ -25,8 +41,230 @@ static void sigint_handler(int sig)
     g_running = 0;
 }
 
+/*
+ * アリーナの確保スループット計測
+ * 1サンプル = 可変長オブジェクトを ARENA_BATCH 個確保 (計測) → 全解放 (計測外)
+ */
+#define ARENA_BATCH 4096
+
+typedef struct {
+    arena_header_t *arena;
+    const uint32_t *sizes;
+    arena_handle_t handles[ARENA_BATCH];
+} arena_alloc_arg_t;
+
+static void op_arena_alloc(void *arg)
+{
+    arena_alloc_arg_t *a = (arena_alloc_arg_t *)arg;
+    for (int i = 0; i < ARENA_BATCH; i++)
+        a->handles[i] = arena_alloc(a->arena, a->sizes[i]);
+}
+
+static void arena_free_batch(arena_alloc_arg_t *a)
+{
+    for (int i = 0; i < ARENA_BATCH; i++)
+        arena_free(a->arena, a->handles[i], a->sizes[i]);
+}
+
+static void bench_arena_alloc(arena_header_t *arena)
+{
+    printf("\n--- アリーナ確保ベンチマーク ---\n");
+    printf("  (%d 個の可変長オブジェクト 16〜512 B を確保、帯域は確保したバイト数から)\n\n",
+           ARENA_BATCH);
+
+    static arena_alloc_arg_t arg;
+    static uint32_t sizes[ARENA_BATCH];
+    uint64_t rng = 0x9E3779B97F4A7C15ULL;
+    size_t total = 0;
+    for (int i = 0; i < ARENA_BATCH; i++) {
+        sizes[i] = (uint32_t)(sizeof(arena_obj_t) + 16 + xorshift64(&rng) % 497);
+        total += sizes[i];
+    }
+    arg.arena = arena;
+    arg.sizes = sizes;
+
+    stats_phase("ARENA-alloc", total);
+
+    /* 初回でスラブが切り出され、以降はフリーリストの再利用になる */
+    for (int w = 0; w < g_cfg.warmup + 1; w++) {
+        op_arena_alloc(&arg);
+        arena_free_batch(&arg);
+    }
+
+    sample_set_t ss;
+    samples_init(&ss);
+    while (!samples_done(&ss)) {
+        double t = time_op(op_arena_alloc, &arg, 1);
+        arena_free_batch(&arg);
+        samples_add(&ss, t);
+    }
+
+    print_summary("ARENA-alloc", total, ss.v, ss.n);
+    sample_stats_t st;
+    compute_stats(ss.v, ss.n, &st);
+    printf("  [ARENA-alloc] %.2f ns/alloc, %.2f Malloc/s (中央値)\n\n",
+           st.median / ARENA_BATCH * 1e9, ARENA_BATCH / st.median * 1e-6);
+    samples_free(&ss);
+}
+
+/*
+ * インポータが辿るオブジェクトの連結リストを作って "objlist" として公開する。
+ * data[i] = (seq + i) & 0xFF で、インポータが検証できる。
+ */
+static int publish_object_list(arena_header_t *arena, long nobjs)
+{
+    uint64_t rng = 0x243F6A8885A308D3ULL;
+    arena_handle_t head = 0, *link = &head;
+    size_t bytes = 0;
+
+    for (long i = 0; i < nobjs; i++) {
+        uint32_t len = (uint32_t)(16 + xorshift64(&rng) % 497);
+        arena_handle_t h = arena_alloc(arena, sizeof(arena_obj_t) + len);
+        if (!h) {
+            fprintf(stderr, "アリーナ不足: %ld 個目で確保失敗\n", i);
+            return -1;
+        }
+        arena_obj_t *o = (arena_obj_t *)arena_ptr(arena, h);
+        o->next = 0;
+        o->len = len;
+        o->seq = (uint32_t)i;
+        for (uint32_t k = 0; k < len; k++)
+            o->data[k] = (uint8_t)(i + k);
+        *link = h;
+        link = &o->next;
+        bytes += len;
+    }
+    arena_publish(arena, "objlist", head);
+
+    char sizebuf[64];
+    printf("オブジェクト公開: %ld 個, ペイロード %s\n", nobjs,
+           format_size(bytes, sizebuf, sizeof(sizebuf)));
+    return 0;
+}
+
+/* キー一覧ベクタとハッシュマップを持つテーブルを構築し "table" として公開する */
+static int publish_table(arena_header_t *arena, long entries)
+{
+    arena_handle_t h = arena_alloc(arena, shm_table_bytes(entries));
+    if (!h) {
+        fprintf(stderr, "アリーナ不足: テーブル (%ld エントリ) を確保できません\n", entries);
+        return -1;
+    }
+    shm_table_t *t = shm_table_build(arena_ptr(arena, h), entries, 1);
+    arena_publish(arena, "table", h);
+
+    char sizebuf[64];
+    printf("テーブル公開: %ld エントリ, %s\n", entries,
+           format_size(t->bytes, sizebuf, sizeof(sizebuf)));
+    return 0;
+}
+
+/*
+ * サービススレッド: 差分同期の書き換え依頼を処理し、seqlock ベンチマーク中は
+ * インポータが指定した回数/秒で領域を順に書き換え続ける。
+ * ソークでピンポン・リングが指定されている間はその相手役に専念する
+ */
+typedef struct {
+    const void *arena;
+    sync_ctl_t *sync;
+    seq_ctl_t *seq;
+    soak_ctl_t *soak;
+    void *data;
+} service_arg_t;
+
+static void *service_thread(void *arg)
+{
+    service_arg_t *s = (service_arg_t *)arg;
+    uint64_t rng = 0x9E3779B97F4A7C15ULL;
+    uint64_t next_region = 0, deadline = 0;
+    unsigned idle = 0;
+
+    for (;;) {
+        if (!g_running || (s->sync && atomic_load_explicit(&s->sync->stop,
+                                                           memory_order_acquire)))
+            break;
+        if (s->soak && atomic_load(&s->soak->mode) != SOAK_IDLE) {
+            soak_serve(s->soak, s->data);
+            continue;
+        }
+        int busy = s->sync && sync_service_step(s->arena, s->sync, s->data, &rng);
+        if (busy)
+            stats_add(1, s->sync->dirtied * SYNC_PAGE_SIZE);
+
+        int64_t rate = s->seq ? atomic_load(&s->seq->rate) : 0;
+        if (rate != 0) {
+            /*
+             * 指定レートなら締め切りまで待つ (遅れは最大1ms分だけ取り戻す)。
+             * 読み手の計測を乱さないよう、50us より先なら眠り (停止依頼に応じられる
+             * よう最大1ms ずつ)、残りだけ回る
+             */
+            uint64_t now = clock_raw_ns();
+            if (rate > 0 && now < deadline) {
+                uint64_t gap = deadline - now;
+                if (gap > 50000) {
+                    gap -= 50000;
+                    struct timespec ts = { 0, (long)(gap < 1000000 ? gap : 1000000) };
+                    nanosleep(&ts, NULL);
+                } else {
+                    cpu_relax();
+                }
+                continue;
+            }
+            if (!seq_writer_step(s->arena, s->seq, s->data, &next_region))
+                continue;
+            stats_add(1, s->seq->region);
+            if (rate > 0) {
+                uint64_t interval = 1000000000ULL / (uint64_t)rate;
+                deadline = (deadline + 1000000 < now) ? now + interval : deadline + interval;
+            }
+            continue;
+        }
+        if (!busy) {
+            /* 暇なときに時々ページフォルト数を共有統計ページへ */
+            if (++idle % 4096 == 0)
+                stats_faults();
+            usleep(20);
+        }
+    }
+    return NULL;
+}
+
+static void service_stop(pthread_t tid, sync_ctl_t *sync, soak_ctl_t *soak)
+{
+    /* インポータが途中で終わってもソークの相手役から抜けさせる */
+    if (soak)
+        atomic_store(&soak->mode, SOAK_IDLE);
+    atomic_store_explicit(&sync->stop, 1, memory_order_release);
+    pthread_join(tid, NULL);
+}
+
+/* 起動から準備完了までの時間 (1回の値) を結果行として出す */
+static void report_ready(const char *label, size_t size, double sec)
+{
+    sample_stats_t st;
+    compute_stats(&sec, 1, &st);
+    st.ci95 = 0;    /* 1回だけの値なので区間は無い (inf だと比較で扱えない) */
+    printf("  [%s] %.3f 秒\n", label, sec);
+    print_result_record(label, size, &st);
+}
+
+/* インポータに知らせた直後: 公開までの時間を出し、遅延公開なら裏で初期化を始める */
+static void publish_ready(seg_init_t *init, init_ctl_t *init_ctl, size_t seg_size)
+{
+    printf("\n--- 準備完了までの時間 (起動から) ---\n");
+    report_ready("EXP-ready", seg_size, get_time_sec() - init->start);
+    if (!init_ctl) {
+        report_ready("EXP-data-ready", seg_size, init->ready_sec);
+    } else if (seg_init_start(init, init_ctl) != 0) {
+        perror("pthread_create (公開後の初期化はその場で実行)");
+    }
+    printf("\n");
+}
+
 int main(int argc, char *argv[])
 {
+    double t_start = get_time_sec();
+
     /* 最大テストサイズの決定 */
     size_t max_size = TEST_SIZES[NUM_TEST_SIZES - 1];
     if (argc > 1) {
@@ -34,76 +272,201 @@ int main(int argc, char *argv[])
     }
 
     char sizebuf[64];
+    int sock = inherited_sock_fd();
+    int cpu = pin_from_env(ENV_EXPORTER_CPU);
+    const char *seg_name = seg_name_from_env();
+
     printf("=== xpmem Exporter ===\n");
     printf("PID: %d\n", getpid());
+    if (cpu >= 0)
+        printf("CPU: %d に固定\n", cpu);
     printf("最大テストサイズ: %s\n", format_size(max_size, sizebuf, sizeof(sizebuf)));
 
     /* シグナルハンドラ設定 */
     signal(SIGINT, sigint_handler);  /* Ctrl + C */
 
     /* 同期ファイルのクリーンアップ */
-    cleanup_sync_files();
+    if (sock < 0)
+        cleanup_sync_files(seg_name);
+
+    bench_config_load();
+    timer_calibrate();
+    stats_open("exporter");
+
+    /* データ領域の後ろに補助領域 (アリーナ) を付けて一緒に公開する */
+    size_t aux_offset = max_size;
+    size_t aux_size = (size_t)env_long("BENCH_ARENA_MB", DEFAULT_ARENA_MB) * 1024UL * 1024;
+    size_t seg_size = max_size + aux_size;
 
-    /* ページアラインドメモリの確保 */
+    /* ゼロ初期化済みのページアラインドメモリの確保 (ページはまだ割り当てない) */
     printf("メモリ確保中...\n");
-    void *shared_buf = alloc_aligned(max_size);
-    if (!shared_buf) {
-        fprintf(stderr, "メモリ確保失敗: %s\n", format_size(max_size, sizebuf, sizeof(sizebuf)));
+    void *shared_buf = mmap(NULL, seg_size, PROT_READ | PROT_WRITE,
+                            MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (shared_buf == MAP_FAILED) {
+        fprintf(stderr, "メモリ確保失敗: %s\n", format_size(seg_size, sizebuf, sizeof(sizebuf)));
         return 1;
     }
 
-    /* ページフォルトを事前に発生させる (メモリを実際に確保) */
-    printf("メモリ初期化中 (ページフォルト解消)...\n");
-    memset(shared_buf, 0, max_size);
+    /*
+     * プリフォルトと検証パターンの書き込みを複数スレッドで行う。
+     * 遅延公開ではデータ領域だけを公開後に裏で初期化する
+     */
+    int lazy = env_long("BENCH_INIT_LAZY", 0) != 0;
+    static seg_init_t init;
+    seg_init_setup(&init, shared_buf, lazy ? max_size : seg_size, max_size,
+                   env_long("BENCH_INIT_THREADS", 0), t_start);
+    if (!lazy) {
+        printf("メモリ初期化中 (プリフォルト + テストパターン)...\n");
+        stats_phase("init", 0);
+        seg_init_run(&init);
+        seg_init_report(&init);
+    }
+
+    /* アリーナの初期化、オブジェクトの公開 */
+    arena_header_t *arena = NULL;
+    sync_ctl_t *sync_ctl = NULL;
+    seq_ctl_t *seq_ctl = NULL;
+    soak_ctl_t *soak_ctl = NULL;
+    init_ctl_t *init_ctl = NULL;
+    if (aux_size > 0) {
+        printf("アリーナ: %s\n", format_size(aux_size, sizebuf, sizeof(sizebuf)));
+        arena = arena_init((char *)shared_buf + aux_offset, aux_size);
+        /* バージョン表・シーケンス番号は大きいので先に確保する */
+        sync_ctl = sync_ctl_create(arena, max_size);
+        seq_ctl = seq_ctl_create(arena, max_size);
+        soak_ctl = soak_ctl_create(arena);
+        if (env_long("BENCH_EXT_PVM", 0) && !seg_base_create(arena, shared_buf))
+            fprintf(stderr, "アリーナ不足: データ領域の番地を公開できません\n");
+        if (lazy)
+            init_ctl = init_ctl_create(arena);
+        if (!sync_ctl || !seq_ctl)
+            fprintf(stderr, "アリーナ不足: バージョン表を確保できません\n");
+        if (lazy && !init_ctl)
+            fprintf(stderr, "アリーナ不足: 初期化の完了通知を確保できません\n");
+        publish_object_list(arena, env_long("BENCH_ARENA_OBJS", DEFAULT_ARENA_OBJS));
+        publish_table(arena, env_long("BENCH_TBL_ENTRIES", DEFAULT_TBL_ENTRIES));
+    }
 
-    /* インポータにコピーする検証パターンの書き込み */
-    printf("テストパターン書き込み中...\n");
-    fill_pattern(shared_buf, max_size);
+    /* 完了を知らせる場所が無ければ遅延公開はしない */
+    if (lazy && !init_ctl) {
+        printf("遅延公開できないため、公開前に初期化します\n");
+        lazy = 0;
+        seg_init_run(&init);
+        seg_init_report(&init);
+    }
 
     /* xpmem セグメントの作成 (エクスポート) */
     printf("xpmem セグメント作成中...\n");
-    xpmem_segid_t segid = xpmem_make(shared_buf, max_size,
+    xpmem_segid_t segid = xpmem_make(shared_buf, seg_size,
                                       XPMEM_PERMIT_MODE, (void *)0666);
     if (segid == -1) {
         perror("xpmem_make 失敗");
         fprintf(stderr, "\n/dev/xpmem が存在するか確認してください:\n");
         fprintf(stderr, "  ls -la /dev/xpmem\n");
         fprintf(stderr, "  sudo insmod /usr/local/lib/modules/$(uname -r)/xpmem.ko\n");
-        free(shared_buf);
+        munmap(shared_buf, seg_size);
         return 1;
     }
 
     printf("セグメントID: %lld\n", (long long)segid);
 
-    /* セグメントIDをファイルに書き出し */
-    FILE *fp = fopen(SEGID_FILE, "w");
-    if (!fp) {
-        perror("セグメントIDファイル書き込み失敗");
-        xpmem_remove(segid);
-        free(shared_buf);
-        return 1;
-    }
-    fprintf(fp, "%lld\n%zu\n%d\n", (long long)segid, max_size, getpid());
-    fclose(fp);
+    /* 差分同期・seqlock ベンチマーク、ソークの相手役のためのサービススレッド */
+    stats_phase("serve", 0);
+    stats_faults();
+    pthread_t service_tid;
+    service_arg_t service_arg = { arena, sync_ctl, seq_ctl, soak_ctl, shared_buf };
+    int service_running = sync_ctl &&
+        pthread_create(&service_tid, NULL, service_thread, &service_arg) == 0;
+
+    reg_header_t *reg = NULL;
+    reg_info_t reg_info;
 
-    /* インポータに準備完了を通知 */
-    signal_file(READY_FILE);
-    printf("インポータ待機中... (Ctrl+C で終了)\n\n");
+    if (sock >= 0) {
+        /* ドライバ経由: ソケットでセグメント情報を渡し、完了 (または切断) を待つ */
+        seg_handle_msg_t msg = { (long long)segid, max_size, getpid(),
+                                 aux_offset, aux_size };
+        if (sock_send_all(sock, &msg, sizeof(msg)) != 0) {
+            perror("セグメント情報の送信失敗");
+            if (service_running)
+                service_stop(service_tid, sync_ctl, soak_ctl);
+            xpmem_remove(segid);
+            munmap(shared_buf, seg_size);
+            return 1;
+        }
+        publish_ready(&init, init_ctl, seg_size);
+        printf("インポータ待機中...\n\n");
+        fflush(stdout);
 
-    /* インポータの完了待ち */
-    while (g_running) {
-        if (access(DONE_FILE, F_OK) == 0) {
+        char done;
+        if (sock_recv_all(sock, &done, 1) == 0)
             printf("\nインポータからの完了通知を受信\n");
-            break;
+        close(sock);
+    } else {
+        /* レジストリに名前で登録する (インポータはこれを待っている) */
+        reg = reg_open(reg_default_name(), 1, REG_DEFAULT_SLOTS);
+        memset(&reg_info, 0, sizeof(reg_info));
+        snprintf(reg_info.name, sizeof(reg_info.name), "%s", seg_name);
+        reg_info.segid = (long long)segid;
+        reg_info.size = max_size;
+        reg_info.aux_offset = aux_offset;
+        reg_info.aux_size = aux_size;
+        reg_info.pid = getpid();
+        /* 遅延公開ではまだページが無いので、初期化スレッドを固定したノードを記録する */
+        reg_info.node = lazy ? init.node : reg_node_of(shared_buf);
+        if (!reg || !reg_publish(reg, &reg_info)) {
+            fprintf(stderr, "レジストリ %s に登録できません\n", reg_default_name());
+            reg_close(reg);
+            if (service_running)
+                service_stop(service_tid, sync_ctl, soak_ctl);
+            xpmem_remove(segid);
+            munmap(shared_buf, seg_size);
+            return 1;
         }
-        usleep(100000); /* 100ms */
+        printf("レジストリ登録: \"%s\" (世代 %lu, NUMA ノード %d)\n", reg_info.name,
+               (unsigned long)reg_info.generation, (int)reg_info.node);
+        publish_ready(&init, init_ctl, seg_size);
+        printf("インポータ待機中... (Ctrl+C で終了)\n\n");
+
+        /* インポータの完了待ち */
+        char done_path[256];
+        done_file_path(seg_name, done_path, sizeof(done_path));
+        while (g_running) {
+            if (access(done_path, F_OK) == 0) {
+                printf("\nインポータからの完了通知を受信\n");
+                break;
+            }
+            usleep(100000); /* 100ms */
+        }
+    }
+
+    if (service_running)
+        service_stop(service_tid, sync_ctl, soak_ctl);
+
+    if (lazy) {
+        /* 裏で進めた初期化の結果 */
+        seg_init_join(&init);
+        seg_init_report(&init);
+        report_ready("EXP-data-ready", seg_size, init.ready_sec);
+    }
+
+    /* アリーナの確保性能と名前付きレジストリのルックアップ性能 (一時レジストリで計測) */
+    if (g_running) {
+        if (arena)
+            bench_arena_alloc(arena);
+        bench_registry(env_long("BENCH_REG_ENTRIES", DEFAULT_REG_ENTRIES));
     }
 
     /* クリーンアップ */
     printf("クリーンアップ中...\n");
+    if (reg) {
+        /* 他のエクスポータに置き換えられていれば消さない */
+        reg_remove(reg, seg_name, reg_info.generation);
+        reg_close(reg);
+    }
     xpmem_remove(segid);
-    free(shared_buf);
-    cleanup_sync_files();
+    munmap(shared_buf, seg_size);
+    if (sock < 0)
+        cleanup_sync_files(seg_name);
 
     printf("エクスポータ終了\n");
     return 0;
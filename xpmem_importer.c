@@ -2,14 +2,27 @@
  * xpmem_importer.c - xpmem メモリインポータ (クライアント側) + ベンチマーク
  *
  * このプロセスは:
- * 1. エクスポータからセグメントIDを取得する
+ * 1. 名前付きレジストリ (seg_registry.h) からセグメント情報を引く
+ *    (xpmem_bench から起動された場合は継承したソケット経由)
  * 2. xpmem_get() + xpmem_attach() でメモリをマッピングする
  * 3. 各サイズで memcpy による転送速度を計測する
  * 4. データの整合性を検証する
  * 5. xpmem直接アクセス (ゼロコピー) の速度も計測する
+ * 6. エクスポータがアリーナに公開したオブジェクトをハンドル解決で辿る
+ * 7. 公開されたハッシュテーブルを直接参照する場合とコピーして使う場合を比べる
+ * 8. xpmem_get() + xpmem_attach() による受け渡し自体のコストを計測する
+ * 9. エクスポータが一部のページを書き換えた後の差分同期と全体コピーを比べる
+ * 10. エクスポータが書き換え続ける中で seqlock によるスナップショットを取る
+ * 11. ソフトウェアプリフェッチの先読み距離をスイープする
+ * 12. コピーと同時に CRC32C / xxHash64 を計算するコストを計測する
+ * 13. 不連続な extent のリストを詰めたバッファへ集める (gather) / 撒く (scatter)
+ *     コストを memcpy ループ・複数スレッド・process_vm_readv/writev で比べる
+ * BENCH_SOAK を指定した場合は、上の計測の代わりに選んだ負荷を長時間回し、
+ * 区間ごとの時系列を出力する (ソークモード)
  *
  * 使い方:
  *   ./xpmem_importer
+ *   BENCH_SEG_NAME=name で引くセグメントを選ぶ (エクスポータと同じ名前)
  *
  * コンパイル:
  *   gcc -O2 -o xpmem_importer xpmem_importer.c -lxpmem -lrt
@@ -17,6 +30,20 @@
 
 #include <xpmem.h>
 #include "common.h"
+#include "buf_pool.h"
+#include "kernels.h"
+#include "perf_counters.h"
+#include "seg_arena.h"
+#include "seg_extent.h"
+#include "seg_init.h"
+#include "seg_registry.h"
+#include "seg_soak.h"
+#include "seg_sync.h"
+#include "shm_containers.h"
+#include "table_bench.h"
+
+/* 全ベンチマークで共有するカウンタグループ */
+static perf_group_t g_perf;
 
 /*
  * xpmem経由のmemcpyベンチマーク
@@ -26,30 +53,51 @@
 static void bench_xpmem_memcpy(void *attached_ptr, void *local_buf,
                                 size_t max_size)
 {
+    kernel_arg_t op;
+    char method[64];
+    kernel_config_load(&op);
+    kernel_label("xpmem-cpy", &op, method, sizeof(method));
+
     printf("\n--- xpmem memcpy ベンチマーク ---\n");
-    printf("  (リモートプロセスのメモリ → ローカルバッファへ memcpy)\n\n");
+    printf("  (リモートプロセスのメモリ → ローカルバッファへ memcpy)\n");
+    if (op.hint != PF_OFF)
+        printf("  (prefetch%s, 先読み %zu bytes のコピーカーネル)\n",
+               PF_NAMES[op.hint], op.dist);
+    printf("\n");
 
     for (size_t si = 0; si < NUM_TEST_SIZES; si++) {
         size_t size = TEST_SIZES[si];
         if (size > max_size) break;
 
-        double times[REPEAT_COUNT];
+        sample_set_t ss;
+        perf_sample_t pc_sum = {0}, pc;
+        op.m = (mem_op_arg_t){ local_buf, attached_ptr, size, 0 };
+        stats_phase(method, size);
 
-        for (int r = 0; r < REPEAT_COUNT; r++) {
-            /* ローカルバッファをクリア (キャッシュ効果を排除) */
-            memset(local_buf, 0, size);
+        /* 小さいサイズではタイマー分解能に埋もれないよう K 回まとめて計測 */
+        int reps = calibrate_inner_reps(op_copy_kernel, &op);
+        printf("  内側ループ: %d 回/サンプル\n", reps);
 
-            /* 計測開始 */
-            double t0 = get_time_sec();
+        /* ウォームアップ (結果は捨てる) */
+        for (int w = 0; w < g_cfg.warmup; w++) {
+            memset(local_buf, 0, size);
+            time_op(op_copy_kernel, &op, reps);
+        }
 
-            /* xpmemマッピングされたメモリからローカルへコピー */
-            memcpy(local_buf, attached_ptr, size);
+        samples_init(&ss);
+        for (int r = 0; !samples_done(&ss); r++) {
+            /* ローカルバッファをクリア (キャッシュ効果を排除) */
+            memset(local_buf, 0, size);
 
-            /* 計測終了 */
-            double t1 = get_time_sec();
-            times[r] = t1 - t0;
+            /* xpmemマッピングされたメモリからローカルへコピー (1回あたりの時間) */
+            perf_group_start(&g_perf);
+            double t = time_op(op_copy_kernel, &op, reps);
+            perf_group_stop(&g_perf, &pc);
+            perf_sample_add(&pc_sum, &pc);
+            samples_add(&ss, t);
 
-            print_result("xpmem-cpy", size, times[r], r + 1);
+            if (r < REPEAT_COUNT)
+                print_result(method, size, t, r + 1);
 
             /* データ検証 (最初の1回だけ) */
             if (r == 0) {
@@ -61,7 +109,9 @@ static void bench_xpmem_memcpy(void *attached_ptr, void *local_buf,
                 }
             }
         }
-        print_summary("xpmem-cpy", size, times, REPEAT_COUNT);
+        print_summary(method, size, ss.v, ss.n);
+        print_perf_summary(method, size, &pc_sum, ss.n * reps);
+        samples_free(&ss);
         printf("\n");
     }
 }
@@ -72,53 +122,65 @@ static void bench_xpmem_memcpy(void *attached_ptr, void *local_buf,
  */
 static void bench_xpmem_direct(void *attached_ptr, size_t max_size)
 {
+    kernel_arg_t op;
+    char method[64];
+    kernel_config_load(&op);
+    kernel_label("xpmem-dir", &op, method, sizeof(method));
+
     printf("\n--- xpmem 直接アクセス (ゼロコピー) ベンチマーク ---\n");
-    printf("  (リモートメモリを直接 load して走査)\n\n");
+    printf("  (リモートメモリを直接 load して走査)\n");
+    if (op.hint != PF_OFF)
+        printf("  (prefetch%s, 先読み %zu bytes の走査カーネル)\n",
+               PF_NAMES[op.hint], op.dist);
+    printf("\n");
 
     for (size_t si = 0; si < NUM_TEST_SIZES; si++) {
         size_t size = TEST_SIZES[si];
         if (size > max_size) break;
 
-        double times[REPEAT_COUNT];
+        sample_set_t ss;
+        perf_sample_t pc_sum = {0}, pc;
+        op.m = (mem_op_arg_t){ NULL, attached_ptr, size, 0 };
+        stats_phase(method, size);
 
-        for (int r = 0; r < REPEAT_COUNT; r++) {
-            volatile uint64_t checksum = 0;
-            const uint64_t *p = (const uint64_t *)attached_ptr;
-            size_t count = size / sizeof(uint64_t);
+        int reps = calibrate_inner_reps(op_scan_kernel, &op);
+        printf("  内側ループ: %d 回/サンプル\n", reps);
 
-            double t0 = get_time_sec();
+        for (int w = 0; w < g_cfg.warmup; w++)
+            time_op(op_scan_kernel, &op, reps);
 
+        samples_init(&ss);
+        for (int r = 0; !samples_done(&ss); r++) {
             /* 直接読み取り (ページフォルトでオンデマンドマッピング) */
-            for (size_t i = 0; i < count; i++) {
-                checksum += p[i];
-            }
-
-            double t1 = get_time_sec();
-            times[r] = t1 - t0;
-
-            print_result("xpmem-dir", size, times[r], r + 1);
+            perf_group_start(&g_perf);
+            double t = time_op(op_scan_kernel, &op, reps);
+            perf_group_stop(&g_perf, &pc);
+            perf_sample_add(&pc_sum, &pc);
+            samples_add(&ss, t);
 
-            /* volatile変数を使い最適化抑制 */
-            (void)checksum;
+            if (r < REPEAT_COUNT)
+                print_result(method, size, t, r + 1);
         }
-        print_summary("xpmem-dir", size, times, REPEAT_COUNT);
+        print_summary(method, size, ss.v, ss.n);
+        print_perf_summary(method, size, &pc_sum, ss.n * reps);
+        samples_free(&ss);
         printf("\n");
     }
 }
 
 /*
  * ローカル memcpy ベンチマーク (基準値)
+ * コピー元は local_buf を使い、コピー先だけをプールから借りる
  */
-static void bench_local_memcpy(size_t max_size)
+static void bench_local_memcpy(void *local_buf, size_t max_size)
 {
     printf("\n--- ローカル memcpy ベンチマーク (基準値) ---\n");
     printf("  (同一プロセス内の memcpy)\n\n");
 
-    void *src = alloc_aligned(max_size);
-    void *dst = alloc_aligned(max_size);
-    if (!src || !dst) {
+    void *src = local_buf;
+    void *dst = pool_get(max_size);
+    if (!dst) {
         fprintf(stderr, "ローカルバッファ確保失敗\n");
-        free(src); free(dst);
         return;
     }
 
@@ -130,59 +192,1160 @@ static void bench_local_memcpy(size_t max_size)
         size_t size = TEST_SIZES[si];
         if (size > max_size) break;
 
-        double times[REPEAT_COUNT];
+        sample_set_t ss;
+        perf_sample_t pc_sum = {0}, pc;
+        mem_op_arg_t op = { dst, src, size, 0 };
+        stats_phase("LOCAL-cpy", size);
 
-        for (int r = 0; r < REPEAT_COUNT; r++) {
+        int reps = calibrate_inner_reps(op_memcpy, &op);
+        printf("  内側ループ: %d 回/サンプル\n", reps);
+
+        for (int w = 0; w < g_cfg.warmup; w++) {
             memset(dst, 0, size);
+            time_op(op_memcpy, &op, reps);
+        }
+
+        samples_init(&ss);
+        for (int r = 0; !samples_done(&ss); r++) {
+            memset(dst, 0, size);
+
+            perf_group_start(&g_perf);
+            double t = time_op(op_memcpy, &op, reps);
+            perf_group_stop(&g_perf, &pc);
+            perf_sample_add(&pc_sum, &pc);
+            samples_add(&ss, t);
+
+            if (r < REPEAT_COUNT)
+                print_result("LOCAL-cpy", size, t, r + 1);
+        }
+        print_summary("LOCAL-cpy", size, ss.v, ss.n);
+        print_perf_summary("LOCAL-cpy", size, &pc_sum, ss.n * reps);
+        samples_free(&ss);
+        printf("\n");
+    }
+
+    pool_put(dst);
+}
+
+/*
+ * ソフトウェアプリフェッチの先読み距離スイープ
+ * 1サイズについて、コピーと直接走査をプリフェッチなし / t0 / nta ×
+ * 距離ごとに計測する。ローカルのページと比べるため、コピーした結果を
+ * 同じカーネルで走査する LOCAL-dir も並べる。
+ * 結果行がメインの memcpy / 直接アクセスと同じキーにならないよう、方式名には
+ * "-pf" を付ける (プリフェッチなしは "-pf0")。プリフェッチなしも t0 / nta と
+ * 同じ1ラインずつのループで測り、比にカーネルの違いが混ざらないようにする
+ */
+#define MAX_PREFETCH_DISTS 16
+
+static double measure_kernel(const char *method, bench_op_fn fn, void *op, size_t size)
+{
+    perf_sample_t pc_sum = {0}, pc;
+
+    stats_phase(method, size);
+    int reps = calibrate_inner_reps(fn, op);
+    for (int w = 0; w < g_cfg.warmup; w++)
+        time_op(fn, op, reps);
+
+    sample_set_t ss;
+    samples_init(&ss);
+    for (int r = 0; !samples_done(&ss); r++) {
+        perf_group_start(&g_perf);
+        double t = time_op(fn, op, reps);
+        perf_group_stop(&g_perf, &pc);
+        perf_sample_add(&pc_sum, &pc);
+        samples_add(&ss, t);
+    }
+    print_summary(method, size, ss.v, ss.n);
+    print_perf_summary(method, size, &pc_sum, ss.n * reps);
+
+    sample_stats_t st;
+    compute_stats(ss.v, ss.n, &st);
+    samples_free(&ss);
+    return st.median;
+}
+
+static void bench_xpmem_prefetch(void *attached_ptr, void *local_buf, size_t max_size)
+{
+    size_t size = (size_t)env_long("BENCH_PREFETCH_MB", DEFAULT_PREFETCH_MB) * 1024UL * 1024;
+    if (size > max_size)
+        size = max_size;
+    long dists[MAX_PREFETCH_DISTS];
+    int ndists = env_long_list("BENCH_PREFETCH_DISTS", DEFAULT_PREFETCH_DISTS,
+                               dists, MAX_PREFETCH_DISTS);
+
+    static const struct {
+        const char *method;
+        int copy;           /* 1: コピー, 0: 走査 */
+        int local;          /* 走査元をローカルバッファにするか */
+        const char *desc;
+    } kinds[] = {
+        { "xpmem-cpy-pf", 1, 0, "リモート → ローカルへのコピー" },
+        { "xpmem-dir-pf", 0, 0, "リモートメモリの直接走査" },
+        { "LOCAL-dir-pf", 0, 1, "ローカルバッファの直接走査 (比較用)" },
+    };
+
+    char sizebuf[64], method[64];
+    format_size(size, sizebuf, sizeof(sizebuf));
+
+    for (size_t k = 0; k < sizeof(kinds) / sizeof(kinds[0]); k++) {
+        printf("\n--- ソフトウェアプリフェッチ 距離スイープ: %s (%s) ---\n",
+               kinds[k].desc, sizebuf);
+        printf("  (なし / prefetcht0 / prefetchnta × 先読み距離)\n\n");
+
+        bench_op_fn fn = kinds[k].copy ? op_copy_kernel : op_scan_kernel;
+        const void *src = kinds[k].local ? local_buf : attached_ptr;
+        kernel_arg_t op = { { kinds[k].copy ? local_buf : NULL, src, size, 0 }, PF_OFF, 0 };
+
+        kernel_set(&op, PF_NONE, 0);
+        snprintf(method, sizeof(method), "%s0", kinds[k].method);
+        double base = measure_kernel(method, fn, &op, size);
+
+        for (int h = PF_T0; h <= PF_NTA; h++) {
+            for (int d = 0; d < ndists; d++) {
+                if (dists[d] <= 0)
+                    continue;
+                kernel_set(&op, h, (size_t)dists[d]);
+                kernel_label(kinds[k].method, &op, method, sizeof(method));
+
+                if (kinds[k].copy) {
+                    memset(local_buf, 0, size);
+                    op_copy_kernel(&op);
+                    size_t err = verify_pattern(local_buf, size);
+                    if (err)
+                        fprintf(stderr, "  *** データ不整合! (%s) offset=%zu ***\n",
+                                method, err - 1);
+                }
+
+                double t = measure_kernel(method, fn, &op, size);
+                if (base > 0 && t > 0)
+                    printf("  [%s] プリフェッチなし比 x%.2f\n", method, base / t);
+            }
+        }
+    }
+    printf("\n");
+}
+
+/*
+ * チェックサム付きコピー
+ * 各サイズで、チェックサムなし / コピー後に読み直して計算 (sep) /
+ * コピーしながら計算 (fus) を CRC32C と xxHash64 で比べる。
+ * 送信側の値の代わりにリモートの元データから計算した値と照合する
+ */
+static void bench_xpmem_checksum(void *attached_ptr, void *local_buf, size_t max_size)
+{
+    static const struct {
+        const char *method;
+        int algo;
+        int fused;
+    } variants[] = {
+        { "xpmem-cpy-nosum",   CSUM_NONE,   0 },
+        { "xpmem-cpy-crc-sep", CSUM_CRC32C, 0 },
+        { "xpmem-cpy-crc-fus", CSUM_CRC32C, 1 },
+        { "xpmem-cpy-xxh-sep", CSUM_XXH64,  0 },
+        { "xpmem-cpy-xxh-fus", CSUM_XXH64,  1 },
+    };
+
+    printf("\n--- xpmem チェックサム付きコピー ベンチマーク ---\n");
+    printf("  (CRC32C: %s, xxHash64: 4レーン)\n\n",
+#ifdef __SSE4_2__
+           "SSE4.2 crc32 命令"
+#else
+           "テーブル版"
+#endif
+           );
+
+    for (size_t si = 0; si < NUM_TEST_SIZES; si++) {
+        size_t size = TEST_SIZES[si];
+        if (size > max_size) break;
+
+        uint64_t expect[] = { 0, crc32c(attached_ptr, size), xxh64(attached_ptr, size) };
+        double base = 0;
+
+        for (size_t v = 0; v < sizeof(variants) / sizeof(variants[0]); v++) {
+            csum_op_arg_t op = { { local_buf, attached_ptr, size, 0 },
+                                 variants[v].algo, variants[v].fused, 0 };
+
+            memset(local_buf, 0, size);
+            op_copy_csum(&op);
+            size_t err = verify_pattern(local_buf, size);
+            if (err)
+                fprintf(stderr, "  *** データ不整合! (%s) offset=%zu ***\n",
+                        variants[v].method, err - 1);
+            else if (op.csum != expect[op.algo])
+                fprintf(stderr, "  *** チェックサム不一致! (%s) %#llx != %#llx ***\n",
+                        variants[v].method, (unsigned long long)op.csum,
+                        (unsigned long long)expect[op.algo]);
+
+            double t = measure_kernel(variants[v].method, op_copy_csum, &op, size);
+            if (op.algo == CSUM_NONE)
+                base = t;
+            else if (base > 0)
+                printf("  [%s] チェックサムなし比 +%.1f%%\n",
+                       variants[v].method, (t / base - 1) * 100);
+        }
+        printf("\n");
+    }
+}
+
+/*
+ * xpmem_get() + xpmem_attach() の受け渡しコスト
+ * memfd_bench の MEMFD-hand / MEMFD-tch と比べるための計測
+ */
+typedef struct {
+    xpmem_segid_t segid;
+    size_t size;
+    int touch;          /* アタッチ後に全ページへファーストタッチするか */
+    uint64_t sum;
+    int failed;
+} attach_op_arg_t;
+
+static void op_xpmem_attach(void *arg)
+{
+    attach_op_arg_t *a = (attach_op_arg_t *)arg;
+    xpmem_apid_t apid = xpmem_get(a->segid, XPMEM_RDWR, XPMEM_PERMIT_MODE, (void *)0666);
+    if (apid == -1) {
+        a->failed = 1;
+        return;
+    }
+    struct xpmem_addr addr = { .apid = apid, .offset = 0 };
+    void *p = xpmem_attach(addr, a->size, NULL);
+    if (p == (void *)-1) {
+        a->failed = 1;
+    } else {
+        if (a->touch)
+            a->sum += touch_pages(p, a->size);
+        xpmem_detach(p);
+    }
+    xpmem_release(apid);
+}
+
+static void bench_xpmem_attach(xpmem_segid_t segid, size_t max_size)
+{
+    static const struct {
+        const char *method;
+        int touch;
+        const char *desc;
+    } modes[] = {
+        { "xpmem-att", 0, "xpmem_get → xpmem_attach → xpmem_detach → xpmem_release" },
+        { "xpmem-tch", 1, "上記 + アタッチ直後に全ページの先頭を読む (ファーストタッチ)" },
+    };
+
+    for (size_t m = 0; m < sizeof(modes) / sizeof(modes[0]); m++) {
+        printf("\n--- xpmem アタッチ ベンチマーク ---\n");
+        printf("  (%s)\n\n", modes[m].desc);
+
+        for (size_t si = 0; si < NUM_TEST_SIZES; si++) {
+            size_t size = TEST_SIZES[si];
+            if (size > max_size) break;
+
+            sample_set_t ss;
+            perf_sample_t pc_sum = {0}, pc;
+            attach_op_arg_t op = { segid, size, modes[m].touch, 0, 0 };
+            stats_phase(modes[m].method, size);
+
+            int reps = calibrate_inner_reps(op_xpmem_attach, &op);
+            if (op.failed) {
+                fprintf(stderr, "  *** xpmem_get/xpmem_attach 失敗, スキップ ***\n");
+                return;
+            }
+            printf("  内側ループ: %d 回/サンプル\n", reps);
+
+            for (int w = 0; w < g_cfg.warmup; w++)
+                time_op(op_xpmem_attach, &op, reps);
+
+            samples_init(&ss);
+            for (int r = 0; !samples_done(&ss); r++) {
+                perf_group_start(&g_perf);
+                double t = time_op(op_xpmem_attach, &op, reps);
+                perf_group_stop(&g_perf, &pc);
+                perf_sample_add(&pc_sum, &pc);
+                samples_add(&ss, t);
+
+                if (r < REPEAT_COUNT)
+                    print_result(modes[m].method, size, t, r + 1);
+            }
+            print_summary(modes[m].method, size, ss.v, ss.n);
+            print_perf_summary(modes[m].method, size, &pc_sum, ss.n * reps);
+            samples_free(&ss);
+            printf("\n");
+        }
+    }
+}
+
+/*
+ * アリーナ上のオブジェクト連結リストを辿る
+ * ハンドルは自プロセスのアリーナ先頭 (attach アドレス + aux_offset) で解決する
+ */
+typedef struct {
+    const void *arena;
+    arena_handle_t head;
+    uint64_t sum;
+} arena_walk_arg_t;
+
+static void op_arena_walk(void *arg)
+{
+    arena_walk_arg_t *a = (arena_walk_arg_t *)arg;
+    uint64_t sum = 0;
+    for (arena_handle_t h = a->head; h; ) {
+        const arena_obj_t *o = (const arena_obj_t *)arena_ptr(a->arena, h);
+        for (uint32_t k = 0; k < o->len; k++)
+            sum += o->data[k];
+        h = o->next;
+    }
+    a->sum += sum;
+    __asm__ volatile("" :: "r"(sum) : "memory");
+}
+
+static void bench_arena_walk(void *arena_base, size_t arena_size)
+{
+    printf("\n--- アリーナ オブジェクト走査ベンチマーク ---\n");
+    printf("  (公開ハンドルを自プロセスのアドレスに解決しながら連結リストを読む)\n\n");
+
+    const arena_header_t *arena = arena_open(arena_base, arena_size);
+    if (!arena) {
+        fprintf(stderr, "  アリーナが見つかりません (スキップ)\n");
+        return;
+    }
+    arena_walk_arg_t arg = { arena_base, arena_lookup(arena, "objlist"), 0 };
+    if (!arg.head) {
+        fprintf(stderr, "  \"objlist\" が公開されていません (スキップ)\n");
+        return;
+    }
+
+    /* オブジェクト数・バイト数の集計とデータ検証 (計測外) */
+    size_t nobjs = 0, bytes = 0, bad = 0;
+    for (arena_handle_t h = arg.head; h; ) {
+        const arena_obj_t *o = (const arena_obj_t *)arena_ptr(arena_base, h);
+        for (uint32_t k = 0; k < o->len; k++)
+            if (o->data[k] != (uint8_t)(o->seq + k))
+                bad++;
+        nobjs++;
+        bytes += o->len;
+        h = o->next;
+    }
+    if (bad)
+        fprintf(stderr, "  *** データ不整合! %zu バイト ***\n", bad);
+    else
+        printf("  ✓ データ検証OK (%zu 個)\n", nobjs);
+
+    stats_phase("ARENA-walk", bytes);
+    int reps = calibrate_inner_reps(op_arena_walk, &arg);
+    for (int w = 0; w < g_cfg.warmup; w++)
+        time_op(op_arena_walk, &arg, reps);
+
+    sample_set_t ss;
+    perf_sample_t pc_sum = {0}, pc;
+    samples_init(&ss);
+    while (!samples_done(&ss)) {
+        perf_group_start(&g_perf);
+        double t = time_op(op_arena_walk, &arg, reps);
+        perf_group_stop(&g_perf, &pc);
+        perf_sample_add(&pc_sum, &pc);
+        samples_add(&ss, t);
+    }
+    print_summary("ARENA-walk", bytes, ss.v, ss.n);
+    print_perf_summary("ARENA-walk", bytes, &pc_sum, ss.n * reps);
+
+    sample_stats_t st;
+    compute_stats(ss.v, ss.n, &st);
+    printf("  [ARENA-walk] %.2f ns/obj, %.2f Mobj/s (中央値)\n",
+           st.median / nobjs * 1e9, nobjs / st.median * 1e-6);
+    samples_free(&ss);
+}
+
+/*
+ * エクスポータが構築したテーブル (offset_ptr ベースのコンテナ) を
+ * attach 経由で直接引く場合と、ローカルにコピーしてから引く場合の比較
+ */
+static void bench_xpmem_table(void *arena_base, size_t arena_size)
+{
+    printf("\n--- 共有テーブル ルックアップベンチマーク ---\n");
+    printf("  (エクスポータのハッシュマップを直接参照 vs ローカルへコピーして参照)\n\n");
+
+    const arena_header_t *arena = arena_open(arena_base, arena_size);
+    arena_handle_t h = arena ? arena_lookup(arena, "table") : 0;
+    if (!h) {
+        fprintf(stderr, "  \"table\" が公開されていません (スキップ)\n");
+        return;
+    }
+    bench_table_lookup("xpmem", (const shm_table_t *)arena_ptr(arena_base, h));
+}
+
+/*
+ * 不連続な区間 (extent) の gather / scatter
+ * extent 長ごと、順次 / ランダム配置ごとに、セグメント上の extent を
+ * 詰めたローカルバッファへ集める場合 (gather) とその逆 (scatter) を
+ * extent ごとの memcpy / 複数スレッド / process_vm_readv・writev で比べる。
+ * scatter は gather した内容を同じ場所へ書き戻すのでデータ領域は変わらない
+ */
+#define MAX_EXT_SIZES 16
+
+/* 計測して GB/s と extent/s を表示する (中央値) */
+static void measure_extent(const char *method, bench_op_fn fn, void *op, size_t bytes, size_t n)
+{
+    double t = measure_kernel(method, fn, op, bytes);
+    if (t > 0)
+        printf("  [%s] %.2f GB/s, %.2f Mext/s (中央値)\n", method,
+               bytes / t / (1024.0 * 1024 * 1024), n / t * 1e-6);
+}
+
+static const char *const EXT_LAYOUT_NAMES[] = { "seq", "rand" };
+#define NUM_EXT_LAYOUTS 2
+
+/* "seq,rand" 形式の配置リストを読む。知らない名前は警告して飛ばす。選べた数を返す */
+static int parse_ext_layouts(const char *arg, int *want)
+{
+    char *dup = strdup(arg), *save = NULL;
+    int n = 0;
+    memset(want, 0, NUM_EXT_LAYOUTS * sizeof(*want));
+    for (char *tok = dup ? strtok_r(dup, ",", &save) : NULL; tok;
+         tok = strtok_r(NULL, ",", &save)) {
+        int l = 0;
+        while (l < NUM_EXT_LAYOUTS && strcmp(tok, EXT_LAYOUT_NAMES[l]) != 0)
+            l++;
+        if (l == NUM_EXT_LAYOUTS) {
+            fprintf(stderr, "  不明な BENCH_EXT_LAYOUT: %s (seq / rand)\n", tok);
+            continue;
+        }
+        n += !want[l];
+        want[l] = 1;
+    }
+    free(dup);
+    return n;
+}
+
+/* gather を1回行い、詰めたバッファを検証する (計測外) */
+static void check_gather(const char *method, bench_op_fn fn, void *op, const extent_arg_t *a,
+                         size_t bytes)
+{
+    memset(a->packed, 0, bytes);
+    fn(op);
+    size_t bad = extent_verify(a->packed, a->e, a->n);
+    if (bad)
+        fprintf(stderr, "  *** データ不整合! (%s) %zu 個の extent ***\n", method, bad);
+}
+
+static void bench_xpmem_extent(void *attached_ptr, void *local_buf, size_t max_size,
+                               const seg_base_t *base)
+{
+    size_t span = (size_t)env_long("BENCH_EXT_MB", DEFAULT_EXT_MB) * 1024UL * 1024;
+    if (span > max_size)
+        span = max_size;
+    long count = env_long("BENCH_EXT_COUNT", DEFAULT_EXT_COUNT);
+    long sizes[MAX_EXT_SIZES];
+    int nsizes = env_long_list("BENCH_EXT_SIZES", DEFAULT_EXT_SIZES, sizes, MAX_EXT_SIZES);
+    const char *layouts = getenv("BENCH_EXT_LAYOUT");
+    if (!layouts || !*layouts)
+        layouts = DEFAULT_EXT_LAYOUT;
+    int want[NUM_EXT_LAYOUTS];
+    int nthreads = (int)env_long("BENCH_EXT_THREADS", DEFAULT_EXT_THREADS);
+    if (parse_ext_layouts(layouts, want) == 0) {
+        fprintf(stderr, "  extent の配置がありません (スキップ)\n");
+        return;
+    }
+    if (count <= 0)
+        return;
+
+    char sizebuf[64];
+    printf("\n--- extent gather / scatter ベンチマーク (%s の範囲) ---\n",
+           format_size(span, sizebuf, sizeof(sizebuf)));
+    printf("  (extent ごとの memcpy / %d スレッド / process_vm_readv・writev)\n", nthreads);
+    if (!base)
+        printf("  (エクスポータが BENCH_EXT_PVM=1 でないため process_vm_* は省略)\n");
+    printf("\n");
+
+    extent_t *e = malloc((size_t)count * sizeof(*e));
+    struct iovec *riov = malloc((size_t)count * sizeof(*riov));
+    if (!e || !riov) {
+        fprintf(stderr, "  extent リスト確保失敗\n");
+        free(e);
+        free(riov);
+        return;
+    }
+
+    static extent_pool_t pool;
+    int pvm_ok = base != NULL;
+    char method[64];
+
+    for (int l = 0; l < NUM_EXT_LAYOUTS; l++) {
+        if (!want[l])
+            continue;
+        for (int si = 0; si < nsizes; si++) {
+            if (sizes[si] <= 0 || (size_t)sizes[si] > span)
+                continue;
+            size_t len = (size_t)sizes[si];
+            size_t n = (size_t)count;
+            if (n * len > span)
+                n = span / len;
+            size_t bytes = extent_build(e, n, len, span, l, 0x9e3779b97f4a7c15ULL + len);
+            printf("  %s 配置, %zu bytes × %zu 個\n", EXT_LAYOUT_NAMES[l], len, n);
+
+            for (int dir = 0; dir < 2; dir++) {
+                const char *dname = dir ? "scatter" : "gather";
+                extent_arg_t a = { (char *)attached_ptr, (char *)local_buf, e, n, 0 };
+
+                /* scatter で書き戻す内容を用意する (計測外) */
+                op_extent_loop(&a);
+                a.scatter = dir;
+
+                snprintf(method, sizeof(method), "EXT-%s-loop-%s-%zu", dname,
+                         EXT_LAYOUT_NAMES[l], len);
+                if (!dir)
+                    check_gather(method, op_extent_loop, &a, &a, bytes);
+                measure_extent(method, op_extent_loop, &a, bytes, n);
+
+                int nt = extent_pool_start(&pool, &a, nthreads);
+                snprintf(method, sizeof(method), "EXT-%s-mt%d-%s-%zu", dname, nt,
+                         EXT_LAYOUT_NAMES[l], len);
+                if (!dir)
+                    check_gather(method, op_extent_mt, &pool, &a, bytes);
+                measure_extent(method, op_extent_mt, &pool, bytes, n);
+                extent_pool_stop(&pool);
+
+                if (pvm_ok) {
+                    extent_pvm_arg_t pa;
+                    extent_pvm_setup(&pa, &a, base, riov);
+                    snprintf(method, sizeof(method), "EXT-%s-pvm-%s-%zu", dname,
+                             EXT_LAYOUT_NAMES[l], len);
+                    if (!dir)
+                        check_gather(method, op_extent_pvm, &pa, &a, bytes);
+                    else
+                        op_extent_pvm(&pa);
+                    if (pa.err) {
+                        fprintf(stderr, "  process_vm_%s が使えません: %s (以降省略)\n",
+                                dir ? "writev" : "readv", strerror(pa.err));
+                        pvm_ok = 0;
+                    } else {
+                        measure_extent(method, op_extent_pvm, &pa, bytes, n);
+                    }
+                }
+            }
+            printf("\n");
+        }
+    }
+
+    /* scatter は同じ内容を書き戻しただけなので、データ領域はパターンのまま */
+    size_t err = verify_pattern(attached_ptr, span);
+    if (err)
+        fprintf(stderr, "  *** scatter 後のデータ不整合! offset=%zu ***\n", err - 1);
+    else
+        printf("  ✓ データ検証OK (scatter 後のリモート)\n");
+    free(e);
+    free(riov);
+}
+
+/*
+ * 差分同期ベンチマーク
+ * 1サンプル = エクスポータに permille‰ のページを書き換えさせ (計測外)、
+ * ローカルの複製を最新にするまでの時間。全体コピー (xpmem-full) と、
+ * バージョン表で変わったページだけコピーする場合 (xpmem-inc-X%) を比べる。
+ * 最後に計測した後で複製がリモートと一致することを確認する。
+ */
+#define MAX_DIRTY_LEVELS 16
+
+static void bench_xpmem_incsync(void *attached_ptr, void *local_buf,
+                                void *arena_base, size_t arena_size, size_t max_size)
+{
+    printf("\n--- 差分同期ベンチマーク ---\n");
+    printf("  (エクスポータが一部のページを書き換えた後、ローカル複製を最新にする)\n\n");
+
+    const arena_header_t *arena = arena_open(arena_base, arena_size);
+    arena_handle_t h = arena ? arena_lookup(arena, "syncctl") : 0;
+    if (!h) {
+        fprintf(stderr, "  \"syncctl\" が公開されていません (スキップ)\n");
+        return;
+    }
+    sync_ctl_t *ctl = (sync_ctl_t *)arena_ptr(arena_base, h);
+
+    long levels[MAX_DIRTY_LEVELS];
+    int nlevels = env_long_list("BENCH_DIRTY_PERMILLE", DEFAULT_DIRTY_PERMILLE,
+                                levels, MAX_DIRTY_LEVELS);
+
+    /* 全体コピーでも毎回書き換えさせる (最も多い割合で) */
+    uint32_t full_permille = nlevels > 0 ? (uint32_t)levels[nlevels - 1] : 0;
+
+    uint32_t *seen = malloc(ctl->npages * sizeof(uint32_t));
+    if (!seen)
+        return;
+
+    for (size_t si = 0; si < NUM_TEST_SIZES; si++) {
+        size_t size = TEST_SIZES[si];
+        if (size > max_size || size / SYNC_PAGE_SIZE > ctl->npages) break;
+
+        /* -1: 全体コピー, それ以外: levels[] の差分同期 */
+        for (int l = -1; l < nlevels; l++) {
+            uint32_t permille = l < 0 ? full_permille : (uint32_t)levels[l];
+            char method[32];
+            if (l < 0)
+                snprintf(method, sizeof(method), "xpmem-full");
+            else
+                snprintf(method, sizeof(method), "xpmem-inc-%g%%", permille / 10.0);
 
+            /* 起点: 全体をコピーしてバージョンを記録 */
+            stats_phase(method, size);
+            memcpy(local_buf, attached_ptr, size);
+            sync_snapshot(arena_base, ctl, seen, size);
+
+            sample_set_t ss;
+            double moved_sum = 0;
+            samples_init(&ss);
+            for (int r = -g_cfg.warmup; !samples_done(&ss); r++) {
+                sync_request(ctl, permille, size);
+
+                size_t moved;
+                uint64_t t0 = timer_start();
+                if (l < 0) {
+                    memcpy(local_buf, attached_ptr, size);
+                    moved = size;
+                } else {
+                    moved = sync_pull(arena_base, ctl, seen, local_buf, attached_ptr, size);
+                }
+                uint64_t t1 = timer_stop();
+
+                if (l < 0)
+                    sync_snapshot(arena_base, ctl, seen, size);
+                stats_record(1, timer_elapsed_sec(t0, t1));
+                if (r < 0)
+                    continue;  /* ウォームアップ */
+                samples_add(&ss, timer_elapsed_sec(t0, t1));
+                moved_sum += moved;
+                if (r < REPEAT_COUNT)
+                    print_result(method, size, timer_elapsed_sec(t0, t1), r + 1);
+            }
+
+            if (memcmp(local_buf, attached_ptr, size) != 0)
+                fprintf(stderr, "  *** データ不整合! (%s) ***\n", method);
+            else
+                printf("  ✓ データ検証OK (複製 == リモート)\n");
+
+            print_summary(method, size, ss.v, ss.n);
+            char sizebuf[64];
+            double avg = moved_sum / ss.n;
+            printf("  [%s] 転送量: %s/同期 (全体の %.2f%%)\n\n", method,
+                   format_size((size_t)avg, sizebuf, sizeof(sizebuf)), avg / size * 100);
+            samples_free(&ss);
+        }
+    }
+    free(seen);
+}
+
+/*
+ * seqlock スナップショットベンチマーク
+ * エクスポータのサービススレッドが指定レートで領域を書き換え続ける中で、
+ * 範囲全体の一貫したスナップショットをローカルに取る。
+ * 1操作 = 全領域を seqlock で読む (破れた領域は読み直す)。
+ */
+#define MAX_SEQ_LEVELS 16
+
+typedef struct {
+    const void *arena;
+    const seq_ctl_t *ctl;
+    const void *remote;
+    void *local;
+    size_t size;
+    size_t region;
+    uint32_t *seen;         /* 各領域で採用したシーケンス番号 */
+    uint64_t retries;
+    uint64_t reads;
+} seq_snapshot_arg_t;
+
+static void op_seq_snapshot(void *arg)
+{
+    seq_snapshot_arg_t *a = (seq_snapshot_arg_t *)arg;
+    uint64_t nregions = a->size / a->region;
+    for (uint64_t i = 0; i < nregions; i++) {
+        size_t off = i * a->region;
+        a->retries += seq_read_region(a->arena, a->ctl, i, a->region,
+                                      (char *)a->local + off,
+                                      (const char *)a->remote + off, &a->seen[i]);
+    }
+    a->reads += nregions;
+}
+
+/* 最後のスナップショットの各領域が、採用した番号で書かれた内容と一致するか */
+static uint64_t seq_verify_snapshot(const seq_snapshot_arg_t *a)
+{
+    uint64_t bad = 0;
+    for (uint64_t i = 0; i < a->size / a->region; i++) {
+        if (a->seen[i] == 0)
+            continue;   /* まだ書き換えられていない領域 */
+        const uint64_t *p = (const uint64_t *)((const char *)a->local + i * a->region);
+        uint64_t tag = seq_tag(i, a->seen[i]);
+        for (size_t k = 0; k < a->region / sizeof(uint64_t); k++) {
+            if (p[k] != tag) {
+                bad++;
+                break;
+            }
+        }
+    }
+    return bad;
+}
+
+static void bench_xpmem_seqlock(void *attached_ptr, void *local_buf,
+                                void *arena_base, size_t arena_size, size_t max_size)
+{
+    printf("\n--- seqlock スナップショットベンチマーク ---\n");
+    printf("  (エクスポータが書き換え続ける領域を一貫したスナップショットとして読む)\n\n");
+
+    const arena_header_t *arena = arena_open(arena_base, arena_size);
+    arena_handle_t h = arena ? arena_lookup(arena, "seqctl") : 0;
+    if (!h) {
+        fprintf(stderr, "  \"seqctl\" が公開されていません (スキップ)\n");
+        return;
+    }
+    seq_ctl_t *ctl = (seq_ctl_t *)arena_ptr(arena_base, h);
+
+    size_t size = (size_t)env_long("BENCH_SEQ_MB", DEFAULT_SEQ_MB) * 1024UL * 1024;
+    if (size > max_size)
+        size = max_size;
+    long regions[MAX_SEQ_LEVELS], rates[MAX_SEQ_LEVELS];
+    int nregions = env_long_list("BENCH_SEQ_REGIONS", DEFAULT_SEQ_REGIONS,
+                                 regions, MAX_SEQ_LEVELS);
+    int nrates = env_long_list("BENCH_SEQ_RATES", DEFAULT_SEQ_RATES, rates, MAX_SEQ_LEVELS);
+
+    uint32_t *seen = calloc(ctl->nseq, sizeof(uint32_t));
+    if (!seen)
+        return;
+
+    for (int ri = 0; ri < nregions; ri++) {
+        size_t region = (size_t)regions[ri];
+        if (region < SEQ_MIN_REGION || region % SEQ_MIN_REGION || region > size) {
+            fprintf(stderr, "  領域サイズ %zu は %lu の倍数かつ範囲以下にしてください (スキップ)\n",
+                    region, SEQ_MIN_REGION);
+            continue;
+        }
+        for (int wi = 0; wi < nrates; wi++) {
+            char method[80], regbuf[32], ratebuf[32];
+            format_size(region, regbuf, sizeof(regbuf));
+            if (rates[wi] < 0)
+                snprintf(ratebuf, sizeof(ratebuf), "max");
+            else
+                snprintf(ratebuf, sizeof(ratebuf), "%ld", rates[wi]);
+            snprintf(method, sizeof(method), "xpmem-seq-r%zuK-w%s", region / 1024, ratebuf);
+            printf("  [%s] 領域 %s, ライタ %s 回/秒\n", method, regbuf, ratebuf);
+
+            seq_writer_set(arena_base, ctl, size, region, rates[wi]);
+            stats_phase(method, size);
+
+            seq_snapshot_arg_t op = { arena_base, ctl, attached_ptr, local_buf,
+                                      size, region, seen, 0, 0 };
+            int reps = calibrate_inner_reps(op_seq_snapshot, &op);
+            for (int w = 0; w < g_cfg.warmup; w++)
+                time_op(op_seq_snapshot, &op, reps);
+
+            op.retries = op.reads = 0;
+            uint64_t writes0 = atomic_load(&ctl->writes);
             double t0 = get_time_sec();
-            memcpy(dst, src, size);
-            double t1 = get_time_sec();
 
-            times[r] = t1 - t0;
-            print_result("LOCAL-cpy", size, times[r], r + 1);
+            sample_set_t ss;
+            samples_init(&ss);
+            for (int r = 0; !samples_done(&ss); r++) {
+                uint64_t retries0 = op.retries;
+                double t = time_op(op_seq_snapshot, &op, reps);
+                stats_retries(op.retries - retries0);
+                samples_add(&ss, t);
+                if (r < REPEAT_COUNT)
+                    print_result(method, size, t, r + 1);
+            }
+
+            double elapsed = get_time_sec() - t0;
+            uint64_t writes = atomic_load(&ctl->writes) - writes0;
+            seq_writer_set(arena_base, ctl, size, region, 0);
+
+            uint64_t bad = seq_verify_snapshot(&op);
+            if (bad)
+                fprintf(stderr, "  *** 破れたスナップショット! %lu 領域 ***\n",
+                        (unsigned long)bad);
+            else
+                printf("  ✓ スナップショット検証OK\n");
+
+            print_summary(method, size, ss.v, ss.n);
+            printf("  [%s] リトライ率 %.4f%% (%lu / %lu 領域), "
+                   "ライタ %.0f 回/秒 (%.3f GB/s)\n\n",
+                   method, op.reads ? 100.0 * op.retries / op.reads : 0.0,
+                   (unsigned long)op.retries, (unsigned long)op.reads,
+                   writes / elapsed, writes * (double)region / elapsed / (1024.0 * 1024 * 1024));
+            samples_free(&ss);
         }
-        print_summary("LOCAL-cpy", size, times, REPEAT_COUNT);
+    }
+    free(seen);
+}
+
+/*
+ * 長時間ソーク
+ * BENCH_SOAK で選んだ負荷を BENCH_SOAK_SECONDS の間回し続け、区間ごとに
+ * スループットと1操作のレイテンシの分位点を時系列 (SOAK 行) として出力する。
+ * THP のコンパクション、NUMA バランシング、周波数の低下、断片化による
+ * 時間経過での変化を追えるよう、区間ごとの /proc/vmstat の差分と
+ * 実行中の CPU のクロックも添える。
+ *   copy      リモート → ローカルの memcpy (1操作 = BENCH_SOAK_MB)
+ *   dir       リモートの直接走査 (1操作 = BENCH_SOAK_MB)
+ *   pingpong  エクスポータとのキャッシュライン1本の往復
+ *   ring      エクスポータが書き続けるチャンクリングからの受信 (1操作 = 1チャンク)
+ * 区間内のレイテンシは最大 SOAK_RESERVOIR 個をリザーバサンプリングで残して
+ * 分位点を求める (max は全操作から)。
+ */
+#define SOAK_RESERVOIR 65536
+
+enum { SOAK_W_COPY = 0, SOAK_W_DIR, SOAK_W_PINGPONG, SOAK_W_RING, SOAK_W_NUM };
+static const char *const SOAK_WORKLOADS[SOAK_W_NUM] = { "copy", "dir", "pingpong", "ring" };
+
+#define NUM_SOAK_VMSTAT 3
+static const char *const SOAK_VMSTAT[NUM_SOAK_VMSTAT] = {
+    "compact_stall", "numa_pages_migrated", "thp_fault_alloc",
+};
+
+static void read_vmstat(uint64_t *out)
+{
+    memset(out, 0, sizeof(uint64_t) * NUM_SOAK_VMSTAT);
+    FILE *fp = fopen("/proc/vmstat", "r");
+    if (!fp)
+        return;
+    char name[64];
+    unsigned long long v;
+    while (fscanf(fp, "%63s %llu", name, &v) == 2)
+        for (int i = 0; i < NUM_SOAK_VMSTAT; i++)
+            if (strcmp(name, SOAK_VMSTAT[i]) == 0)
+                out[i] = v;
+    fclose(fp);
+}
+
+/* 実行中の CPU の現在のクロック (MHz)。読めなければ 0 */
+static long current_cpu_mhz(void)
+{
+    char path[128];
+    snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/cpufreq/scaling_cur_freq",
+             sched_getcpu());
+    long khz = 0;
+    FILE *fp = fopen(path, "r");
+    if (fp) {
+        if (fscanf(fp, "%ld", &khz) != 1)
+            khz = 0;
+        fclose(fp);
+    }
+    return khz / 1000;
+}
+
+typedef struct {
+    int workload;           /* SOAK_W_* */
+    kernel_arg_t k;         /* copy / dir */
+    soak_ctl_t *ctl;        /* pingpong / ring */
+    const void *remote;
+    void *local;
+    size_t chunk;
+    uint32_t slots;
+    uint64_t seq;           /* ピンポンの通し番号 / 次に受け取るチャンク番号 */
+    uint64_t bad;           /* 中身が番号と合わなかったチャンク */
+} soak_op_arg_t;
+
+static void op_soak(void *arg)
+{
+    soak_op_arg_t *a = (soak_op_arg_t *)arg;
+    int spins = 0;
+    switch (a->workload) {
+    case SOAK_W_COPY:
+        op_copy_kernel(&a->k);
+        break;
+    case SOAK_W_DIR:
+        op_scan_kernel(&a->k);
+        break;
+    case SOAK_W_PINGPONG: {
+        uint64_t v = ++a->seq;
+        atomic_store_explicit(&a->ctl->ping.v, v, memory_order_release);
+        while (atomic_load_explicit(&a->ctl->pong.v, memory_order_acquire) != v)
+            spin_backoff(&spins);
+        break;
+    }
+    case SOAK_W_RING: {
+        uint64_t g = a->seq++;
+        uint32_t s = (uint32_t)(g % a->slots);
+        while (atomic_load_explicit(&a->ctl->full[s].v, memory_order_acquire) < g + 1)
+            spin_backoff(&spins);
+        memcpy(a->local, (const char *)a->remote + (size_t)s * a->chunk, a->chunk);
+        atomic_store_explicit(&a->ctl->empty[s].v, g + 1, memory_order_release);
+        const uint64_t *p = (const uint64_t *)a->local;
+        if (p[0] != g || p[a->chunk / sizeof(uint64_t) - 1] != g)
+            a->bad++;
+        break;
+    }
+    }
+}
+
+/* リザーバに x を加える (seen は今までに見た数) */
+static void reservoir_add(double *v, uint64_t seen, double x, uint64_t *rng)
+{
+    if (seen < SOAK_RESERVOIR) {
+        v[seen] = x;
+        return;
+    }
+    *rng ^= *rng << 13;
+    *rng ^= *rng >> 7;
+    *rng ^= *rng << 17;
+    uint64_t j = *rng % (seen + 1);
+    if (j < SOAK_RESERVOIR)
+        v[j] = x;
+}
+
+static double percentile_sorted(const double *v, int n, double p)
+{
+    return n > 0 ? v[(int)(p * (n - 1) + 0.5)] : 0;
+}
+
+static int bench_xpmem_soak(const char *name, void *attached_ptr, void *local_buf,
+                            void *arena_base, size_t arena_size, size_t max_size)
+{
+    int w;
+    for (w = 0; w < SOAK_W_NUM; w++)
+        if (strcmp(name, SOAK_WORKLOADS[w]) == 0)
+            break;
+    if (w == SOAK_W_NUM) {
+        fprintf(stderr, "不明な BENCH_SOAK: %s (copy / dir / pingpong / ring)\n", name);
+        return -1;
+    }
+
+    double seconds = env_double("BENCH_SOAK_SECONDS", DEFAULT_SOAK_SECONDS);
+    double interval = env_double("BENCH_SOAK_INTERVAL", DEFAULT_SOAK_INTERVAL);
+    if (interval <= 0)
+        interval = DEFAULT_SOAK_INTERVAL;
+    size_t size = (size_t)env_long("BENCH_SOAK_MB", DEFAULT_SOAK_MB) * 1024UL * 1024;
+    if (size > max_size)
+        size = max_size;
+
+    soak_op_arg_t op = { .workload = w, .remote = attached_ptr, .local = local_buf };
+    kernel_config_load(&op.k);
+    size_t op_bytes = size;
+    if (w == SOAK_W_COPY || w == SOAK_W_DIR) {
+        op.k.m = (mem_op_arg_t){ w == SOAK_W_COPY ? local_buf : NULL, attached_ptr, size, 0 };
+    } else {
+        const arena_header_t *arena = arena_base ? arena_open(arena_base, arena_size) : NULL;
+        arena_handle_t h = arena ? arena_lookup(arena, "soakctl") : 0;
+        if (!h) {
+            fprintf(stderr, "  \"soakctl\" が公開されていません (%s には相手役が必要)\n", name);
+            return -1;
+        }
+        op.ctl = (soak_ctl_t *)arena_ptr(arena_base, h);
+        if (w == SOAK_W_PINGPONG) {
+            op_bytes = sizeof(soak_line_t);
+            soak_set(op.ctl, SOAK_PINGPONG, 0, 0);
+        } else {
+            long slots = env_long("BENCH_SOAK_SLOTS", DEFAULT_SOAK_SLOTS);
+            op.slots = (uint32_t)(slots < 1 ? 1 : slots > SOAK_MAX_SLOTS ? SOAK_MAX_SLOTS : slots);
+            op.chunk = (size_t)env_long("BENCH_SOAK_CHUNK_KB", DEFAULT_SOAK_CHUNK_KB) * 1024;
+            if (op.chunk < sizeof(uint64_t) || op.chunk * op.slots > max_size) {
+                fprintf(stderr, "  リング (%u × %zu bytes) が最大サイズを超えます\n",
+                        op.slots, op.chunk);
+                return -1;
+            }
+            op_bytes = op.chunk;
+            soak_set(op.ctl, SOAK_RING, op.slots, op.chunk);
+        }
+    }
+
+    char method[64], sizebuf[64];
+    snprintf(method, sizeof(method), "xpmem-soak-%s", name);
+    printf("\n--- ソーク (%s) ---\n", method);
+    printf("  1操作 %s, %.0f 秒, 区間 %.2f 秒", format_size(op_bytes, sizebuf, sizeof(sizebuf)),
+           seconds, interval);
+    if (w == SOAK_W_RING)
+        printf(", %u スロット", op.slots);
+    printf("\n  SOAK 行: t=経過秒 ops=区間の操作数 gbps p50/p90/p99/p999/max_us=1操作の時間\n");
+    printf("           mhz=実行中の CPU のクロック 以降は /proc/vmstat の区間差分\n\n");
+
+    size_t nseries = (size_t)(seconds / interval) + 2;
+    double *res = malloc(SOAK_RESERVOIR * sizeof(double));
+    double *all = malloc(SOAK_RESERVOIR * sizeof(double));
+    double *series = malloc(nseries * sizeof(double));
+    if (!res || !all || !series) {
+        free(res);
+        free(all);
+        free(series);
+        if (op.ctl)
+            soak_set(op.ctl, SOAK_IDLE, 0, 0);
+        return -1;
+    }
+
+    stats_phase(method, op_bytes);
+    for (int i = 0; i < g_cfg.warmup; i++)
+        op_soak(&op);
+
+    uint64_t rng = 0x9E3779B97F4A7C15ULL;
+    uint64_t vm0[NUM_SOAK_VMSTAT], vm1[NUM_SOAK_VMSTAT];
+    uint64_t ops = 0, all_seen = 0;
+    double lat_max = 0, int_start = 0;
+    size_t nint = 0;
+    read_vmstat(vm0);
+    uint64_t t_begin = timer_start();
+
+    for (;;) {
+        uint64_t t0 = timer_start();
+        op_soak(&op);
+        uint64_t t1 = timer_stop();
+        double lat = timer_elapsed_sec(t0, t1);
+        stats_record(1, lat);
+        reservoir_add(res, ops++, lat, &rng);
+        reservoir_add(all, all_seen++, lat, &rng);
+        if (lat > lat_max)
+            lat_max = lat;
+
+        double now = timer_elapsed_sec(t_begin, t1);
+        if (now - int_start < interval && now < seconds)
+            continue;
+
+        int n = ops < SOAK_RESERVOIR ? (int)ops : SOAK_RESERVOIR;
+        qsort(res, n, sizeof(double), cmp_double);
+        double gbps = ops * (double)op_bytes / (now - int_start) / (1024.0 * 1024 * 1024);
+        read_vmstat(vm1);
+        stats_faults();
+        printf("SOAK backend=%s t=%.2f ops=%lu gbps=%.4f p50_us=%.3f p90_us=%.3f "
+               "p99_us=%.3f p999_us=%.3f max_us=%.3f mhz=%ld",
+               method, now, (unsigned long)ops, gbps,
+               percentile_sorted(res, n, 0.50) * 1e6, percentile_sorted(res, n, 0.90) * 1e6,
+               percentile_sorted(res, n, 0.99) * 1e6, percentile_sorted(res, n, 0.999) * 1e6,
+               lat_max * 1e6, current_cpu_mhz());
+        for (int i = 0; i < NUM_SOAK_VMSTAT; i++)
+            printf(" %s=%lu", SOAK_VMSTAT[i], (unsigned long)(vm1[i] - vm0[i]));
         printf("\n");
+        fflush(stdout);
+
+        if (nint < nseries)
+            series[nint++] = gbps;
+        memcpy(vm0, vm1, sizeof(vm0));
+        ops = 0;
+        lat_max = 0;
+        int_start = now;
+        if (now >= seconds)
+            break;
+    }
+
+    if (op.ctl)
+        soak_set(op.ctl, SOAK_IDLE, 0, 0);
+
+    /* 検証: copy は最後の複製、ring は各チャンクの番号 */
+    if (w == SOAK_W_COPY && memcmp(local_buf, attached_ptr, size) != 0)
+        fprintf(stderr, "  *** データ不整合! (%s) ***\n", method);
+    else if (w == SOAK_W_RING && op.bad)
+        fprintf(stderr, "  *** チャンクの中身が不一致! %lu 個 ***\n", (unsigned long)op.bad);
+    else if (w == SOAK_W_COPY || w == SOAK_W_RING)
+        printf("  ✓ データ検証OK\n");
+
+    /* 時系列の変化: 最初と最後の区間の帯域、区間の最小・最大 */
+    if (nint > 0) {
+        double lo = series[0], hi = series[0];
+        for (size_t i = 1; i < nint; i++) {
+            if (series[i] < lo) lo = series[i];
+            if (series[i] > hi) hi = series[i];
+        }
+        double last = series[nint - 1];
+        printf("  [%s] 区間帯域 (%zu 区間): 最初 %.3f GB/s, 最後 %.3f GB/s (%+.1f%%), "
+               "最小 %.3f, 最大 %.3f\n", method, nint, series[0], last,
+               series[0] > 0 ? (last / series[0] - 1) * 100 : 0.0, lo, hi);
     }
+    print_summary(method, op_bytes, all, all_seen < SOAK_RESERVOIR ? (int)all_seen : SOAK_RESERVOIR);
 
-    free(src);
-    free(dst);
+    free(res);
+    free(all);
+    free(series);
+    return 0;
+}
+
+/*
+ * レジストリが作られ、name が生きているエクスポータによって登録されるまで待つ。
+ * 落ちたエクスポータの古い登録は無視して、置き換えられるのを待つ。
+ * timeout_sec 秒 (0 以下なら無制限) で NULL
+ */
+static reg_header_t *wait_registry(const char *name, double timeout_sec, reg_info_t *info)
+{
+    double start = get_time_sec();
+    reg_header_t *reg;
+    while (!(reg = reg_open(reg_default_name(), 0, 0))) {
+        if (errno == EPROTO)
+            return NULL;
+        if (timeout_sec > 0 && get_time_sec() - start >= timeout_sec)
+            return NULL;
+        usleep(10000);
+    }
+
+    uint64_t stale = 0;
+    for (;;) {
+        double left = 0;
+        if (timeout_sec > 0) {
+            left = timeout_sec - (get_time_sec() - start);
+            if (left <= 0)
+                break;
+        }
+        if (reg_wait(reg, name, stale, left, info) != 0)
+            break;
+        if (kill(info->pid, 0) == 0 || errno == EPERM)
+            return reg;
+        stale = info->generation;
+    }
+    reg_close(reg);
+    return NULL;
 }
 
 int main(int argc, char *argv[])
 {
     (void)argc; (void)argv;
 
-    printf("=== xpmem Importer / ベンチマーク ===\n");
-    printf("PID: %d\n\n", getpid());
-
-    /* エクスポータの準備完了を待つ */
-    printf("エクスポータの準備完了待ち...\n");
-    wait_for_file(READY_FILE);
+    int sock = inherited_sock_fd();
+    int cpu = pin_from_env(ENV_IMPORTER_CPU);
 
-    /* セグメントID読み込み */
-    FILE *fp = fopen(SEGID_FILE, "r");
-    if (!fp) {
-        perror("セグメントIDファイル読み込み失敗");
-        return 1;
-    }
+    printf("=== xpmem Importer / ベンチマーク ===\n");
+    printf("PID: %d\n", getpid());
+    if (cpu >= 0)
+        printf("CPU: %d に固定\n", cpu);
+    printf("\n");
 
     long long segid_ll;
     size_t max_size;
     int exporter_pid;
-    if (fscanf(fp, "%lld\n%zu\n%d", &segid_ll, &max_size, &exporter_pid) != 3) {
-        fprintf(stderr, "セグメントIDファイルのフォーマットが不正\n");
-        fclose(fp);
-        return 1;
+    size_t aux_offset = 0, aux_size = 0;
+    const char *seg_name = seg_name_from_env();
+    reg_header_t *reg = NULL;
+    uint64_t reg_gen = 0;
+
+    if (sock >= 0) {
+        /* ドライバ経由: エクスポータからソケットでセグメント情報を受け取る */
+        printf("エクスポータからのセグメント情報待ち...\n");
+        seg_handle_msg_t msg;
+        if (sock_recv_all(sock, &msg, sizeof(msg)) != 0) {
+            fprintf(stderr, "セグメント情報の受信失敗\n");
+            return 1;
+        }
+        segid_ll = msg.segid;
+        max_size = msg.size;
+        exporter_pid = msg.pid;
+        aux_offset = msg.aux_offset;
+        aux_size = msg.aux_size;
+    } else {
+        /* エクスポータがレジストリに登録するのを待つ */
+        printf("エクスポータの登録待ち (\"%s\")...\n", seg_name);
+        reg_info_t info;
+        reg = wait_registry(seg_name, env_double("BENCH_SEG_TIMEOUT", 0), &info);
+        if (!reg) {
+            fprintf(stderr, "セグメント \"%s\" が登録されませんでした\n", seg_name);
+            return 1;
+        }
+        segid_ll = info.segid;
+        max_size = info.size;
+        exporter_pid = info.pid;
+        aux_offset = info.aux_offset;
+        aux_size = info.aux_size;
+        reg_gen = info.generation;
+        printf("レジストリ: \"%s\" 世代 %lu, NUMA ノード %d\n", info.name,
+               (unsigned long)info.generation, (int)info.node);
     }
-    fclose(fp);
 
     xpmem_segid_t segid = (xpmem_segid_t)segid_ll;
     char sizebuf[64];
     printf("エクスポータPID: %d\n", exporter_pid);
     printf("セグメントID: %lld\n", segid_ll);
     printf("最大サイズ: %s\n", format_size(max_size, sizebuf, sizeof(sizebuf)));
+    if (aux_size > 0)
+        printf("補助領域: オフセット %zu, %s\n", aux_offset,
+               format_size(aux_size, sizebuf, sizeof(sizebuf)));
+    size_t seg_size = aux_size > 0 ? aux_offset + aux_size : max_size;
 
     /* xpmem アクセス許可の取得 */
     printf("xpmem_get()...\n");
@@ -202,7 +1365,7 @@ int main(int argc, char *argv[])
     addr.apid = apid;
     addr.offset = 0;
 
-    void *attached_ptr = xpmem_attach(addr, max_size, NULL);
+    void *attached_ptr = xpmem_attach(addr, seg_size, NULL);
     if (attached_ptr == (void *)-1) {
         perror("xpmem_attach 失敗");
         xpmem_release(apid);
@@ -212,7 +1375,7 @@ int main(int argc, char *argv[])
 
     /* エクスポータから共有メモリ経由で受け取ったデータを */
 	/* ローカルプロセス内でコピーする先のバッファの確保 */
-    void *local_buf = alloc_aligned(max_size);
+    void *local_buf = pool_get(max_size);
     if (!local_buf) {
         fprintf(stderr, "ローカルバッファ確保失敗\n");
         xpmem_detach(attached_ptr);
@@ -220,35 +1383,140 @@ int main(int argc, char *argv[])
         return 1;
     }
 
+    /* 遅延公開されたセグメントなら、データ領域の初期化が終わるまで待つ */
+    double init_wait = init_ctl_wait(aux_size > 0 ? (char *)attached_ptr + aux_offset : NULL,
+                                     aux_size);
+    if (init_wait > 0)
+        printf("データ領域の初期化待ち: %.3f 秒 (遅延公開)\n", init_wait);
+
+    /* ハードウェアカウンタの準備 (使えなければソフトウェアのみ) */
+    perf_group_open(&g_perf);
+
+    /* 外から ipcstat で見る共有統計ページ */
+    stats_open("importer");
+
+    /* 統計収集の設定 (環境変数) と計測用タイマーの校正 */
+    bench_config_load();
+    char timerbuf[128];
+    timer_calibrate();
+
     printf("\n========================================\n");
     printf("  ベンチマーク開始\n");
-    printf("  繰り返し回数: %d\n", REPEAT_COUNT);
+    print_config();
+    printf("  perfカウンタ: %s\n", perf_group_mode(&g_perf));
+    printf("  タイマー: %s\n", timer_describe(timerbuf, sizeof(timerbuf)));
+    printf("  最小計測区間: %.1f ms (時間は1操作あたり)\n", MIN_TIMED_SEC * 1e3);
     printf("========================================\n");
 
     /* ベンチマーク実行 */
+    const char *soak = getenv("BENCH_SOAK");
+    int rc = 0;
+    /* 各フェーズの最大 RSS を計る (ローカルバッファはプールで使い回す) */
+    if (soak && *soak) {
+        /* ソークモード: 通常の計測の代わりに選んだ負荷を長時間回す */
+        mem_phase_begin();
+        rc = bench_xpmem_soak(soak, attached_ptr, local_buf,
+                              aux_size > 0 ? (char *)attached_ptr + aux_offset : NULL,
+                              aux_size, max_size) != 0;
+        mem_phase_end("soak");
+    } else {
+        /* 1. xpmem memcpy (リモート→ローカル) */
+        mem_phase_begin();
+        bench_xpmem_memcpy(attached_ptr, local_buf, max_size);
+        mem_phase_end("xpmem-cpy");
 
-    /* 1. xpmem memcpy (リモート→ローカル) */
-    bench_xpmem_memcpy(attached_ptr, local_buf, max_size);
+        /* 2. xpmem 直接アクセス (ゼロコピー) */
+        mem_phase_begin();
+        bench_xpmem_direct(attached_ptr, max_size);
+        mem_phase_end("xpmem-dir");
 
-    /* 2. xpmem 直接アクセス (ゼロコピー) */
-    bench_xpmem_direct(attached_ptr, max_size);
+        /* 3. プロセス内のローカル memcpy (基準値) */
+        mem_phase_begin();
+        bench_local_memcpy(local_buf, max_size);
+        mem_phase_end("LOCAL-cpy");
 
-    /* 3. プロセス内のローカル memcpy (基準値) */
-    bench_local_memcpy(max_size);
+        /* 4. ソフトウェアプリフェッチの先読み距離スイープ */
+        mem_phase_begin();
+        bench_xpmem_prefetch(attached_ptr, local_buf, max_size);
+        mem_phase_end("prefetch");
+
+        /* 5. チェックサム付きコピー (融合 vs 別パス vs なし) */
+        mem_phase_begin();
+        bench_xpmem_checksum(attached_ptr, local_buf, max_size);
+        mem_phase_end("checksum");
+
+        /* 6. アリーナ上のオブジェクトをハンドル解決で走査 */
+        if (aux_size > 0) {
+            mem_phase_begin();
+            bench_arena_walk((char *)attached_ptr + aux_offset, aux_size);
+            mem_phase_end("arena-walk");
+        }
+
+        /* 7. 共有テーブルのルックアップ (直接参照 vs コピー) */
+        if (aux_size > 0) {
+            mem_phase_begin();
+            bench_xpmem_table((char *)attached_ptr + aux_offset, aux_size);
+            mem_phase_end("table");
+        }
+
+        /* 8. アタッチ (受け渡し) のレイテンシとファーストタッチ */
+        mem_phase_begin();
+        bench_xpmem_attach(segid, max_size);
+        mem_phase_end("attach");
+
+        /* 9. 不連続な extent の gather / scatter (同じ内容を書き戻す) */
+        mem_phase_begin();
+        bench_xpmem_extent(attached_ptr, local_buf, max_size,
+                           aux_size > 0 ? seg_base_lookup((char *)attached_ptr + aux_offset,
+                                                          aux_size) : NULL);
+        mem_phase_end("extent");
+
+        /* 10. 差分同期 (ここからはデータ領域を書き換えるので最後に行う) */
+        if (aux_size > 0) {
+            mem_phase_begin();
+            bench_xpmem_incsync(attached_ptr, local_buf, (char *)attached_ptr + aux_offset,
+                                aux_size, max_size);
+            mem_phase_end("incsync");
+        }
+
+        /* 11. 書き換え中の seqlock スナップショット */
+        if (aux_size > 0) {
+            mem_phase_begin();
+            bench_xpmem_seqlock(attached_ptr, local_buf, (char *)attached_ptr + aux_offset,
+                                aux_size, max_size);
+            mem_phase_end("seqlock");
+        }
+    }
+    mem_phase_report();
 
     /* 結果サマリ */
+    stats_phase("done", 0);
     printf("\n========================================\n");
     printf("  ベンチマーク完了\n");
     printf("========================================\n");
 
     /* クリーンアップ */
-    free(local_buf);
+    perf_group_close(&g_perf);
+    pool_destroy();
     xpmem_detach(attached_ptr);
     xpmem_release(apid);
 
     /* エクスポータに完了通知 */
-    signal_file(DONE_FILE);
+    if (sock >= 0) {
+        char done = 1;
+        sock_send_all(sock, &done, 1);
+        close(sock);
+    } else {
+        /* 計測中に同じ名前で登録し直されていれば知らせる */
+        reg_info_t now;
+        if (reg && reg_lookup(reg, seg_name, &now) == 0 && now.generation != reg_gen)
+            printf("\n注意: 計測中にセグメント \"%s\" が置き換えられました (世代 %lu → %lu)\n",
+                   seg_name, (unsigned long)reg_gen, (unsigned long)now.generation);
+        reg_close(reg);
+        char done_path[256];
+        signal_file(done_file_path(seg_name, done_path, sizeof(done_path)));
+    }
 
     printf("インポータ終了\n");
-    return 0;
+    return rc;
 }